@@ -4,24 +4,72 @@
 #include <map>
 #include <list>
 #include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include <exception>
 #include <tuple>
+#include <limits>
+#include <cmath>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
+#include <iterator>
+#include <algorithm>
 #include <sstream>
 #include <type_traits>
 
 #include <boost/optional.hpp>
 #include <boost/function.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/utility/in_place_factory.hpp>
 
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
+#if defined(__unix__) || defined(__APPLE__)
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <poll.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   define ESCALATOR_POSIX
+#endif
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
 #define ESCALATOR_INTERNAL
 
 #include "impl/utility.hpp"
+#include "impl/arena.hpp"
 #include "impl/escalatorfwd.hpp"
+#include "impl/push.hpp"
+#include "impl/hashtable.hpp"
+#include "impl/simd.hpp"
+#include "impl/simdstrings.hpp"
+#include "impl/strings.hpp"
+#include "impl/stringbuilder.hpp"
 #include "impl/conversions.hpp"
 #include "impl/operations.hpp"
+#include "impl/mmap.hpp"
+#include "impl/records.hpp"
+#include "impl/scheduler.hpp"
+#include "impl/parallel.hpp"
+#include "impl/sort.hpp"
+#include "impl/sketch.hpp"
+#include "impl/stats.hpp"
+#include "impl/aggregate.hpp"
+#include "impl/csv.hpp"
 
 #undef ESCALATOR_INTERNAL
 
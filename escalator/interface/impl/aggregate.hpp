@@ -0,0 +1,348 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Aggregators are fed elements by aggregate(), several in one traversal:
+    //     typedef ... result_type;
+    //     void insert( const ElT& v );
+    //     result_type result();
+    // and, to be used in parallel, combine with the aggregator of the elements
+    // following theirs:
+    //     void merge( const Aggregator& other );
+    // The agg:: functions make the built-in ones. Any type implementing the
+    // above can be passed to aggregate() as well.
+
+    class CountAggregator
+    {
+    public:
+        typedef size_t result_type;
+
+        CountAggregator() : m_count(0) {}
+
+        template<typename ElT>
+        void insert( const ElT& ) { m_count++; }
+        void merge( const CountAggregator& other ) { m_count += other.m_count; }
+        result_type result() const { return m_count; }
+
+    private:
+        size_t m_count;
+    };
+
+    // The sum of no elements is T()
+    template<typename T>
+    class SumAggregator
+    {
+    public:
+        typedef T result_type;
+
+        SumAggregator() : m_sum(), m_empty(true) {}
+
+        void insert( const T& v )
+        {
+            if ( m_empty ) m_sum = v;
+            else m_sum += v;
+            m_empty = false;
+        }
+
+        void merge( const SumAggregator& other )
+        {
+            if ( !other.m_empty ) insert( other.m_sum );
+        }
+
+        result_type result() const { return m_sum; }
+
+    private:
+        T       m_sum;
+        bool    m_empty;
+    };
+
+    // The first element that no other precedes under CompareT, if any
+    template<typename T, typename CompareT>
+    class ExtremumAggregator
+    {
+    public:
+        typedef boost::optional<T> result_type;
+
+        void insert( const T& v )
+        {
+            if ( !m_best || CompareT()( v, *m_best ) ) m_best = v;
+        }
+
+        void merge( const ExtremumAggregator& other )
+        {
+            if ( other.m_best ) insert( *other.m_best );
+        }
+
+        result_type result() const { return m_best; }
+
+    private:
+        boost::optional<T> m_best;
+    };
+
+    // Adapts accumulators such as Stats and QuantileSketch, which are their own result
+    template<typename AccT>
+    class AccumulatorAggregator
+    {
+    public:
+        typedef AccT result_type;
+
+        AccumulatorAggregator( const AccT& acc ) : m_acc(acc) {}
+
+        template<typename ElT>
+        void insert( const ElT& v ) { m_acc.insert( v ); }
+        void merge( const AccumulatorAggregator& other ) { m_acc.merge( other.m_acc ); }
+        result_type result() const { return m_acc; }
+
+    private:
+        AccT m_acc;
+    };
+
+    struct NoCombine
+    {
+    };
+
+    // As fold. Merging, which each chunk of a parallel run starts from init for,
+    // needs combine.
+    template<typename AccT, typename FunctorT, typename CombineT>
+    class FoldAggregator
+    {
+    public:
+        typedef AccT result_type;
+
+        FoldAggregator( const AccT& init, FunctorT fn, CombineT combine ) : m_acc(init), m_fn(fn), m_combine(combine) {}
+
+        template<typename ElT>
+        void insert( const ElT& v ) { m_acc = m_fn.functor()( m_acc, v ); }
+
+        void merge( const FoldAggregator& other )
+        {
+            static_assert( !std::is_same<CombineT, NoCombine>::value, "Merging a fold aggregator requires a combine function" );
+            mergeWith( other.m_acc, m_combine.functor() );
+        }
+
+        result_type result() const { return m_acc; }
+
+    private:
+        template<typename C>
+        void mergeWith( const AccT& other, C& combine ) { m_acc = combine( m_acc, other ); }
+        void mergeWith( const AccT&, NoCombine& ) {}
+
+        AccT                        m_acc;
+        FunctorHolder<FunctorT>     m_fn;
+        FunctorHolder<CombineT>     m_combine;
+    };
+
+    // As countBy with a KeyOrder
+    template<typename T, typename KeyFunctorT>
+    class CountByAggregator
+    {
+    public:
+        typedef typename RetainedElement<typename std::decay<typename FunctorHelper<KeyFunctorT, const T&>::out_t>::type>::type key_t;
+        typedef std::vector<std::pair<key_t, size_t>> result_type;
+        static_assert( IsHashable<key_t>::value, "countBy aggregation requires a hashable key" );
+
+        CountByAggregator( KeyFunctorT keyFn, KeyOrder order ) : m_keyFn(keyFn), m_order(order) {}
+
+        void insert( const T& v ) { add( m_keyFn.functor()( v ), 1 ); }
+
+        void merge( const CountByAggregator& other )
+        {
+            for ( size_t i = 0; i < other.m_counts.size(); ++i ) add( other.m_index.keys()[i], other.m_counts[i] );
+        }
+
+        result_type result() const
+        {
+            result_type counted;
+            counted.reserve( m_counts.size() );
+            for ( size_t i = 0; i < m_counts.size(); ++i ) counted.push_back( std::make_pair( m_index.keys()[i], m_counts[i] ) );
+
+            if ( m_order == SORTED_KEYS )
+            {
+                typedef typename result_type::value_type count_t;
+                sortRange( counted.begin(), counted.end(), []( const count_t& l, const count_t& r ) { return l.first < r.first; }, false );
+            }
+            return counted;
+        }
+
+    private:
+        template<typename K>
+        void add( K&& key, size_t count )
+        {
+            auto res = m_index.insert( std::forward<K>(key) );
+            if ( res.second ) m_counts.push_back( count );
+            else m_counts[res.first] += count;
+        }
+
+        FunctorHolder<KeyFunctorT>  m_keyFn;
+        KeyOrder                    m_order;
+        DenseHashIndex<key_t, ElementHash<key_t>, ElementEqual<key_t>> m_index;
+        std::vector<size_t>         m_counts;
+    };
+
+    // Aggregators that need the element type are made by a factory deriving
+    // from AggregatorFactory, once aggregate() knows it
+    struct AggregatorFactory
+    {
+    };
+
+    template<typename AggT, typename ElT, typename Enable>
+    struct AggregatorFor
+    {
+        typedef AggT type;
+        static const AggT& make( const AggT& agg ) { return agg; }
+    };
+
+    template<typename AggT, typename ElT>
+    struct AggregatorFor<AggT, ElT, typename std::enable_if<std::is_base_of<AggregatorFactory, AggT>::value>::type>
+    {
+        typedef decltype( std::declval<const AggT&>().template make<ElT>() ) type;
+        static type make( const AggT& agg ) { return agg.template make<ElT>(); }
+    };
+
+    template<size_t... Is>
+    struct IndexSequence
+    {
+    };
+
+    template<size_t N, size_t... Is>
+    struct MakeIndexSequence : public MakeIndexSequence<N - 1, N - 1, Is...>
+    {
+    };
+
+    template<size_t... Is>
+    struct MakeIndexSequence<0, Is...>
+    {
+        typedef IndexSequence<Is...> type;
+    };
+
+    // Several aggregators fed together, itself an aggregator of their results.
+    // The aggregators are held by type in a tuple, so feeding an element is a
+    // sequence of direct, inlinable calls.
+    template<typename ElT, typename... AggTs>
+    class Aggregation
+    {
+    public:
+        typedef std::tuple<typename AggregatorFor<AggTs, ElT>::type...> aggregators_t;
+        typedef std::tuple<typename AggregatorFor<AggTs, ElT>::type::result_type...> result_type;
+
+        Aggregation( const AggTs&... aggs ) : m_aggregators( AggregatorFor<AggTs, ElT>::make( aggs )... ) {}
+
+        void insert( const ElT& v ) { insert( v, indices_t() ); }
+        void merge( const Aggregation& other ) { merge( other, indices_t() ); }
+        result_type result() const { return result( indices_t() ); }
+
+    private:
+        typedef typename MakeIndexSequence<sizeof...(AggTs)>::type indices_t;
+
+        template<size_t... Is>
+        void insert( const ElT& v, IndexSequence<Is...> )
+        {
+            int expand[] = { 0, ( std::get<Is>( m_aggregators ).insert( v ), 0 )... };
+            (void) expand;
+        }
+
+        template<size_t... Is>
+        void merge( const Aggregation& other, IndexSequence<Is...> )
+        {
+            int expand[] = { 0, ( std::get<Is>( m_aggregators ).merge( std::get<Is>( other.m_aggregators ) ), 0 )... };
+            (void) expand;
+        }
+
+        template<size_t... Is>
+        result_type result( IndexSequence<Is...> ) const
+        {
+            return result_type( std::get<Is>( m_aggregators ).result()... );
+        }
+
+        aggregators_t m_aggregators;
+    };
+
+    namespace agg
+    {
+        struct Count : public AggregatorFactory
+        {
+            template<typename ElT>
+            CountAggregator make() const { return CountAggregator(); }
+        };
+
+        struct Sum : public AggregatorFactory
+        {
+            template<typename ElT>
+            SumAggregator<ElT> make() const { return SumAggregator<ElT>(); }
+        };
+
+        struct Min : public AggregatorFactory
+        {
+            template<typename ElT>
+            ExtremumAggregator<ElT, std::less<ElT>> make() const { return ExtremumAggregator<ElT, std::less<ElT>>(); }
+        };
+
+        struct Max : public AggregatorFactory
+        {
+            template<typename ElT>
+            ExtremumAggregator<ElT, std::greater<ElT>> make() const { return ExtremumAggregator<ElT, std::greater<ElT>>(); }
+        };
+
+        struct StatsOf : public AggregatorFactory
+        {
+            template<typename ElT>
+            AccumulatorAggregator<Stats<ElT>> make() const { return AccumulatorAggregator<Stats<ElT>>( Stats<ElT>() ); }
+        };
+
+        struct QuantileSketchOf : public AggregatorFactory
+        {
+            QuantileSketchOf( double rankError ) : m_rankError(rankError) {}
+
+            template<typename ElT>
+            AccumulatorAggregator<QuantileSketch<ElT>> make() const
+            {
+                return AccumulatorAggregator<QuantileSketch<ElT>>( QuantileSketch<ElT>( m_rankError ) );
+            }
+
+            double m_rankError;
+        };
+
+        template<typename KeyFunctorT>
+        struct CountBy : public AggregatorFactory
+        {
+            CountBy( KeyFunctorT keyFn, KeyOrder order ) : m_keyFn(keyFn), m_order(order) {}
+
+            template<typename ElT>
+            CountByAggregator<ElT, KeyFunctorT> make() const { return CountByAggregator<ElT, KeyFunctorT>( m_keyFn, m_order ); }
+
+            KeyFunctorT m_keyFn;
+            KeyOrder    m_order;
+        };
+
+        inline Count count() { return Count(); }
+        inline Sum sum() { return Sum(); }
+        inline Min min() { return Min(); }
+        inline Max max() { return Max(); }
+        inline StatsOf stats() { return StatsOf(); }
+        inline QuantileSketchOf quantileSketch( double rankError=0.01 ) { return QuantileSketchOf( rankError ); }
+
+        template<typename KeyFunctorT>
+        CountBy<KeyFunctorT> countBy( KeyFunctorT keyFn, KeyOrder order=SORTED_KEYS )
+        {
+            return CountBy<KeyFunctorT>( keyFn, order );
+        }
+
+        template<typename AccT, typename FunctorT>
+        FoldAggregator<AccT, FunctorT, NoCombine> fold( AccT init, FunctorT fn )
+        {
+            return FoldAggregator<AccT, FunctorT, NoCombine>( init, fn, NoCombine() );
+        }
+
+        template<typename AccT, typename FunctorT, typename CombineT>
+        FoldAggregator<AccT, FunctorT, CombineT> fold( AccT init, FunctorT fn, CombineT combine )
+        {
+            return FoldAggregator<AccT, FunctorT, CombineT>( init, fn, combine );
+        }
+    }
+
+}}
+
+#endif
@@ -0,0 +1,184 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // A monotonic region of memory: allocation bumps a pointer through blocks
+    // taken from the heap, deallocation does nothing, and everything is freed at
+    // once by release() or on destruction. Blocks double in size as the arena
+    // fills, so a pipeline's intermediates take a handful of heap allocations
+    // however many elements they hold.
+    //
+    // An arena is not thread-safe: give each thread (or each request) its own,
+    // and let it outlive every container allocating from it.
+    class Arena
+    {
+    public:
+        // Enough for any fundamental type
+        static const size_t DefaultAlignment = 16;
+
+        explicit Arena( size_t initialBlockSize=64 * 1024 ) :
+            m_head(nullptr), m_cur(nullptr), m_end(nullptr),
+            m_nextBlockSize(std::max<size_t>( initialBlockSize, 256 )), m_used(0)
+        {
+        }
+
+        Arena( const Arena& ) = delete;
+        Arena& operator=( const Arena& ) = delete;
+
+        ~Arena()
+        {
+            freeBlocks( nullptr );
+        }
+
+        void* allocate( size_t bytes, size_t alignment=DefaultAlignment )
+        {
+            char* p = align( m_cur, alignment );
+            // Aligning may step past the end of a nearly full block
+            if ( !m_cur || p > m_end || bytes > static_cast<size_t>( m_end - p ) )
+            {
+                addBlock( bytes + alignment );
+                p = align( m_cur, alignment );
+            }
+            m_cur = p + bytes;
+            m_used += bytes;
+            return p;
+        }
+
+        void deallocate( void*, size_t )
+        {
+        }
+
+        // Frees everything allocated so far. The most recent (largest) block is
+        // kept, so an arena reset between requests of a similar size stops
+        // going to the heap at all after the first.
+        void release()
+        {
+            if ( !m_head ) return;
+
+            freeBlocks( m_head );
+            m_head->prev = nullptr;
+            m_cur = reinterpret_cast<char*>( m_head + 1 );
+            m_used = 0;
+        }
+
+        // Bytes handed out since construction or the last release()
+        size_t bytesAllocated() const { return m_used; }
+
+    private:
+        struct Block
+        {
+            Block*  prev;
+            size_t  size;
+        };
+
+        static char* align( char* p, size_t alignment )
+        {
+            uintptr_t address = reinterpret_cast<uintptr_t>( p );
+            return p + ( ( alignment - address % alignment ) % alignment );
+        }
+
+        void addBlock( size_t minimum )
+        {
+            size_t size = std::max( m_nextBlockSize, minimum + sizeof(Block) );
+            m_nextBlockSize = std::max( m_nextBlockSize, size ) * 2;
+
+            Block* block = static_cast<Block*>( ::operator new( size ) );
+            block->prev = m_head;
+            block->size = size;
+            m_head = block;
+            m_cur = reinterpret_cast<char*>( block + 1 );
+            m_end = reinterpret_cast<char*>( block ) + size;
+        }
+
+        // Every block older than keep
+        void freeBlocks( Block* keep )
+        {
+            Block* block = keep ? keep->prev : m_head;
+            while ( block )
+            {
+                Block* prev = block->prev;
+                ::operator delete( block );
+                block = prev;
+            }
+        }
+
+        Block*  m_head;
+        char*   m_cur;
+        char*   m_end;
+        size_t  m_nextBlockSize;
+        size_t  m_used;
+    };
+
+    // A standard allocator drawing from an Arena, for lower/retain and the
+    // materialising operations, e.g.
+    //     Arena arena;
+    //     auto sorted = lift(v).sortWith( cmp, ArenaAllocator<int>( arena ) );
+    template<typename T>
+    class ArenaAllocator
+    {
+    public:
+        typedef T               value_type;
+        typedef T*              pointer;
+        typedef const T*        const_pointer;
+        typedef T&              reference;
+        typedef const T&        const_reference;
+        typedef size_t          size_type;
+        typedef ptrdiff_t       difference_type;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef ArenaAllocator<U> other;
+        };
+
+        explicit ArenaAllocator( Arena& arena ) : m_arena(&arena)
+        {
+        }
+
+        template<typename U>
+        ArenaAllocator( const ArenaAllocator<U>& other ) : m_arena(&other.arena())
+        {
+        }
+
+        T* allocate( size_t n, const void* =nullptr )
+        {
+            return static_cast<T*>( m_arena->allocate( n * sizeof(T), alignof(T) ) );
+        }
+
+        void deallocate( T* p, size_t n )
+        {
+            m_arena->deallocate( p, n * sizeof(T) );
+        }
+
+        size_t max_size() const { return std::numeric_limits<size_t>::max() / sizeof(T); }
+
+        template<typename U, typename... ArgTs>
+        void construct( U* p, ArgTs&&... args )
+        {
+            ::new( static_cast<void*>( p ) ) U( std::forward<ArgTs>(args)... );
+        }
+
+        template<typename U>
+        void destroy( U* p )
+        {
+            p->~U();
+        }
+
+        Arena& arena() const { return *m_arena; }
+
+    private:
+        Arena*  m_arena;
+    };
+
+    template<typename T, typename U>
+    bool operator==( const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs ) { return &lhs.arena() == &rhs.arena(); }
+
+    template<typename T, typename U>
+    bool operator!=( const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs ) { return !( lhs == rhs ); }
+
+}}
+
+#endif
@@ -16,16 +16,30 @@ namespace navetas { namespace escalator {
         static ContainerType lower( InputIterator it )
         {
             ContainerType t;
-            while ( it.hasNext() ) t.insert( t.end(), it.next() );
+            reserveFromHint( t, sizeHintOf( it ) );
+            drain( it, [&t]( ElT v ) { t.insert( t.end(), std::move(v) ); } );
             return t;
         }
         
         template<typename InputIterator>
         static ContainerWrapper<ContainerType, ElT> retain( InputIterator it )
         {
-            ContainerType t;
-            while ( it.hasNext() ) t.insert( t.end(), it.next() );
-            return ContainerWrapper<ContainerType, ElT>( std::move(t) );
+            return ContainerWrapper<ContainerType, ElT>( lower( std::move(it) ) );
+        }
+        
+        template<typename InputIterator, typename AllocT>
+        static typename MakeAllocContainerType<ElT, Container, AllocT>::type lower( InputIterator it, const AllocT& alloc )
+        {
+            typename MakeAllocContainerType<ElT, Container, AllocT>::type t = MakeAllocContainerType<ElT, Container, AllocT>::make( alloc );
+            reserveFromHint( t, sizeHintOf( it ) );
+            drain( it, [&t]( ElT v ) { t.insert( t.end(), std::move(v) ); } );
+            return t;
+        }
+        
+        template<typename InputIterator, typename AllocT>
+        static ContainerWrapper<typename MakeAllocContainerType<ElT, Container, AllocT>::type, ElT> retain( InputIterator it, const AllocT& alloc )
+        {
+            return ContainerWrapper<typename MakeAllocContainerType<ElT, Container, AllocT>::type, ElT>( lower( std::move(it), alloc ) );
         }
     };
     
@@ -33,6 +47,13 @@ namespace navetas { namespace escalator {
     template<typename BaseT, typename ElT, typename RetainElT>
     class ConversionsBase : public Lifted
     {
+    public:
+        typedef ElT el_t;
+        //typedef typename remove_all_reference_then_remove_const<ElT>::type mutable_value_type;
+        typedef typename std::remove_const<typename std::remove_reference<ElT>::type>::type mutable_value_type;
+        // What the operations collecting elements into containers keep them as
+        typedef typename RetainedElement<mutable_value_type>::type retained_value_type;
+        
     protected:
         // BaseT always implements:
         // getIterator(), which returns a type Iterator which implements:
@@ -40,16 +61,176 @@ namespace navetas { namespace escalator {
         //     bool hasNext();
         BaseT& get() { return static_cast<BaseT&>(*this); }
         
-    public:
-        typedef ElT el_t;
-        //typedef typename remove_all_reference_then_remove_const<ElT>::type mutable_value_type;
-        typedef typename std::remove_const<typename std::remove_reference<ElT>::type>::type mutable_value_type;
+        template<typename KeyF>
+        static bool cacheKeys( KeyCaching caching )
+        {
+            typedef decltype( std::declval<KeyF&>()( std::declval<const retained_value_type&>() ) ) key_ref_t;
+            
+            bool cheap = std::is_lvalue_reference<key_ref_t>::value ||
+                ( std::is_scalar<mutable_value_type>::value && std::is_scalar<typename std::decay<key_ref_t>::type>::value );
+            return caching == CACHE_KEYS || ( caching == AUTO_KEY_CACHING && !cheap );
+        }
+        
+        // Decorate-sort-undecorate: compute each key once, sort the (key, index)
+        // pairs, then permute the elements into place. Breaking ties on the index
+        // makes even the unstable sort stable.
+        template<typename KeyF, typename AllocT>
+        ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> sortByCachedKeys( KeyF keyFn, bool stable, const AllocT& alloc )
+        {
+            typedef typename std::decay<decltype( keyFn( std::declval<const retained_value_type&>() ) )>::type key_t;
+            typedef std::pair<key_t, size_t> keyed_t;
+            
+            typename AllocVector<retained_value_type, AllocT>::type v = lower<std::vector>( alloc );
+            typename AllocVector<keyed_t, AllocT>::type keys( alloc );
+            keys.reserve( v.size() );
+            for ( size_t i = 0; i < v.size(); ++i ) keys.push_back( keyed_t( keyFn( v[i] ), i ) );
+            
+            if ( stable )
+            {
+                sortRange( keys.begin(), keys.end(), []( const keyed_t& l, const keyed_t& r )
+                {
+                    return l.first < r.first || ( !(r.first < l.first) && l.second < r.second );
+                }, false, keys.get_allocator() );
+            }
+            else
+            {
+                sortRange( keys.begin(), keys.end(), []( const keyed_t& l, const keyed_t& r ) { return l.first < r.first; }, false, keys.get_allocator() );
+            }
+            
+            typename AllocVector<retained_value_type, AllocT>::type sorted( alloc );
+            sorted.reserve( v.size() );
+            for ( auto& k : keys ) sorted.push_back( std::move( v[k.second] ) );
+            
+            ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> vw( std::move(sorted) );
+            return vw;
+        }
+        
+        // The containers of groupBy and countBy, allocating with AllocT
+        template<typename KeyFunctorT, typename ValueFunctorT, typename AllocT, typename Enable=void>
+        struct Grouping
+        {
+        };
+        
+        template<typename KeyFunctorT, typename ValueFunctorT, typename AllocT>
+        struct Grouping<KeyFunctorT, ValueFunctorT, AllocT, typename std::enable_if<IsAllocator<AllocT>::value>::type>
+        {
+            typedef typename RetainedElement<typename FunctorHelper<KeyFunctorT, ElT>::out_t>::type key_t;
+            typedef typename RetainedElement<typename FunctorHelper<ValueFunctorT, ElT>::out_t>::type value_t;
+            typedef typename AllocVector<value_t, AllocT>::type values_t;
+            typedef std::pair<key_t, values_t> group_t;
+            typedef typename MakeAllocContainerType<group_t, std::map, AllocT>::type map_t;
+        };
+        
+        template<typename KeyFunctorT, typename AllocT, typename Enable=void>
+        struct Counting
+        {
+        };
+        
+        template<typename KeyFunctorT, typename AllocT>
+        struct Counting<KeyFunctorT, AllocT, typename std::enable_if<IsAllocator<AllocT>::value>::type>
+        {
+            typedef typename RetainedElement<typename FunctorHelper<KeyFunctorT, ElT>::out_t>::type key_t;
+            typedef std::pair<key_t, size_t> count_t;
+            typedef typename MakeAllocContainerType<count_t, std::map, AllocT>::type map_t;
+        };
+        
+        // Every element, for median and quantile selection
+        template<typename AllocT>
+        typename AllocVector<mutable_value_type, AllocT>::type orderStatisticBuffer( const char* operation, const AllocT& alloc )
+        {
+            auto it = get().getIterator();
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            ESCALATOR_ASSERT( it.hasNext(), operation << " over insufficient items" );
+            
+            typename AllocVector<mutable_value_type, AllocT>::type values( alloc );
+            reserveFromHint( values, sizeHintOf( it ) );
+            drain( it, [&values]( it_el_t v ) { values.push_back( std::forward<it_el_t>(v) ); } );
+            return values;
+        }
+        
+        // Reductions over contiguous int/float/double storage go to vectorised
+        // kernels; everything else drains element by element
+        template<typename IteratorT>
+        mutable_value_type sumOf( IteratorT& it, size_t& count, std::true_type )
+        {
+            const mutable_value_type* values = it.takeContiguous( count );
+            return SimdKernels<mutable_value_type>::sum( values, count );
+        }
+        
+        template<typename IteratorT>
+        mutable_value_type sumOf( IteratorT& it, size_t& count, std::false_type )
+        {
+            typedef typename IteratorElement<IteratorT>::type it_el_t;
+            
+            count = 1;
+            mutable_value_type acc = it.next();
+            drain( it, [&acc, &count]( it_el_t v )
+            {
+                acc += v;
+                count++;
+            } );
+            return acc;
+        }
         
+        template<typename IteratorT, typename FunctorT>
+        size_t countOf( IteratorT& it, FunctorT& pred, std::true_type )
+        {
+            size_t count;
+            const mutable_value_type* values = it.takeContiguous( count );
+            return SimdKernels<mutable_value_type>::countIf( values, count, pred );
+        }
+        
+        template<typename IteratorT, typename FunctorT>
+        size_t countOf( IteratorT& it, FunctorT& pred, std::false_type )
+        {
+            typedef typename IteratorElement<IteratorT>::type it_el_t;
+            
+            size_t count = 0;
+            drain( it, [&count, &pred]( it_el_t v ) { if ( pred( v ) ) count++; } );
+            return count;
+        }
+        
+        template<bool Greatest, typename IteratorT>
+        std::pair<size_t, retained_value_type> argExtremumOf( IteratorT& it, std::true_type )
+        {
+            size_t count;
+            const mutable_value_type* values = it.takeContiguous( count );
+            if ( count == 0 ) return std::make_pair( size_t(0), mutable_value_type() );
+            return SimdKernels<mutable_value_type>::template argExtremum<Greatest>( values, count );
+        }
+        
+        // TODO: Should these use boost::optional to work round init requirements?
+        template<bool Greatest, typename IteratorT>
+        std::pair<size_t, retained_value_type> argExtremumOf( IteratorT& it, std::false_type )
+        {
+            bool init = true;
+            retained_value_type ext = retained_value_type();
+            
+            size_t extIndex = 0;
+            for ( int i = 0; it.hasNext(); ++i )
+            {
+                if ( init ) ext = it.next();
+                else
+                {
+                    auto n = it.next();
+                    if ( Greatest ? n > ext : n < ext )
+                    {
+                        ext = n;
+                        extIndex = i;
+                    }
+                }
+                init = false;
+            }
+            return std::make_pair( extIndex, ext );
+        }
+        
+    public:
         template< class OutputIterator >
         void toContainer( OutputIterator v ) 
         {
             auto it = get().getIterator();
-            while ( it.hasNext() ) *v++ = it.next();
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&v]( it_el_t el ) { *v++ = std::forward<it_el_t>(el); } );
         }
         
         template<typename ElementCheckType>
@@ -67,23 +248,46 @@ namespace navetas { namespace escalator {
         }
         
         template<template<typename, typename ...> class Container>
-        typename ConversionHelper<mutable_value_type, Container>::ContainerType lower()
+        typename ConversionHelper<retained_value_type, Container>::ContainerType lower()
         {
-            return ConversionHelper<mutable_value_type, Container>::lower( get().getIterator() );
+            return ConversionHelper<retained_value_type, Container>::lower( get().getIterator() );
         }
         
         template<template<typename, typename ...> class Container>
-        ContainerWrapper<typename ConversionHelper<mutable_value_type, Container>::ContainerType, mutable_value_type> retain()
+        ContainerWrapper<typename ConversionHelper<retained_value_type, Container>::ContainerType, retained_value_type> retain()
         {
-            return ConversionHelper<mutable_value_type, Container>::retain( get().getIterator() );
+            return ConversionHelper<retained_value_type, Container>::retain( get().getIterator() );
         }
         
+        // lower, retain and the other operations that collect elements into
+        // containers (sorts, partitions, groupBy, countBy, distinct, median and
+        // quantiles) may be given a standard allocator for them, e.g. an
+        // ArenaAllocator. It is rebound to each container's element type.
+        template<template<typename, typename ...> class Container, typename AllocT>
+        typename MakeAllocContainerType<retained_value_type, Container, AllocT>::type lower( const AllocT& alloc )
+        {
+            return ConversionHelper<retained_value_type, Container>::lower( get().getIterator(), alloc );
+        }
+        
+        template<template<typename, typename ...> class Container, typename AllocT>
+        ContainerWrapper<typename MakeAllocContainerType<retained_value_type, Container, AllocT>::type, retained_value_type> retain( const AllocT& alloc )
+        {
+            return ConversionHelper<retained_value_type, Container>::retain( get().getIterator(), alloc );
+        }
+        
+        // The searches below stop reading from the source as soon as the answer
+        // is known
         template<typename FunctorT>
         bool forall( FunctorT fn )
         {
             bool pred = true;
             auto it = get().getIterator();
-            while ( pred && it.hasNext() ) pred &= fn( it.next() );
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&pred, &fn]( it_el_t v ) -> bool
+            {
+                pred = static_cast<bool>( fn( std::forward<it_el_t>(v) ) );
+                return pred;
+            } );
             return pred;
         }
         
@@ -92,17 +296,89 @@ namespace navetas { namespace escalator {
         {
             bool pred = false;
             auto it = get().getIterator();
-            while ( it.hasNext() ) pred |= fn( it.next() );
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&pred, &fn]( it_el_t v ) -> bool
+            {
+                pred = static_cast<bool>( fn( std::forward<it_el_t>(v) ) );
+                return !pred;
+            } );
             return pred;
         }
         
+        bool contains( const mutable_value_type& value )
+        {
+            return exists( [&value]( const mutable_value_type& v ) { return v == value; } );
+        }
+        
+        // The first element for which fn holds
+        template<typename FunctorT>
+        boost::optional<retained_value_type> find( FunctorT fn )
+        {
+            boost::optional<retained_value_type> found = emptyOptional<retained_value_type>();
+            auto it = get().getIterator();
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&found, &fn]( it_el_t v ) -> bool
+            {
+                if ( !fn( v ) ) return true;
+                found = retained_value_type( std::forward<it_el_t>(v) );
+                return false;
+            } );
+            return found;
+        }
+        
+        // The position of the first element for which fn holds
+        template<typename FunctorT>
+        boost::optional<size_t> indexWhere( FunctorT fn )
+        {
+            size_t index = 0;
+            boost::optional<size_t> found = emptyOptional<size_t>();
+            auto it = get().getIterator();
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&index, &found, &fn]( it_el_t v ) -> bool
+            {
+                if ( fn( std::forward<it_el_t>(v) ) )
+                {
+                    found = index;
+                    return false;
+                }
+                index++;
+                return true;
+            } );
+            return found;
+        }
+        
+        boost::optional<retained_value_type> headOption()
+        {
+            auto it = get().getIterator();
+            if ( !it.hasNext() ) return boost::none;
+            return retained_value_type( it.next() );
+        }
+        
         // TODO: Can this remain lifted?
         template<typename FunctorT>
-        std::pair<std::vector<ElT>, std::vector<ElT>> partition( FunctorT fn )
+        std::pair<std::vector<retained_value_type>, std::vector<retained_value_type>> partition( FunctorT fn )
+        {
+            return partition( fn, std::allocator<retained_value_type>() );
+        }
+        
+        template<typename FunctorT, typename AllocT>
+        std::pair<typename AllocVector<retained_value_type, AllocT>::type, typename AllocVector<retained_value_type, AllocT>::type> partition( FunctorT fn, const AllocT& alloc )
         {
-            std::pair<std::vector<ElT>, std::vector<ElT>> res;
+            typedef typename AllocVector<retained_value_type, AllocT>::type vector_t;
+            vector_t empty( alloc );
+            std::pair<vector_t, vector_t> res( empty, empty );
             
             auto it = get().getIterator();
+            
+            // Where the size is known, enough for an even split: at most one
+            // reallocation on the larger side
+            SizeHint hint = sizeHintOf( it );
+            if ( hint.isExact() )
+            {
+                res.first.reserve( hint.size() / 2 );
+                res.second.reserve( hint.size() / 2 );
+            }
+            
             while ( it.hasNext() )
             {
                 ElT val = it.next();
@@ -115,9 +391,17 @@ namespace navetas { namespace escalator {
         
         // TODO: Can this remain lifted?
         template<typename FunctorT>
-        std::pair<std::vector<ElT>, std::vector<ElT>> partitionWhile( FunctorT fn )
+        std::pair<std::vector<retained_value_type>, std::vector<retained_value_type>> partitionWhile( FunctorT fn )
         {
-            std::pair<std::vector<ElT>, std::vector<ElT>> res;
+            return partitionWhile( fn, std::allocator<retained_value_type>() );
+        }
+        
+        template<typename FunctorT, typename AllocT>
+        std::pair<typename AllocVector<retained_value_type, AllocT>::type, typename AllocVector<retained_value_type, AllocT>::type> partitionWhile( FunctorT fn, const AllocT& alloc )
+        {
+            typedef typename AllocVector<retained_value_type, AllocT>::type vector_t;
+            vector_t empty( alloc );
+            std::pair<vector_t, vector_t> res( empty, empty );
             
             bool inFirst = true;
             auto it = get().getIterator();
@@ -133,12 +417,17 @@ namespace navetas { namespace escalator {
             return res;
         }
         
-        // TODO: This should probably be lazy
         template<typename FunctorT>
-        ContainerWrapper<std::vector<ElT>, ElT> takeWhile( FunctorT fn ) { return ContainerWrapper<std::vector<ElT>, ElT>( partitionWhile(fn).first ); }
+        TakeWhileWrapper<BaseT, FunctorT, ElT> takeWhile( FunctorT fn )
+        {
+            return TakeWhileWrapper<BaseT, FunctorT, ElT>( std::move(get().getIterator()), fn );
+        }
         
         template<typename FunctorT>
-        ContainerWrapper<std::vector<ElT>, ElT> dropWhile( FunctorT fn ) { return ContainerWrapper<std::vector<ElT>, ElT>( partitionWhile(fn).second ); }
+        DropWhileWrapper<BaseT, FunctorT, ElT> dropWhile( FunctorT fn )
+        {
+            return DropWhileWrapper<BaseT, FunctorT, ElT>( std::move(get().getIterator()), fn );
+        }
         
         template<typename FunctorT>
         MapWrapper<BaseT, FunctorT, ElT, typename FunctorHelper<FunctorT, ElT>::out_t> map( FunctorT fn )
@@ -171,125 +460,192 @@ namespace navetas { namespace escalator {
             return FilterWrapper<BaseT, FunctorT, ElT>( std::move(get().getIterator()), fn );
         }
         
-        typedef MapWithStateWrapper<BaseT, std::function<std::pair<ElT, size_t>(const ElT&, size_t&)>, ElT, std::pair<ElT, size_t>, size_t> zipWithIndexWrapper_t;
+        class ZipWithIndexFunctor
+        {
+        public:
+            std::pair<ElT, size_t> operator()( const ElT& el, size_t& index ) const
+            {
+                return std::pair<ElT, size_t>( el, index++ );
+            }
+        };
+        
+        typedef MapWithStateWrapper<BaseT, ZipWithIndexFunctor, ElT, std::pair<ElT, size_t>, size_t> zipWithIndexWrapper_t;
         zipWithIndexWrapper_t zipWithIndex()
         {
             auto it = get().getIterator();
-            return zipWithIndexWrapper_t(
-                std::move(it),
-                []( const ElT& el, size_t& index ) { return std::make_pair( el, index++ ); },
-                0 );
+            return zipWithIndexWrapper_t( std::move(it), ZipWithIndexFunctor(), 0 );
         }
         
-        typedef MapWithStateWrapper<BaseT, std::function<std::pair<ElT, ElT>( ElT, boost::optional<ElT>& state )>, ElT, std::pair<ElT, ElT>, boost::optional<ElT>> sliding2_t;
+        class Sliding2Functor
+        {
+        public:
+            std::pair<ElT, ElT> operator()( ElT el, boost::optional<ElT>& state ) const
+            {
+                std::pair<ElT, ElT> tp = std::pair<ElT, ElT>( state.get(), el );
+                state = el;
+                return tp;
+            }
+        };
+        
+        typedef MapWithStateWrapper<BaseT, Sliding2Functor, ElT, std::pair<ElT, ElT>, boost::optional<ElT>> sliding2_t;
         sliding2_t sliding2()
         {
             auto it = get().getIterator();
-            boost::optional<ElT> startState;
+            boost::optional<ElT> startState = emptyOptional<ElT>();
             if ( it.hasNext() ) startState = it.next();
-            return sliding2_t(
-                std::move(it),
-                []( ElT el, boost::optional<ElT>& state )
-                {
-                    std::pair<ElT, ElT> tp = std::pair<ElT, ElT>( state.get(), el );
-                    state = el;
-                    return tp;
-                },
-                startState );
+            return sliding2_t( std::move(it), Sliding2Functor(), startState );
         }
         
+        // Sorts of large inputs run in parallel (see sortRange)
         template<typename OrderingF>
-        ContainerWrapper<std::vector<ElT>, ElT> sortWith( OrderingF orderingFn )
+        ContainerWrapper<std::vector<retained_value_type>, retained_value_type> sortWith( OrderingF orderingFn )
+        {
+            return sortWith( orderingFn, std::allocator<retained_value_type>() );
+        }
+        
+        template<typename OrderingF, typename AllocT>
+        ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> sortWith( OrderingF orderingFn, const AllocT& alloc )
         {
-            std::vector<ElT> v = lower<std::vector>();
-            std::sort( v.begin(), v.end(), orderingFn );
-            ContainerWrapper<std::vector<ElT>, ElT> vw( std::move(v) );
+            typename AllocVector<retained_value_type, AllocT>::type v = lower<std::vector>( alloc );
+            sortRange( v.begin(), v.end(), orderingFn, false, v.get_allocator() );
+            ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> vw( std::move(v) );
             
             return vw;
         }
         
-        template<typename KeyF>
-        ContainerWrapper<std::vector<ElT>, ElT> sortBy( KeyF keyFn )
+        // As sortWith, but equal elements keep their relative order
+        template<typename OrderingF>
+        ContainerWrapper<std::vector<retained_value_type>, retained_value_type> stableSortWith( OrderingF orderingFn )
         {
-            std::vector<ElT> v = lower<std::vector>();
-            std::sort( v.begin(), v.end(), [keyFn]( const ElT& lhs, const ElT& rhs ) { return keyFn(lhs) < keyFn(rhs); } );
-            
-            ContainerWrapper<std::vector<ElT>, ElT> vw( std::move(v) );
+            return stableSortWith( orderingFn, std::allocator<retained_value_type>() );
+        }
+        
+        template<typename OrderingF, typename AllocT>
+        ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> stableSortWith( OrderingF orderingFn, const AllocT& alloc )
+        {
+            typename AllocVector<retained_value_type, AllocT>::type v = lower<std::vector>( alloc );
+            sortRange( v.begin(), v.end(), orderingFn, true, v.get_allocator() );
+            ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> vw( std::move(v) );
             
             return vw;
         }
+        
+        template<typename KeyF>
+        ContainerWrapper<std::vector<retained_value_type>, retained_value_type> sortBy( KeyF keyFn, KeyCaching caching=AUTO_KEY_CACHING )
+        {
+            return sortBy( keyFn, std::allocator<retained_value_type>(), caching );
+        }
+        
+        template<typename KeyF, typename AllocT>
+        ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> sortBy( KeyF keyFn, const AllocT& alloc, KeyCaching caching=AUTO_KEY_CACHING )
+        {
+            if ( cacheKeys<KeyF>( caching ) ) return sortByCachedKeys( keyFn, false, alloc );
+            return sortWith( [keyFn]( const retained_value_type& lhs, const retained_value_type& rhs ) { return keyFn(lhs) < keyFn(rhs); }, alloc );
+        }
+        
+        template<typename KeyF>
+        ContainerWrapper<std::vector<retained_value_type>, retained_value_type> stableSortBy( KeyF keyFn, KeyCaching caching=AUTO_KEY_CACHING )
+        {
+            return stableSortBy( keyFn, std::allocator<retained_value_type>(), caching );
+        }
+        
+        template<typename KeyF, typename AllocT>
+        ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> stableSortBy( KeyF keyFn, const AllocT& alloc, KeyCaching caching=AUTO_KEY_CACHING )
+        {
+            if ( cacheKeys<KeyF>( caching ) ) return sortByCachedKeys( keyFn, true, alloc );
+            return stableSortWith( [keyFn]( const retained_value_type& lhs, const retained_value_type& rhs ) { return keyFn(lhs) < keyFn(rhs); }, alloc );
+        }
 
-        ContainerWrapper<std::vector<ElT>, ElT> sort()
+        ContainerWrapper<std::vector<retained_value_type>, retained_value_type> sort()
         {
-            std::vector<ElT> v = lower<std::vector>();
-            std::sort( v.begin(), v.end(), [](const ElT& a, const ElT& b)
+            return sort( std::allocator<retained_value_type>() );
+        }
+        
+        template<typename AllocT>
+        ContainerWrapper<typename AllocVector<retained_value_type, AllocT>::type, retained_value_type> sort( const AllocT& alloc )
+        {
+            return sortWith( [](const retained_value_type& a, const retained_value_type& b)
             {
                 //May be asked to compare std::reference_wrappers around types
                 //This doesn't seem to find the operator< by default,
                 //probably as it's defined on the mutable_value_type as a class method
                 //and C++ won't try the default operator& on the reference wrapper
                 //and dig around.
-                const mutable_value_type& v_a = a;
-                const mutable_value_type& v_b = b;
+                const retained_value_type& v_a = a;
+                const retained_value_type& v_b = b;
                 return v_a < v_b;
-            });
-            
-            ContainerWrapper<std::vector<ElT>, ElT> vw( std::move(v) );
-            
-            return vw;
+            }, alloc );
         }
         
         template<typename FunctorT>
         void foreach( FunctorT fn )
         {
             auto it = get().getIterator();
-            while ( it.hasNext() )
-            {
-                fn( it.next() );
-            }
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            
+            // Whatever fn returns, it sees every element
+            drain( it, [&fn]( it_el_t v ) { fn( std::forward<it_el_t>(v) ); } );
         }
         
         template<typename KeyFunctorT, typename ValueFunctorT>
         auto groupBy( KeyFunctorT keyFn, ValueFunctorT valueFn ) ->
             ContainerWrapper<
-                std::map<typename FunctorHelper<KeyFunctorT, ElT>::out_t, std::vector<typename FunctorHelper<ValueFunctorT, ElT>::out_t>>,
-                std::pair<typename FunctorHelper<KeyFunctorT, ElT>::out_t, std::vector<typename FunctorHelper<ValueFunctorT, ElT>::out_t>>,
+                typename Grouping<KeyFunctorT, ValueFunctorT, std::allocator<mutable_value_type>>::map_t,
+                typename Grouping<KeyFunctorT, ValueFunctorT, std::allocator<mutable_value_type>>::group_t,
+                DeconstMapKeyFunctor>
+        {
+            return groupBy( keyFn, valueFn, std::allocator<mutable_value_type>() );
+        }
+        
+        template<typename KeyFunctorT, typename ValueFunctorT, typename AllocT>
+        auto groupBy( KeyFunctorT keyFn, ValueFunctorT valueFn, const AllocT& alloc ) ->
+            ContainerWrapper<
+                typename Grouping<KeyFunctorT, ValueFunctorT, AllocT>::map_t,
+                typename Grouping<KeyFunctorT, ValueFunctorT, AllocT>::group_t,
                 DeconstMapKeyFunctor>
         {
-            typedef typename FunctorHelper<KeyFunctorT, ElT>::out_t key_t;
-            typedef typename FunctorHelper<ValueFunctorT, ElT>::out_t mutable_value_type;
+            typedef Grouping<KeyFunctorT, ValueFunctorT, AllocT> grouping_t;
             
-            std::map<key_t, std::vector<mutable_value_type>> grouped;
+            typename grouping_t::map_t grouped = MakeAllocContainerType<typename grouping_t::group_t, std::map, AllocT>::make( alloc );
+            typename grouping_t::values_t empty( alloc );
             auto it = get().getIterator();
             while ( it.hasNext() )
             {
                 auto v = it.next();
-                auto key = keyFn(v);
-                grouped[key].push_back( valueFn(v) );
+                typename grouping_t::key_t key = keyFn(v);
+                auto findIt = grouped.find( key );
+                if ( findIt == grouped.end() ) findIt = grouped.insert( std::make_pair( key, empty ) ).first;
+                findIt->second.push_back( valueFn(v) );
             }
             
-            return ContainerWrapper<
-                std::map<typename FunctorHelper<KeyFunctorT, ElT>::out_t, std::vector<typename FunctorHelper<ValueFunctorT, ElT>::out_t>>,
-                std::pair<typename FunctorHelper<KeyFunctorT, ElT>::out_t, std::vector<typename FunctorHelper<ValueFunctorT, ElT>::out_t>>,
-                DeconstMapKeyFunctor>
-                (grouped);
+            return ContainerWrapper<typename grouping_t::map_t, typename grouping_t::group_t, DeconstMapKeyFunctor>( std::move(grouped) );
         }
         
         template<typename KeyFunctorT>
         auto countBy( KeyFunctorT keyFn ) ->
             ContainerWrapper<
-                std::map<typename FunctorHelper<KeyFunctorT, ElT>::out_t, size_t>,
-                std::pair<typename FunctorHelper<KeyFunctorT, ElT>::out_t, size_t>,
+                typename Counting<KeyFunctorT, std::allocator<mutable_value_type>>::map_t,
+                typename Counting<KeyFunctorT, std::allocator<mutable_value_type>>::count_t,
+                DeconstMapKeyFunctor>
+        {
+            return countBy( keyFn, std::allocator<mutable_value_type>() );
+        }
+        
+        template<typename KeyFunctorT, typename AllocT>
+        auto countBy( KeyFunctorT keyFn, const AllocT& alloc ) ->
+            ContainerWrapper<
+                typename Counting<KeyFunctorT, AllocT>::map_t,
+                typename Counting<KeyFunctorT, AllocT>::count_t,
                 DeconstMapKeyFunctor>
         {
-            typedef typename FunctorHelper<KeyFunctorT, ElT>::out_t key_t;
+            typedef Counting<KeyFunctorT, AllocT> counting_t;
             
-            std::map<key_t, size_t> counts;
+            typename counting_t::map_t counts = MakeAllocContainerType<typename counting_t::count_t, std::map, AllocT>::make( alloc );
             auto it = get().getIterator();
             while ( it.hasNext() )
             {
                 auto v = it.next();
-                auto key = keyFn(v);
+                typename counting_t::key_t key = keyFn(v);
                 auto findIt = counts.find( key );
                 if ( findIt == counts.end() )
                 {
@@ -301,67 +657,136 @@ namespace navetas { namespace escalator {
                 }
             }
             
-            return ContainerWrapper<
-                std::map<typename FunctorHelper<KeyFunctorT, ElT>::out_t, size_t>,
-                std::pair<typename FunctorHelper<KeyFunctorT, ElT>::out_t, size_t>,
-                DeconstMapKeyFunctor>( counts );
+            return ContainerWrapper<typename counting_t::map_t, typename counting_t::count_t, DeconstMapKeyFunctor>( std::move(counts) );
         }
         
-        // TODO: Note that this forces evaluation of the input stream
-        // TODO: distinct should be wrappable into distinctWith using
-        // std::less
-        ContainerWrapper<std::vector<ElT>, ElT> distinct()
+        // Hash-based groupBy, for keys that are IsHashable. Groups come out sorted
+        // by key, or in the order their keys were first seen.
+        template<typename KeyFunctorT, typename ValueFunctorT>
+        auto groupBy( KeyFunctorT keyFn, ValueFunctorT valueFn, KeyOrder order ) ->
+            ContainerWrapper<
+                std::vector<typename Grouping<KeyFunctorT, ValueFunctorT, std::allocator<mutable_value_type>>::group_t>,
+                typename Grouping<KeyFunctorT, ValueFunctorT, std::allocator<mutable_value_type>>::group_t>
         {
-            std::set<ElT> seen;
-            std::vector<typename std::set<ElT>::iterator> ordering;
+            return groupBy( keyFn, valueFn, order, std::allocator<mutable_value_type>() );
+        }
+        
+        template<typename KeyFunctorT, typename ValueFunctorT, typename AllocT>
+        auto groupBy( KeyFunctorT keyFn, ValueFunctorT valueFn, KeyOrder order, const AllocT& alloc ) ->
+            ContainerWrapper<
+                typename AllocVector<typename Grouping<KeyFunctorT, ValueFunctorT, AllocT>::group_t, AllocT>::type,
+                typename Grouping<KeyFunctorT, ValueFunctorT, AllocT>::group_t>
+        {
+            typedef Grouping<KeyFunctorT, ValueFunctorT, AllocT> grouping_t;
+            typedef typename grouping_t::key_t key_t;
+            typedef typename grouping_t::values_t values_t;
+            typedef typename grouping_t::group_t group_t;
+            static_assert( IsHashable<key_t>::value, "groupBy with a KeyOrder requires a hashable key" );
+            
+            DenseHashIndex<key_t, ElementHash<key_t>, ElementEqual<key_t>, typename RebindAlloc<AllocT, key_t>::type> index( alloc );
+            typename AllocVector<values_t, AllocT>::type groups( alloc );
+            values_t empty( alloc );
             auto it = get().getIterator();
-            while ( it.hasNext() )
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&]( it_el_t v )
             {
-                auto res = seen.insert( it.next() );
-                if ( res.second ) ordering.push_back( res.first );
-            }
+                auto res = index.insert( keyFn(v) );
+                if ( res.second ) groups.push_back( empty );
+                groups[res.first].push_back( valueFn(v) );
+            } );
+            
+            typename AllocVector<group_t, AllocT>::type grouped( alloc );
+            grouped.reserve( groups.size() );
+            for ( size_t i = 0; i < groups.size(); ++i ) grouped.push_back( group_t( std::move(index.keys()[i]), std::move(groups[i]) ) );
             
-            std::vector<ElT> res;
-            for ( auto& it : ordering )
+            if ( order == SORTED_KEYS )
             {
-                res.push_back( *it );
+                sortRange( grouped.begin(), grouped.end(), []( const group_t& l, const group_t& r ) { return l.first < r.first; }, false, grouped.get_allocator() );
             }
-            
-            ContainerWrapper<std::vector<ElT>,  ElT> vw( res );
-            return vw;
+            return ContainerWrapper<typename AllocVector<group_t, AllocT>::type, group_t>( std::move(grouped) );
         }
         
-        template<typename SetOrdering>
-        ContainerWrapper<std::vector<ElT>, ElT> distinctWith( SetOrdering cmp )
+        // Hash-based countBy, as groupBy above
+        template<typename KeyFunctorT>
+        auto countBy( KeyFunctorT keyFn, KeyOrder order ) ->
+            ContainerWrapper<
+                std::vector<typename Counting<KeyFunctorT, std::allocator<mutable_value_type>>::count_t>,
+                typename Counting<KeyFunctorT, std::allocator<mutable_value_type>>::count_t>
         {
-            // Same pattern as distinct above
-            std::set<ElT, SetOrdering> seen( cmp );
-            std::vector<typename std::set<ElT>::iterator> ordering;
+            return countBy( keyFn, order, std::allocator<mutable_value_type>() );
+        }
+        
+        template<typename KeyFunctorT, typename AllocT>
+        auto countBy( KeyFunctorT keyFn, KeyOrder order, const AllocT& alloc ) ->
+            ContainerWrapper<
+                typename AllocVector<typename Counting<KeyFunctorT, AllocT>::count_t, AllocT>::type,
+                typename Counting<KeyFunctorT, AllocT>::count_t>
+        {
+            typedef typename Counting<KeyFunctorT, AllocT>::key_t key_t;
+            typedef typename Counting<KeyFunctorT, AllocT>::count_t count_t;
+            static_assert( IsHashable<key_t>::value, "countBy with a KeyOrder requires a hashable key" );
+            
+            DenseHashIndex<key_t, ElementHash<key_t>, ElementEqual<key_t>, typename RebindAlloc<AllocT, key_t>::type> index( alloc );
+            typename AllocVector<size_t, AllocT>::type counts( alloc );
             auto it = get().getIterator();
-            while ( it.hasNext() )
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&]( it_el_t v )
             {
-                auto res = seen.insert( it.next() );
-                if ( res.second ) ordering.push_back( res.first );
-            }
+                auto res = index.insert( keyFn(v) );
+                if ( res.second ) counts.push_back( 1 );
+                else counts[res.first]++;
+            } );
+            
+            typename AllocVector<count_t, AllocT>::type counted( alloc );
+            counted.reserve( counts.size() );
+            for ( size_t i = 0; i < counts.size(); ++i ) counted.push_back( count_t( std::move(index.keys()[i]), counts[i] ) );
             
-            std::vector<ElT> res;
-            for ( auto& it : ordering )
+            if ( order == SORTED_KEYS )
             {
-                res.push_back( *it );
+                sortRange( counted.begin(), counted.end(), []( const count_t& l, const count_t& r ) { return l.first < r.first; }, false, counted.get_allocator() );
             }
-            
-            ContainerWrapper<std::vector<ElT>,  ElT> vw( std::move(res) );
-            return vw;
+            return ContainerWrapper<typename AllocVector<count_t, AllocT>::type, count_t>( std::move(counted) );
+        }
+        
+        // Lazily keeps the first occurrence of each element, in order
+        DistinctWrapper<BaseT, CopyStripConstFunctor<const ElT&>, ElT, typename DefaultSeenSet<retained_value_type>::type> distinct()
+        {
+            return distinct( std::allocator<retained_value_type>() );
+        }
+        
+        // As distinct, with the elements seen kept in memory from alloc
+        template<typename AllocT>
+        DistinctWrapper<BaseT, CopyStripConstFunctor<const ElT&>, ElT, typename DefaultSeenSet<retained_value_type, AllocT>::type> distinct( const AllocT& alloc )
+        {
+            typedef typename DefaultSeenSet<retained_value_type, AllocT>::type seen_t;
+            return DistinctWrapper<BaseT, CopyStripConstFunctor<const ElT&>, ElT, seen_t>(
+                std::move(get().getIterator()), CopyStripConstFunctor<const ElT&>(), seen_t( typename DefaultSeenSet<retained_value_type, AllocT>::alloc_t( alloc ) ) );
+        }
+        
+        // As distinct, with equivalence defined by the set ordering cmp
+        template<typename SetOrdering>
+        DistinctWrapper<BaseT, CopyStripConstFunctor<const ElT&>, ElT, OrderedSeenSet<retained_value_type, SetOrdering>> distinctWith( SetOrdering cmp )
+        {
+            typedef OrderedSeenSet<retained_value_type, SetOrdering> seen_t;
+            return DistinctWrapper<BaseT, CopyStripConstFunctor<const ElT&>, ElT, seen_t>(
+                std::move(get().getIterator()), CopyStripConstFunctor<const ElT&>(), seen_t( cmp ) );
+        }
+        
+        // Lazily keeps the first element with each distinct keyFn( element )
+        template<typename KeyFunctorT>
+        DistinctWrapper<BaseT, KeyFunctorT, ElT, typename DefaultSeenSet<typename RetainedElement<typename std::decay<typename FunctorHelper<KeyFunctorT, ElT>::out_t>::type>::type>::type>
+        distinctBy( KeyFunctorT keyFn )
+        {
+            typedef typename DefaultSeenSet<typename RetainedElement<typename std::decay<typename FunctorHelper<KeyFunctorT, ElT>::out_t>::type>::type>::type seen_t;
+            return DistinctWrapper<BaseT, KeyFunctorT, ElT, seen_t>( std::move(get().getIterator()), keyFn, seen_t() );
         }
         
         template<typename FunctorT, typename AccT>
         AccT fold( AccT init, FunctorT fn )
         {
             auto it = get().getIterator();
-            while ( it.hasNext() )
-            {
-                init = fn( init, it.next() );
-            }
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&init, &fn]( it_el_t v ) { init = fn( init, std::forward<it_el_t>(v) ); } );
             return init;
         }
         
@@ -400,26 +825,28 @@ namespace navetas { namespace escalator {
         {
             size_t count = 0;
             auto it = get().getIterator();
-            while ( it.hasNext() )
-            {
-                it.next();
-                count++;
-            }
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&count]( it_el_t ) { count++; } );
             return count;
         }
         
+        // The number of elements satisfying pred
+        template<typename FunctorT>
+        size_t count( FunctorT pred )
+        {
+            auto it = get().getIterator();
+            return countOf( it, pred, typename IsSimdReducible<decltype(it)>::type() );
+        }
+        
+        // Over contiguous floats or doubles the sum is accumulated in several
+        // lanes, so may round slightly differently to a sequential loop
         mutable_value_type sum()
         {
             auto it = get().getIterator();
             ESCALATOR_ASSERT( it.hasNext(), "Sum over insufficient items" );
             
-            mutable_value_type acc = it.next();
-
-            while ( it.hasNext() )
-            {
-                acc += it.next();
-            }
-            return acc;
+            size_t count;
+            return sumOf( it, count, typename IsSimdReducible<decltype(it)>::type() );
         }
         
         mutable_value_type mean()
@@ -427,106 +854,178 @@ namespace navetas { namespace escalator {
             auto it = get().getIterator();
             ESCALATOR_ASSERT( it.hasNext(), "Mean over insufficient items" );
             
-            size_t count = 1;
-            mutable_value_type acc = it.next();
-            while ( it.hasNext() )
-            {
-                acc += it.next();
-                count++;
-            }
-            
+            size_t count;
+            mutable_value_type acc = sumOf( it, count, typename IsSimdReducible<decltype(it)>::type() );
             return acc / static_cast<double>(count);
         }
         
         mutable_value_type median()
         {
-            auto it = get().getIterator();
-            ESCALATOR_ASSERT( it.hasNext(), "Median over insufficient items" );
-            
-            std::vector<ElT> values;
-            size_t count = 0;
-            while ( it.hasNext() )
-            {
-                values.push_back( it.next() );
-                count++;
-            }
-            std::sort( values.begin(), values.end() );
+            return median( std::allocator<mutable_value_type>() );
+        }
+        
+        // As median, with the copy of the elements selected from kept in
+        // memory from alloc
+        template<typename AllocT>
+        mutable_value_type median( const AllocT& alloc )
+        {
+            typename AllocVector<mutable_value_type, AllocT>::type values = orderStatisticBuffer( "Median", alloc );
+            size_t count = values.size();
             
             if ( count & 1 )
             {
+                size_t ranks[] = { count/2 };
+                selectRanks( values.begin(), values.end(), ranks, ranks + 1, std::less<mutable_value_type>() );
                 return values[count/2];
             }
             else
             {
+                size_t ranks[] = { (count/2)-1, count/2 };
+                selectRanks( values.begin(), values.end(), ranks, ranks + 2, std::less<mutable_value_type>() );
                 return (values[count/2] + values[(count/2)-1]) / 2.0;
             }
         }
         
-        // TODO: Should these use boost::optional to work round init requirements?
-        std::pair<size_t, mutable_value_type> argMin()
+        // Interpolating between integers gives fractions, so their quantiles
+        // are doubles
+        typedef typename std::conditional<std::is_integral<mutable_value_type>::value, double, mutable_value_type>::type quantile_value_type;
+        
+        // The p-quantile for each p in [0, 1] of ps, interpolating linearly
+        // between the closest ranks (so the 0.5-quantile is the median). All are
+        // selected from one buffer in a single pass over the input.
+        std::vector<quantile_value_type> quantiles( const std::vector<double>& ps )
         {
-            bool init = true;
-            mutable_value_type ext = mutable_value_type();
+            return quantiles( ps, std::allocator<mutable_value_type>() );
+        }
+        
+        template<typename AllocT>
+        std::vector<quantile_value_type> quantiles( const std::vector<double>& ps, const AllocT& alloc )
+        {
+            typename AllocVector<mutable_value_type, AllocT>::type values = orderStatisticBuffer( "Quantiles", alloc );
+            size_t count = values.size();
             
-            size_t minIndex = 0;
-            auto it = get().getIterator();
-            for ( int i = 0; it.hasNext(); ++i )
+            std::vector<size_t> ranks;
+            ranks.reserve( ps.size() * 2 );
+            for ( double p : ps )
             {
-                if ( init ) ext = it.next();
-                else
-                {
-                    auto n = it.next();
-                    if ( n < ext )
-                    {
-                        ext = n;
-                        minIndex = i;
-                    }
-                }
-                init = false;
+                ESCALATOR_ASSERT( p >= 0.0 && p <= 1.0, "Quantile out of range: " << p );
+                size_t lower = static_cast<size_t>( p * (count - 1) );
+                ranks.push_back( lower );
+                if ( lower + 1 < count ) ranks.push_back( lower + 1 );
+            }
+            std::sort( ranks.begin(), ranks.end() );
+            ranks.erase( std::unique( ranks.begin(), ranks.end() ), ranks.end() );
+            selectRanks( values.begin(), values.end(), ranks.begin(), ranks.end(), std::less<mutable_value_type>() );
+            
+            std::vector<quantile_value_type> res;
+            res.reserve( ps.size() );
+            for ( double p : ps )
+            {
+                double position = p * (count - 1);
+                size_t lower = static_cast<size_t>( position );
+                double fraction = position - static_cast<double>( lower );
+                
+                quantile_value_type below = values[lower];
+                if ( fraction == 0.0 ) res.push_back( below );
+                else res.push_back( below + (static_cast<quantile_value_type>( values[lower + 1] ) - below) * fraction );
             }
-            return std::make_pair( minIndex, ext );
+            return res;
         }
         
-        std::pair<size_t, mutable_value_type> argMax()
+        // Feed every element to each of the aggregators (see aggregate.hpp) in
+        // one traversal, and return a tuple of their results, e.g.
+        //     std::tie( n, total, top ) = lift(v).aggregate( agg::count(), agg::sum(), agg::max() );
+        // The aggregators see retained elements, so string views are copied
+        // before min/max or countBy keep them.
+        template<typename... AggTs>
+        typename Aggregation<retained_value_type, AggTs...>::result_type aggregate( const AggTs&... aggs )
         {
-            bool init = true;
-            mutable_value_type ext = mutable_value_type();
-            
-            size_t maxIndex = 0;
+            Aggregation<retained_value_type, AggTs...> aggregation( aggs... );
             auto it = get().getIterator();
-            for ( int i = 0; it.hasNext(); ++i )
-            {
-                if ( init ) ext = it.next();
-                else
-                {
-                    auto n = it.next();
-                    if ( n > ext )
-                    {
-                        ext = n;
-                        maxIndex = i;
-                    }
-                }
-                init = false;
-            }
-            return std::make_pair( maxIndex, ext );
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&aggregation]( it_el_t v ) { aggregation.insert( retainElement( std::forward<it_el_t>(v) ) ); } );
+            return aggregation.result();
         }
         
-        mutable_value_type min() { return std::template get<1>(argMin()); }
-        mutable_value_type max() { return std::template get<1>(argMax()); }
+        // count, sum, mean, variance, min and max, from a single pass
+        Stats<mutable_value_type> stats()
+        {
+            Stats<mutable_value_type> stats;
+            auto it = get().getIterator();
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&stats]( it_el_t v ) { stats.insert( v ); } );
+            return stats;
+        }
+        
+        // A fixed-memory summary of the distribution of the elements, for
+        // quantiles of input too large to buffer (see QuantileSketch)
+        QuantileSketch<mutable_value_type> quantileSketch( double rankError=0.01 )
+        {
+            QuantileSketch<mutable_value_type> sketch( rankError );
+            auto it = get().getIterator();
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            drain( it, [&sketch]( it_el_t v ) { sketch.insert( std::forward<it_el_t>(v) ); } );
+            return sketch;
+        }
+        
+        std::vector<mutable_value_type> approxQuantiles( const std::vector<double>& ps, double rankError=0.01 )
+        {
+            return quantileSketch( rankError ).quantiles( ps );
+        }
+        
+        std::pair<size_t, retained_value_type> argMin()
+        {
+            auto it = get().getIterator();
+            return argExtremumOf<false>( it, typename IsSimdReducible<decltype(it)>::type() );
+        }
+        
+        std::pair<size_t, retained_value_type> argMax()
+        {
+            auto it = get().getIterator();
+            return argExtremumOf<true>( it, typename IsSimdReducible<decltype(it)>::type() );
+        }
+        
+        retained_value_type min() { return std::template get<1>(argMin()); }
+        retained_value_type max() { return std::template get<1>(argMax()); }
         
         std::string mkString( const std::string& sep )
         {
-            std::stringstream ss;
-            bool init = true;
+            std::string res;
+            mkStringInto( res, sep );
+            return res;
+        }
+        
+        // Append the elements, separated by sep, to out: clear() a string and
+        // pass it again to reuse its buffer. Where the number of elements is
+        // known exactly, out is sized up front from the length of the first.
+        std::string& mkStringInto( std::string& out, const std::string& sep )
+        {
+            StringBuilder builder( out );
             auto it = get().getIterator();
-            while ( it.hasNext() )
+            typedef typename IteratorElement<decltype(it)>::type it_el_t;
+            if ( it.hasNext() )
             {
-                if ( !init ) ss << sep;
-                auto val = it.next();
-                ss << static_cast<const mutable_value_type&>(val);
-                init = false;
+                SizeHint hint = sizeHintOf( it );
+                size_t start = out.size();
+                
+                auto first = it.next();
+                builder.append( static_cast<const mutable_value_type&>(first) );
+                if ( hint.isExact() && hint.size() > 1 )
+                {
+                    // A little over, so that longer later elements do not force
+                    // a doubling. Upper bounds (e.g. from a filter) can be far
+                    // too loose to reserve on.
+                    size_t each = out.size() - start + sep.size();
+                    size_t per = each + each / 8;
+                    size_t rest = hint.size() - 1;
+                    if ( per > 0 && rest <= ( out.max_size() - out.size() ) / per ) builder.reserve( out.size() + rest * per );
+                }
+                drain( it, [&builder, &sep]( it_el_t val )
+                {
+                    builder.append( sep ).append( static_cast<const mutable_value_type&>(val) );
+                } );
             }
-            return ss.str();
+            return out;
         }
         
         double increasing();
@@ -0,0 +1,523 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Field parsers convert the text of one field, returning false if it is
+    // not of the type. They neither allocate nor depend on the locale. Numbers
+    // may be surrounded by spaces or tabs.
+    template<typename T, typename Enable=void>
+    struct FieldParser;
+
+    inline const char* skipBlanks( const char* p, const char* end )
+    {
+        while ( p != end && ( *p == ' ' || *p == '\t' ) ) ++p;
+        return p;
+    }
+
+    inline const char* skipBlanksBack( const char* begin, const char* end )
+    {
+        while ( end != begin && ( end[-1] == ' ' || end[-1] == '\t' ) ) --end;
+        return end;
+    }
+
+    template<typename T>
+    struct FieldParser<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+    {
+        static const char* description() { return "an integer"; }
+
+        static bool parse( StringView field, T& out )
+        {
+            typedef typename std::make_unsigned<T>::type unsigned_t;
+
+            const char* p = skipBlanks( field.begin(), field.end() );
+            const char* end = skipBlanksBack( p, field.end() );
+
+            bool negative = p != end && *p == '-';
+            if ( p != end && ( *p == '-' || *p == '+' ) ) ++p;
+            if ( p == end || ( negative && std::is_unsigned<T>::value ) ) return false;
+
+            unsigned_t limit = static_cast<unsigned_t>( std::numeric_limits<T>::max() ) + ( negative ? 1 : 0 );
+            unsigned_t value = 0;
+            for ( ; p != end; ++p )
+            {
+                unsigned_t digit = static_cast<unsigned_t>( *p - '0' );
+                if ( digit > 9 || value > ( limit - digit ) / 10 ) return false;
+                value = value * 10 + digit;
+            }
+
+            out = negative && value > 0 ? static_cast<T>( -static_cast<T>( value - 1 ) - 1 ) : static_cast<T>( value );
+            return true;
+        }
+    };
+
+    // Up to 19 significant digits with a small decimal exponent are exactly
+    // representable as a mantissa and power of ten, both within double
+    // precision, so one multiplication or division rounds correctly (Clinger's
+    // fast path). Anything else (long mantissas, large exponents, inf/nan) goes
+    // to strtod, with the decimal point swapped for the locale's.
+    template<typename T>
+    struct FieldParser<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+        static const char* description() { return "a number"; }
+
+        static bool parse( StringView field, T& out )
+        {
+            const char* begin = skipBlanks( field.begin(), field.end() );
+            const char* end = skipBlanksBack( begin, field.end() );
+
+            double value;
+            if ( !parseFast( begin, end, value ) && !parseSlow( begin, end, value ) ) return false;
+            out = static_cast<T>( value );
+            return true;
+        }
+
+    private:
+        static bool parseFast( const char* p, const char* end, double& out )
+        {
+            static const double powers[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+            bool negative = p != end && *p == '-';
+            if ( p != end && ( *p == '-' || *p == '+' ) ) ++p;
+
+            uint64_t mantissa = 0;
+            int digits = 0;
+            int exponent = 0;
+            bool any = false;
+            for ( ; p != end && static_cast<unsigned>( *p - '0' ) < 10; ++p, any = true )
+            {
+                if ( digits == 19 ) return false;
+                mantissa = mantissa * 10 + static_cast<unsigned>( *p - '0' );
+                if ( mantissa != 0 ) digits++;
+            }
+            if ( p != end && *p == '.' )
+            {
+                for ( ++p; p != end && static_cast<unsigned>( *p - '0' ) < 10; ++p, any = true )
+                {
+                    if ( digits == 19 ) return false;
+                    mantissa = mantissa * 10 + static_cast<unsigned>( *p - '0' );
+                    if ( mantissa != 0 ) digits++;
+                    exponent--;
+                }
+            }
+            if ( !any ) return false;
+
+            if ( p != end && ( *p == 'e' || *p == 'E' ) )
+            {
+                ++p;
+                bool negativeExponent = p != end && *p == '-';
+                if ( p != end && ( *p == '-' || *p == '+' ) ) ++p;
+                if ( p == end ) return false;
+
+                int e = 0;
+                for ( ; p != end && static_cast<unsigned>( *p - '0' ) < 10; ++p )
+                {
+                    if ( e > 1000 ) return false;
+                    e = e * 10 + ( *p - '0' );
+                }
+                exponent += negativeExponent ? -e : e;
+            }
+            if ( p != end || mantissa > ( uint64_t(1) << 53 ) || exponent < -22 || exponent > 22 ) return false;
+
+            double value = static_cast<double>( mantissa );
+            value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+            out = negative ? -value : value;
+            return true;
+        }
+
+        static bool parseSlow( const char* begin, const char* end, double& out )
+        {
+            char buffer[128];
+            size_t size = end - begin;
+            if ( size == 0 || size >= sizeof(buffer) ) return false;
+
+            char point = *std::localeconv()->decimal_point;
+            for ( size_t i = 0; i < size; ++i )
+            {
+                buffer[i] = begin[i];
+                // A locale's decimal point would otherwise be accepted too
+                if ( begin[i] == point && point != '.' ) return false;
+                if ( begin[i] == '.' ) buffer[i] = point;
+            }
+            buffer[size] = '\0';
+
+            char* parsed;
+            out = std::strtod( buffer, &parsed );
+            return parsed == buffer + size;
+        }
+    };
+
+    template<>
+    struct FieldParser<bool>
+    {
+        static const char* description() { return "a boolean"; }
+
+        static bool parse( StringView field, bool& out )
+        {
+            const char* begin = skipBlanks( field.begin(), field.end() );
+            StringView trimmed( begin, skipBlanksBack( begin, field.end() ) - begin );
+            if ( trimmed == StringView( "true" ) || trimmed == StringView( "1" ) ) out = true;
+            else if ( trimmed == StringView( "false" ) || trimmed == StringView( "0" ) ) out = false;
+            else return false;
+            return true;
+        }
+    };
+
+    template<>
+    struct FieldParser<StringView>
+    {
+        static const char* description() { return "text"; }
+        static bool parse( StringView field, StringView& out ) { out = field; return true; }
+    };
+
+    template<>
+    struct FieldParser<std::string>
+    {
+        static const char* description() { return "text"; }
+        static bool parse( StringView field, std::string& out ) { out.assign( field.data(), field.size() ); return true; }
+    };
+
+    // The columns to extract from delimited records, and their types. Columns
+    // are chosen by index, or by name from a header line. Only the columns up
+    // to the last one chosen are ever split out, and only the chosen ones are
+    // converted.
+    template<typename... Ts>
+    class CsvSchema
+    {
+    public:
+        static_assert( sizeof...(Ts) > 0, "A CSV schema needs at least one column" );
+
+        CsvSchema( const std::vector<size_t>& columns ) :
+            m_columns(columns), m_delimiter(','), m_quote('"'), m_header(false), m_trim(false)
+        {
+            ESCALATOR_ASSERT( m_columns.size() == sizeof...(Ts), "Schema of " << sizeof...(Ts) << " types given " << m_columns.size() << " columns" );
+        }
+
+        CsvSchema( const std::vector<std::string>& names ) :
+            m_names(names), m_delimiter(','), m_quote('"'), m_header(true), m_trim(false)
+        {
+            ESCALATOR_ASSERT( m_names.size() == sizeof...(Ts), "Schema of " << sizeof...(Ts) << " types given " << m_names.size() << " columns" );
+        }
+
+        CsvSchema withDelimiter( char delimiter ) const { CsvSchema s( *this ); s.m_delimiter = delimiter; return s; }
+        CsvSchema withQuote( char quote ) const { CsvSchema s( *this ); s.m_quote = quote; return s; }
+
+        // Skip a header line (implied where columns are named)
+        CsvSchema withHeader() const { CsvSchema s( *this ); s.m_header = true; return s; }
+
+        // Strip spaces and tabs around text fields (numbers always allow them)
+        CsvSchema withTrimmedFields() const { CsvSchema s( *this ); s.m_trim = true; return s; }
+
+        const std::vector<size_t>& columns() const { return m_columns; }
+        const std::vector<std::string>& names() const { return m_names; }
+        char delimiter() const { return m_delimiter; }
+        char quote() const { return m_quote; }
+        bool header() const { return m_header; }
+        bool trim() const { return m_trim; }
+
+    private:
+        std::vector<size_t>         m_columns;
+        std::vector<std::string>    m_names;
+        char                        m_delimiter;
+        char                        m_quote;
+        bool                        m_header;
+        bool                        m_trim;
+    };
+
+    // The first sizeof...(Ts) columns
+    template<typename... Ts>
+    CsvSchema<Ts...> csvSchema()
+    {
+        std::vector<size_t> columns;
+        for ( size_t i = 0; i < sizeof...(Ts); ++i ) columns.push_back( i );
+        return CsvSchema<Ts...>( columns );
+    }
+
+    template<typename... Ts>
+    CsvSchema<Ts...> csvSchema( const std::vector<size_t>& columns )
+    {
+        return CsvSchema<Ts...>( columns );
+    }
+
+    template<typename... Ts>
+    CsvSchema<Ts...> csvSchemaByName( const std::vector<std::string>& names )
+    {
+        return CsvSchema<Ts...>( names );
+    }
+
+    // Rows of delimited text parsed into tuples, from a source of lines
+    // (std::strings or StringViews). Fields may be quoted, with the quote
+    // doubled inside them, though not span lines. Blank lines are skipped and a
+    // trailing '\r' is ignored. StringView columns view the line, so are valid
+    // until the next row is read (and no longer than the source's own lines).
+    // Malformed rows throw ParseError.
+    template<typename Source, typename... Ts>
+    class CsvWrapper : public Conversions<CsvWrapper<Source, Ts...>, std::tuple<Ts...>, std::tuple<Ts...>>
+    {
+    public:
+        typedef std::tuple<Ts...> row_t;
+
+        CsvWrapper( typename Source::Iterator&& source, const CsvSchema<Ts...>& schema ) :
+            m_source(std::move(source)), m_schema(schema), m_line(0), m_headerDone(!schema.header()),
+            m_lastColumn(0), m_requirePopulateNext(true), m_hasNext(false)
+        {
+            if ( schema.names().empty() ) selectColumns( schema.columns() );
+        }
+
+        typedef CsvWrapper<Source, Ts...> Iterator;
+        Iterator& getIterator() { return *this; }
+
+        bool hasNext()
+        {
+            populateNext();
+            return m_hasNext;
+        }
+
+        row_t next()
+        {
+            populateNext();
+            m_requirePopulateNext = true;
+            return std::move(m_next);
+        }
+
+        // Header and blank lines are dropped
+        SizeHint sizeHint() { return sizeHintOf( m_source ).asUpperBound(); }
+
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type line_el_t;
+
+            if ( !m_requirePopulateNext )
+            {
+                m_requirePopulateNext = true;
+                if ( m_hasNext && !feed( sink, std::move(m_next) ) ) return false;
+            }
+
+            // Lines are only needed while their row is fed, so are never copied
+            row_t row;
+            return m_source.pushAll( [this, &sink, &row]( line_el_t line ) -> bool
+            {
+                return !parseLine( StringView( line ), row ) || feed( sink, std::move(row) );
+            } );
+        }
+
+    private:
+        typedef typename MakeIndexSequence<sizeof...(Ts)>::type indices_t;
+
+        void populateNext()
+        {
+            if ( !m_requirePopulateNext ) return;
+            m_requirePopulateNext = false;
+
+            m_hasNext = false;
+            while ( m_source.hasNext() )
+            {
+                if ( parseLine( holdLine( m_source.next() ), m_next ) )
+                {
+                    m_hasNext = true;
+                    return;
+                }
+            }
+        }
+
+        // Pulled rows outlive their line, so string lines are kept until the next
+        StringView holdLine( StringView line ) { return line; }
+
+        StringView holdLine( std::string line )
+        {
+            m_heldLine = std::move(line);
+            return m_heldLine;
+        }
+
+        // Parse line into row, returning false for lines that are not rows
+        bool parseLine( StringView line, row_t& row )
+        {
+            m_line++;
+            if ( !line.empty() && line[line.size() - 1] == '\r' ) line = line.substr( 0, line.size() - 1 );
+            if ( line.empty() ) return false;
+
+            if ( !m_headerDone )
+            {
+                m_headerDone = true;
+                if ( !m_schema.names().empty() ) selectNamedColumns( line );
+                return false;
+            }
+
+            splitFields( line );
+            convert( row, indices_t() );
+            return true;
+        }
+
+        void selectColumns( const std::vector<size_t>& columns )
+        {
+            m_columns = columns;
+            m_lastColumn = *std::max_element( columns.begin(), columns.end() );
+            m_slotOf.assign( m_lastColumn + 1, -1 );
+            for ( size_t slot = 0; slot < columns.size(); ++slot )
+            {
+                ESCALATOR_ASSERT( m_slotOf[columns[slot]] == -1, "Column " << columns[slot] << " selected twice" );
+                m_slotOf[columns[slot]] = static_cast<int>( slot );
+            }
+        }
+
+        void selectNamedColumns( StringView header )
+        {
+            std::vector<StringView> names;
+            const char* p = header.begin();
+            while ( true )
+            {
+                const char* fieldEnd;
+                names.push_back( nextField( p, header.end(), -1, fieldEnd ) );
+                if ( fieldEnd == header.end() ) break;
+                p = fieldEnd + 1;
+            }
+
+            std::vector<size_t> columns;
+            for ( const std::string& name : m_schema.names() )
+            {
+                auto found = std::find( names.begin(), names.end(), StringView( name ) );
+                if ( found == names.end() ) fail( "no column named '", name, "' in the header" );
+                columns.push_back( found - names.begin() );
+            }
+            selectColumns( columns );
+        }
+
+        // Find the selected fields, stopping after the last of them
+        void splitFields( StringView line )
+        {
+            const char* p = line.begin();
+            for ( size_t column = 0; ; ++column )
+            {
+                int slot = m_slotOf[column];
+                const char* fieldEnd;
+                StringView field = nextField( p, line.end(), slot, fieldEnd );
+                if ( slot >= 0 ) m_fields[slot] = field;
+
+                if ( column == m_lastColumn ) return;
+                if ( fieldEnd == line.end() ) fail( "expected at least ", m_lastColumn + 1, " columns, found ", column + 1 );
+                p = fieldEnd + 1;
+            }
+        }
+
+        // The field starting at p, setting fieldEnd to the delimiter (or end)
+        // after it. Escaped quotes in selected fields are undone into a buffer
+        // per slot.
+        StringView nextField( const char* p, const char* end, int slot, const char*& fieldEnd )
+        {
+            const char quote = m_schema.quote();
+            const char* start = m_schema.trim() ? skipBlanks( p, end ) : p;
+
+            if ( start == end || *start != quote )
+            {
+                const void* delim = std::memchr( p, m_schema.delimiter(), end - p );
+                fieldEnd = delim ? static_cast<const char*>( delim ) : end;
+                return StringView( start, ( m_schema.trim() ? skipBlanksBack( start, fieldEnd ) : fieldEnd ) - start );
+            }
+
+            const char* content = start + 1;
+            const char* close = content;
+            bool escaped = false;
+            while ( true )
+            {
+                const void* found = close == end ? nullptr : std::memchr( close, quote, end - close );
+                if ( !found ) fail( "unterminated quoted field" );
+                close = static_cast<const char*>( found );
+                if ( close + 1 == end || close[1] != quote ) break;
+                escaped = true;
+                close += 2;
+            }
+
+            fieldEnd = m_schema.trim() ? skipBlanks( close + 1, end ) : close + 1;
+            if ( fieldEnd != end && *fieldEnd != m_schema.delimiter() ) fail( "unexpected text after quoted field" );
+
+            StringView field( content, close - content );
+            if ( !escaped || slot < 0 ) return field;
+
+            std::string& unescaped = m_unescaped[slot];
+            unescaped.clear();
+            for ( const char* c = content; c != close; ++c )
+            {
+                unescaped.push_back( *c );
+                if ( *c == quote ) ++c;
+            }
+            return StringView( unescaped );
+        }
+
+        template<typename... Args>
+        void fail( const Args&... args ) const
+        {
+            std::stringstream ss;
+            ss << "Line " << m_line << ": ";
+            int expand[] = { 0, ( ss << args, 0 )... };
+            (void) expand;
+            throw ParseError( ss.str() );
+        }
+
+        template<size_t... Is>
+        void convert( row_t& row, IndexSequence<Is...> )
+        {
+            int expand[] = { 0, ( convertField( m_fields[Is], m_columns[Is], std::get<Is>( row ) ), 0 )... };
+            (void) expand;
+        }
+
+        template<typename T>
+        void convertField( StringView field, size_t column, T& out ) const
+        {
+            if ( !FieldParser<T>::parse( field, out ) )
+            {
+                fail( "column ", column, ": '", field, "' is not ", FieldParser<T>::description() );
+            }
+        }
+
+        typename Source::Iterator   m_source;
+        CsvSchema<Ts...>            m_schema;
+        size_t                      m_line;
+        bool                        m_headerDone;
+
+        std::vector<size_t>         m_columns;
+        std::vector<int>            m_slotOf;
+        size_t                      m_lastColumn;
+        StringView                  m_fields[sizeof...(Ts)];
+        std::string                 m_unescaped[sizeof...(Ts)];
+
+        std::string                 m_heldLine;
+        bool                        m_requirePopulateNext;
+        bool                        m_hasNext;
+        row_t                       m_next;
+    };
+
+    // Rows of the lines of source, a lifted sequence of std::strings or
+    // StringViews, e.g. lift(stream) or lift_mmap_lines(path)
+    template<typename SourceT, typename... Ts>
+    typename std::enable_if<std::is_base_of<Lifted, SourceT>::value, CsvWrapper<SourceT, Ts...>>::type
+    lift_csv( SourceT source, const CsvSchema<Ts...>& schema )
+    {
+        typename SourceT::Iterator it = source.getIterator();
+        return CsvWrapper<SourceT, Ts...>( std::move(it), schema );
+    }
+
+    template<typename... Ts>
+    CsvWrapper<IStreamWrapper, Ts...> lift_csv( std::istream& stream, const CsvSchema<Ts...>& schema )
+    {
+        return lift_csv( lift(stream), schema );
+    }
+
+#if defined(ESCALATOR_POSIX)
+    // The file at path, mapped
+    template<typename... Ts>
+    CsvWrapper<MmapLinesWrapper, Ts...> lift_csv_file( const std::string& path, const CsvSchema<Ts...>& schema )
+    {
+        return lift_csv( lift_mmap_lines( path ), schema );
+    }
+#endif
+
+}}
+
+#endif
@@ -23,6 +23,15 @@ namespace navetas { namespace escalator {
     template<typename Source, typename FunctorT, typename ElT>
     class FilterWrapper;
     
+    template<typename Source, typename KeyFunctorT, typename ElT, typename SeenT>
+    class DistinctWrapper;
+    
+    template<typename Source, typename FunctorT, typename ElT>
+    class TakeWhileWrapper;
+    
+    template<typename Source, typename FunctorT, typename ElT>
+    class DropWhileWrapper;
+    
     template<typename IterT, template<typename> class FunctorT>
     class IteratorWrapper;
     
@@ -35,6 +44,38 @@ namespace navetas { namespace escalator {
     template<typename Source1T, typename El1T, typename Source2T, typename El2T>
     class ZipWrapper;
 
+    struct ParallelIdentityStage;
+    
+    template<typename IterT, template<typename> class FunctorT, typename StageT>
+    class ParallelWrapper;
+
+    template<typename RandomIt, typename CompareT>
+    void sortRange( RandomIt begin, RandomIt end, CompareT cmp, bool stable );
+
+    template<typename RandomIt, typename CompareT, typename AllocT>
+    void sortRange( RandomIt begin, RandomIt end, CompareT cmp, bool stable, const AllocT& alloc );
+    
+    template<typename RandomIt, typename RankIt, typename CompareT>
+    void selectRanks( RandomIt begin, RandomIt end, RankIt ranksBegin, RankIt ranksEnd, CompareT cmp );
+    
+    template<typename IteratorT>
+    struct IsSimdReducible;
+    
+    template<typename T>
+    struct SimdKernels;
+    
+    template<typename T, typename CompareT=std::less<T>>
+    class QuantileSketch;
+    
+    template<typename T>
+    class Stats;
+    
+    template<typename AggT, typename ElT, typename Enable=void>
+    struct AggregatorFor;
+    
+    template<typename ElT, typename... AggTs>
+    class Aggregation;
+    
     template<typename ContainerT>
     IteratorWrapper<
         typename ContainerT::const_iterator,
@@ -0,0 +1,207 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Types the hash-based operations (distinct, and groupBy/countBy with a
+    // KeyOrder) accept as keys. Specialise this, along with std::hash or
+    // ElementHash, to enable them for other types.
+    template<typename T>
+    struct IsHashable : public std::integral_constant<bool,
+        std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value ||
+        std::is_same<T, std::string>::value>
+    {
+    };
+
+    template<typename T1, typename T2>
+    struct IsHashable<std::pair<T1, T2>> : public std::integral_constant<bool,
+        IsHashable<T1>::value && IsHashable<T2>::value>
+    {
+    };
+
+    template<typename T, typename Enable=void>
+    struct ElementHash : public std::hash<T>
+    {
+    };
+
+    template<typename T>
+    struct ElementHash<T, typename std::enable_if<std::is_enum<T>::value>::type>
+    {
+        size_t operator()( T v ) const
+        {
+            typedef typename std::underlying_type<T>::type underlying_t;
+            return std::hash<underlying_t>()( static_cast<underlying_t>( v ) );
+        }
+    };
+
+    template<typename T1, typename T2>
+    struct ElementHash<std::pair<T1, T2>>
+    {
+        template<typename U1, typename U2>
+        size_t operator()( const std::pair<U1, U2>& v ) const
+        {
+            size_t h = ElementHash<T1>()( v.first );
+            return h ^ ( ElementHash<T2>()( v.second ) + 0x9e3779b9 + ( h << 6 ) + ( h >> 2 ) );
+        }
+    };
+
+    // Key equality that lets a key be probed for by any type comparable with
+    // it, e.g. a std::string key by a StringView, without converting the probe
+    template<typename T>
+    struct ElementEqual
+    {
+        template<typename U>
+        bool operator()( const T& key, const U& probe ) const { return key == probe; }
+    };
+
+    template<typename T1, typename T2>
+    struct ElementEqual<std::pair<T1, T2>>
+    {
+        template<typename U1, typename U2>
+        bool operator()( const std::pair<T1, T2>& key, const std::pair<U1, U2>& probe ) const
+        {
+            return ElementEqual<T1>()( key.first, probe.first ) && ElementEqual<T2>()( key.second, probe.second );
+        }
+    };
+
+    // Maps each distinct key to a dense index, in the order keys were first
+    // seen. The keys are stored contiguously in that order, and the table
+    // itself is open-addressed with linear probing over (hash, index) slots, so
+    // an insert costs a hash and usually a single probe, with no per-key
+    // allocation. Callers keep any per-key values in vectors alongside.
+    template<typename KeyT, typename HashT=ElementHash<KeyT>, typename EqualT=ElementEqual<KeyT>, typename AllocT=std::allocator<KeyT>>
+    class DenseHashIndex
+    {
+    private:
+        struct Slot;
+        
+        typedef std::vector<Slot, typename RebindAlloc<AllocT, Slot>::type> slots_t;
+        
+    public:
+        typedef std::vector<KeyT, typename RebindAlloc<AllocT, KeyT>::type> keys_t;
+        
+        explicit DenseHashIndex( const AllocT& alloc=AllocT() ) : m_slots(alloc), m_keys(alloc), m_shift(0)
+        {
+        }
+
+        void reserve( size_t count )
+        {
+            m_keys.reserve( count );
+            while ( count * 10 > m_slots.size() * 7 ) rehash( std::max<size_t>( 16, m_slots.size() * 2 ) );
+        }
+
+        // Returns the key's index, and whether it was newly inserted
+        template<typename K>
+        std::pair<size_t, bool> insert( K&& key )
+        {
+            if ( ( m_keys.size() + 1 ) * 10 > m_slots.size() * 7 ) rehash( std::max<size_t>( 16, m_slots.size() * 2 ) );
+
+            size_t hash = m_hash( key );
+            size_t mask = m_slots.size() - 1;
+            for ( size_t pos = slotFor( hash ); ; pos = ( pos + 1 ) & mask )
+            {
+                Slot& slot = m_slots[pos];
+                if ( slot.index == Empty )
+                {
+                    slot.index = m_keys.size();
+                    slot.hash = hash;
+                    m_keys.push_back( std::forward<K>(key) );
+                    return std::make_pair( slot.index, true );
+                }
+                if ( slot.hash == hash && m_equal( m_keys[slot.index], key ) )
+                {
+                    return std::make_pair( slot.index, false );
+                }
+            }
+        }
+
+        size_t size() const { return m_keys.size(); }
+
+        // In first-seen order
+        const keys_t& keys() const { return m_keys; }
+        keys_t& keys() { return m_keys; }
+
+    private:
+        static const size_t Empty = static_cast<size_t>( -1 );
+
+        struct Slot
+        {
+            size_t index;
+            size_t hash;
+        };
+
+        // Fibonacci hashing spreads weak hashes (e.g. the identity on integers)
+        // across the table
+        size_t slotFor( size_t hash ) const
+        {
+            return static_cast<size_t>( hash * static_cast<size_t>( 11400714819323198485ull ) ) >> m_shift;
+        }
+
+        void rehash( size_t capacity )
+        {
+            m_shift = sizeof(size_t) * 8;
+            for ( size_t c = capacity; c > 1; c >>= 1 ) m_shift--;
+
+            Slot empty = { Empty, 0 };
+            slots_t old( capacity, empty, m_slots.get_allocator() );
+            std::swap( old, m_slots );
+
+            size_t mask = capacity - 1;
+            for ( const Slot& slot : old )
+            {
+                if ( slot.index == Empty ) continue;
+
+                size_t pos = slotFor( slot.hash );
+                while ( m_slots[pos].index != Empty ) pos = ( pos + 1 ) & mask;
+                m_slots[pos] = slot;
+            }
+        }
+
+        slots_t             m_slots;
+        keys_t              m_keys;
+        size_t              m_shift;
+        HashT               m_hash;
+        EqualT              m_equal;
+    };
+
+    // Seen-sets for distinct: insert returns true the first time a key is seen
+    template<typename KeyT, typename AllocT=std::allocator<KeyT>>
+    class HashSeenSet
+    {
+    public:
+        explicit HashSeenSet( const AllocT& alloc=AllocT() ) : m_index( alloc ) {}
+        
+        template<typename K>
+        bool insert( K&& key ) { return m_index.insert( std::forward<K>(key) ).second; }
+        
+    private:
+        DenseHashIndex<KeyT, ElementHash<KeyT>, ElementEqual<KeyT>, AllocT> m_index;
+    };
+
+    template<typename KeyT, typename CompareT, typename AllocT=std::allocator<KeyT>>
+    class OrderedSeenSet
+    {
+    public:
+        OrderedSeenSet( CompareT cmp=CompareT(), const AllocT& alloc=AllocT() ) : m_set( cmp, alloc ) {}
+        
+        template<typename K>
+        bool insert( K&& key ) { return m_set.insert( std::forward<K>(key) ).second; }
+        
+    private:
+        std::set<KeyT, CompareT, AllocT> m_set;
+    };
+
+    template<typename KeyT, typename AllocT=std::allocator<KeyT>>
+    struct DefaultSeenSet
+    {
+        typedef typename RebindAlloc<AllocT, KeyT>::type alloc_t;
+        typedef typename std::conditional<IsHashable<KeyT>::value,
+            HashSeenSet<KeyT, alloc_t>,
+            OrderedSeenSet<KeyT, std::less<KeyT>, alloc_t>>::type type;
+    };
+
+}}
+
+#endif
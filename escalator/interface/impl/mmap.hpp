@@ -0,0 +1,127 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+#if defined(ESCALATOR_POSIX)
+
+namespace navetas { namespace escalator {
+
+    // Whether to tell the kernel a mapping will be read front to back, so it
+    // reads ahead aggressively and drops pages behind
+    enum MmapAccess
+    {
+        SEQUENTIAL_ACCESS,
+        DEFAULT_ACCESS
+    };
+
+    // A regular file mapped read-only for as long as this lives
+    class MappedFile
+    {
+    public:
+        MappedFile( const std::string& path, MmapAccess access ) : m_data(nullptr), m_size(0)
+        {
+            int fd = ::open( path.c_str(), O_RDONLY );
+            ESCALATOR_ASSERT( fd >= 0, "Failed to open " << path << ": " << std::strerror( errno ) );
+
+            struct stat st;
+            bool statted = ::fstat( fd, &st ) == 0;
+            int error = errno;
+            void* mapped = MAP_FAILED;
+            if ( statted && st.st_size > 0 )
+            {
+                mapped = ::mmap( nullptr, static_cast<size_t>( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+                error = errno;
+            }
+            // The mapping keeps the file open
+            ::close( fd );
+
+            ESCALATOR_ASSERT( statted, "Failed to stat " << path << ": " << std::strerror( error ) );
+            if ( st.st_size == 0 ) return;
+            ESCALATOR_ASSERT( mapped != MAP_FAILED, "Failed to map " << path << ": " << std::strerror( error ) );
+
+            m_data = static_cast<const char*>( mapped );
+            m_size = static_cast<size_t>( st.st_size );
+            if ( access == SEQUENTIAL_ACCESS ) ::madvise( mapped, m_size, MADV_SEQUENTIAL );
+        }
+
+        ~MappedFile()
+        {
+            if ( m_data ) ::munmap( const_cast<char*>( m_data ), m_size );
+        }
+
+        MappedFile( const MappedFile& ) = delete;
+        MappedFile& operator=( const MappedFile& ) = delete;
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        const char* m_data;
+        size_t      m_size;
+    };
+
+    // The lines of a mapped file, split as std::getline would, as views into the
+    // mapping. Nothing is copied or allocated per line. Copies of the wrapper
+    // share the mapping, which is released with the last of them: views must
+    // not outlive it (take str() of any that need to). Collecting operations
+    // (lower, sorts, groupBy, distinct and so on) copy the lines into strings.
+    class MmapLinesWrapper : public Conversions<MmapLinesWrapper, StringView, StringView>
+    {
+    public:
+        MmapLinesWrapper( std::shared_ptr<const MappedFile> file ) :
+            m_file(file), m_pos(file->data()), m_end(file->data() + file->size())
+        {
+        }
+
+        typedef MmapLinesWrapper Iterator;
+        Iterator& getIterator() { return *this; }
+
+        bool hasNext() { return m_pos != m_end; }
+
+        StringView next()
+        {
+            const char* eol = lineEnd();
+            StringView line( m_pos, eol - m_pos );
+            m_pos = eol == m_end ? m_end : eol + 1;
+            return line;
+        }
+
+        // Every line takes at least one byte
+        SizeHint sizeHint() { return SizeHint::upperBound( m_end - m_pos ); }
+
+        typedef std::true_type PushCapable;
+
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            while ( m_pos != m_end )
+            {
+                if ( !feed( sink, next() ) ) return false;
+            }
+            return true;
+        }
+
+    private:
+        const char* lineEnd() const
+        {
+            const void* eol = std::memchr( m_pos, '\n', m_end - m_pos );
+            return eol ? static_cast<const char*>( eol ) : m_end;
+        }
+
+        std::shared_ptr<const MappedFile>   m_file;
+        const char*                         m_pos;
+        const char*                         m_end;
+    };
+
+    // Lines of the file at path, without the stream and per-line string
+    // overhead of lift(std::istream&)
+    inline MmapLinesWrapper lift_mmap_lines( const std::string& path, MmapAccess access=SEQUENTIAL_ACCESS )
+    {
+        return MmapLinesWrapper( std::make_shared<const MappedFile>( path, access ) );
+    }
+
+}}
+
+#endif
+
+#endif
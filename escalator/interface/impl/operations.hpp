@@ -6,15 +6,15 @@
 namespace navetas { namespace escalator {
  
     template<typename Source, typename FunctorT, typename ElT>
-    class FilterWrapper : public Conversions<FilterWrapper<Source, FunctorT, ElT>, ElT, ElT>
+    class FilterWrapper : public Conversions<FilterWrapper<Source, FunctorT, ElT>, ElT, ElT>, private FunctorHolder<FunctorT>
     {
     public:
-        FilterWrapper( const typename Source::Iterator& source, FunctorT fn ) : m_source(source), m_fn(fn)
+        FilterWrapper( const typename Source::Iterator& source, FunctorT fn ) : FunctorHolder<FunctorT>(fn), m_source(source)
         {
             populateNext();
         }
 
-        FilterWrapper( typename Source::Iterator && source, FunctorT fn ) : m_source(std::move(source)), m_fn(fn)
+        FilterWrapper( typename Source::Iterator && source, FunctorT fn ) : FunctorHolder<FunctorT>(fn), m_source(std::move(source))
         {
             populateNext();
         }
@@ -29,7 +29,72 @@ namespace navetas { namespace escalator {
             return v;
         }
         
-        bool hasNext() { return m_next; }
+        bool hasNext() { return static_cast<bool>(m_next); }
+        
+        SizeHint sizeHint() { return sizeHintOf( m_source ).plus( m_next ? 1 : 0 ).asUpperBound(); }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            // Flush the element already buffered by the pull protocol
+            if ( m_next )
+            {
+                ElT v = m_next.get();
+                m_next.reset();
+                if ( !feed( sink, std::forward<ElT>(v) ) )
+                {
+                    populateNext();
+                    return false;
+                }
+            }
+            
+            FunctorT& fn = this->functor();
+            bool more = m_source.pushAll( [&fn, &sink]( source_el_t v ) -> bool
+            {
+                return !fn( v ) || feed( sink, std::forward<source_el_t>(v) );
+            } );
+            
+            // Restore the look-ahead that the pull protocol relies on
+            if ( !more ) populateNext();
+            return more;
+        }
+        
+        typedef std::integral_constant<bool,
+            IsBatchCapable<typename Source::Iterator>::value &&
+            std::is_same<typename IteratorElement<typename Source::Iterator>::type, ElT>::value> BatchCapable;
+        
+        typedef typename std::remove_reference<ElT>::type batch_el_t;
+        
+        const batch_el_t* nextBatch( batch_el_t* buffer, size_t maxCount, size_t& count )
+        {
+            count = 0;
+            if ( m_next && maxCount > 0 )
+            {
+                buffer[count++] = m_next.get();
+                m_next.reset();
+            }
+            
+            // Keep pulling until the batch is full or the source runs dry
+            batch_el_t inBuffer[BatchSize];
+            FunctorT& fn = this->functor();
+            while ( count < maxCount )
+            {
+                size_t requested = maxCount - count;
+                size_t inCount = 0;
+                const batch_el_t* in = m_source.nextBatch( inBuffer, requested, inCount );
+                for ( size_t i = 0; i < inCount; ++i )
+                {
+                    if ( fn( in[i] ) ) buffer[count++] = in[i];
+                }
+                
+                if ( inCount < requested ) break;
+            }
+            return buffer;
+        }
         
     private:
         void populateNext()
@@ -38,7 +103,7 @@ namespace navetas { namespace escalator {
             while ( m_source.hasNext() )
             {
                 ElT next = m_source.next();
-                if ( m_fn( next ) )
+                if ( this->functor()( next ) )
                 {
                     m_next = next;
                     break;
@@ -48,15 +113,14 @@ namespace navetas { namespace escalator {
     
     private:
         typename Source::Iterator   m_source;
-        FunctorT                    m_fn;
         boost::optional<ElT>        m_next;
     };
 
     template<typename Source, typename FunctorT, typename InnerT, typename InputT, typename ElT>
-    class FlatMapWrapper : public Conversions<FlatMapWrapper<Source, FunctorT, InnerT, InputT, ElT>, ElT, ElT>
+    class FlatMapWrapper : public Conversions<FlatMapWrapper<Source, FunctorT, InnerT, InputT, ElT>, ElT, ElT>, private FunctorHolder<FunctorT>
     {
     public:
-        FlatMapWrapper( const typename Source::Iterator& source, FunctorT fn ) : m_source(source), m_fn(fn), m_requirePopulateNext(true)
+        FlatMapWrapper( const typename Source::Iterator& source, FunctorT fn ) : FunctorHolder<FunctorT>(fn), m_source(source), m_requirePopulateNext(true)
         {
         }
         
@@ -66,7 +130,7 @@ namespace navetas { namespace escalator {
         ElT next()
         {
             if ( m_requirePopulateNext ) populateNext();
-            ElT res = m_fn( m_next.get() );
+            ElT res = this->functor()( m_next.get() );
             m_requirePopulateNext = true;
             return res;
         }
@@ -74,7 +138,58 @@ namespace navetas { namespace escalator {
         bool hasNext()
         {
             if ( m_requirePopulateNext ) populateNext();
-            return m_next;
+            return static_cast<bool>(m_next);
+        }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            FunctorT& fn = this->functor();
+            auto innerSink = [&fn, &sink]( InputT v ) -> bool { return feed( sink, fn( std::forward<InputT>(v) ) ); };
+            
+            // Flush anything part-consumed by the pull protocol first
+            if ( !m_requirePopulateNext && m_next )
+            {
+                InputT v = m_next.get();
+                m_next.reset();
+                m_requirePopulateNext = true;
+                if ( !innerSink( std::forward<InputT>(v) ) ) return false;
+            }
+            m_next.reset();
+            if ( m_innerIt && !drain( *m_innerIt, innerSink ) )
+            {
+                m_requirePopulateNext = true;
+                return false;
+            }
+            
+            // Where the sink can stop, the inner sequence being pushed is kept so
+            // that a stop part way through it leaves the rest to be pulled
+            const bool canStop = IsStoppingSink<typename std::remove_reference<SinkT>::type, ElT>::value;
+            boost::optional<InnerT>& inner = m_inner;
+            boost::optional<typename InnerT::Iterator>& innerIt = m_innerIt;
+            bool more = m_source.pushAll( [&innerSink, &inner, &innerIt, canStop]( InnerT next ) -> bool
+            {
+                if ( !canStop )
+                {
+                    auto nextIt = next.getIterator();
+                    return drain( nextIt, innerSink );
+                }
+                
+                inner = std::move(next);
+                innerIt = inner->getIterator();
+                return drain( *innerIt, innerSink );
+            } );
+            
+            if ( more )
+            {
+                m_innerIt.reset();
+                m_inner.reset();
+                m_requirePopulateNext = false;
+            }
+            else m_requirePopulateNext = true;
+            return more;
         }
         
     private:
@@ -98,10 +213,7 @@ namespace navetas { namespace escalator {
         }
     
     private:
-        typedef std::function<ElT(InputT)> FunctorHolder_t;
-        
         typename Source::Iterator                   m_source;
-        FunctorHolder_t                             m_fn;
         boost::optional<InnerT>                     m_inner;
         boost::optional<typename InnerT::Iterator>  m_innerIt;
         boost::optional<InputT>                     m_next;
@@ -109,6 +221,265 @@ namespace navetas { namespace escalator {
         bool                                        m_requirePopulateNext;
     };
 
+    // Lazily passes on the first element seen with each key, tracking keys
+    // already seen in SeenT
+    template<typename Source, typename KeyFunctorT, typename ElT, typename SeenT>
+    class DistinctWrapper : public Conversions<DistinctWrapper<Source, KeyFunctorT, ElT, SeenT>, ElT, ElT>, private FunctorHolder<KeyFunctorT>
+    {
+    public:
+        DistinctWrapper( const typename Source::Iterator& source, KeyFunctorT keyFn, const SeenT& seen ) :
+            FunctorHolder<KeyFunctorT>(keyFn), m_source(source), m_seen(seen)
+        {
+            populateNext();
+        }
+        
+        DistinctWrapper( typename Source::Iterator&& source, KeyFunctorT keyFn, const SeenT& seen ) :
+            FunctorHolder<KeyFunctorT>(keyFn), m_source(std::move(source)), m_seen(seen)
+        {
+            populateNext();
+        }
+        
+        typedef DistinctWrapper<Source, KeyFunctorT, ElT, SeenT> Iterator;
+        Iterator& getIterator() { return *this; }
+        
+        ElT next()
+        {
+            ElT v = m_next.get();
+            populateNext();
+            return v;
+        }
+        
+        bool hasNext() { return static_cast<bool>(m_next); }
+        
+        SizeHint sizeHint() { return sizeHintOf( m_source ).plus( m_next ? 1 : 0 ).asUpperBound(); }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            if ( m_next )
+            {
+                ElT v = m_next.get();
+                m_next.reset();
+                if ( !feed( sink, std::forward<ElT>(v) ) )
+                {
+                    populateNext();
+                    return false;
+                }
+            }
+            
+            KeyFunctorT& keyFn = this->functor();
+            SeenT& seen = m_seen;
+            bool more = m_source.pushAll( [&keyFn, &seen, &sink]( source_el_t v ) -> bool
+            {
+                return !seen.insert( keyFn( v ) ) || feed( sink, std::forward<source_el_t>(v) );
+            } );
+            
+            if ( !more ) populateNext();
+            return more;
+        }
+        
+    private:
+        void populateNext()
+        {
+            m_next.reset();
+            while ( m_source.hasNext() )
+            {
+                ElT next = m_source.next();
+                if ( m_seen.insert( this->functor()( next ) ) )
+                {
+                    m_next = next;
+                    break;
+                }
+            }
+        }
+        
+        typename Source::Iterator   m_source;
+        SeenT                       m_seen;
+        boost::optional<ElT>        m_next;
+    };
+    
+    // Passes on elements up to the first for which fn is false, and reads
+    // nothing from the source beyond that one
+    template<typename Source, typename FunctorT, typename ElT>
+    class TakeWhileWrapper : public Conversions<TakeWhileWrapper<Source, FunctorT, ElT>, ElT, ElT>, private FunctorHolder<FunctorT>
+    {
+    public:
+        TakeWhileWrapper( const typename Source::Iterator& source, FunctorT fn ) :
+            FunctorHolder<FunctorT>(fn), m_source(source), m_requirePopulateNext(true), m_done(false)
+        {
+        }
+        
+        TakeWhileWrapper( typename Source::Iterator&& source, FunctorT fn ) :
+            FunctorHolder<FunctorT>(fn), m_source(std::move(source)), m_requirePopulateNext(true), m_done(false)
+        {
+        }
+        
+        typedef TakeWhileWrapper<Source, FunctorT, ElT> Iterator;
+        Iterator& getIterator() { return *this; }
+        
+        ElT next()
+        {
+            if ( m_requirePopulateNext ) populateNext();
+            ElT v = m_next.get();
+            m_next.reset();
+            m_requirePopulateNext = true;
+            return v;
+        }
+        
+        bool hasNext()
+        {
+            if ( m_requirePopulateNext ) populateNext();
+            return static_cast<bool>(m_next);
+        }
+        
+        SizeHint sizeHint()
+        {
+            if ( m_done ) return SizeHint::exact( m_next ? 1 : 0 );
+            return sizeHintOf( m_source ).plus( m_next ? 1 : 0 ).asUpperBound();
+        }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            if ( !m_requirePopulateNext && m_next )
+            {
+                ElT v = m_next.get();
+                m_next.reset();
+                m_requirePopulateNext = true;
+                if ( !feed( sink, std::forward<ElT>(v) ) ) return false;
+            }
+            if ( m_done ) return true;
+            
+            // The first failing element stops the source, but not the sink
+            FunctorT& fn = this->functor();
+            bool& done = m_done;
+            bool more = true;
+            m_source.pushAll( [&fn, &done, &more, &sink]( source_el_t v ) -> bool
+            {
+                if ( !fn( v ) )
+                {
+                    done = true;
+                    return false;
+                }
+                more = feed( sink, std::forward<source_el_t>(v) );
+                return more;
+            } );
+            if ( more ) m_done = true;
+            return more;
+        }
+        
+    private:
+        void populateNext()
+        {
+            m_requirePopulateNext = false;
+            if ( m_done || !m_source.hasNext() ) return;
+            
+            ElT next = m_source.next();
+            if ( this->functor()( next ) ) m_next = next;
+            else m_done = true;
+        }
+        
+        typename Source::Iterator   m_source;
+        boost::optional<ElT>        m_next;
+        bool                        m_requirePopulateNext;
+        bool                        m_done;
+    };
+    
+    // Skips elements while fn holds, then passes on the rest unchanged. The
+    // skipping happens on first use, not on construction.
+    template<typename Source, typename FunctorT, typename ElT>
+    class DropWhileWrapper : public Conversions<DropWhileWrapper<Source, FunctorT, ElT>, ElT, ElT>, private FunctorHolder<FunctorT>
+    {
+    public:
+        DropWhileWrapper( const typename Source::Iterator& source, FunctorT fn ) :
+            FunctorHolder<FunctorT>(fn), m_source(source), m_dropping(true)
+        {
+        }
+        
+        DropWhileWrapper( typename Source::Iterator&& source, FunctorT fn ) :
+            FunctorHolder<FunctorT>(fn), m_source(std::move(source)), m_dropping(true)
+        {
+        }
+        
+        typedef DropWhileWrapper<Source, FunctorT, ElT> Iterator;
+        Iterator& getIterator() { return *this; }
+        
+        ElT next()
+        {
+            if ( m_dropping ) drop();
+            if ( m_next )
+            {
+                ElT v = m_next.get();
+                m_next.reset();
+                return v;
+            }
+            return m_source.next();
+        }
+        
+        bool hasNext()
+        {
+            if ( m_dropping ) drop();
+            return m_next || m_source.hasNext();
+        }
+        
+        SizeHint sizeHint()
+        {
+            SizeHint hint = sizeHintOf( m_source ).plus( m_next ? 1 : 0 );
+            return m_dropping ? hint.asUpperBound() : hint;
+        }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            if ( m_next )
+            {
+                ElT v = m_next.get();
+                m_next.reset();
+                if ( !feed( sink, std::forward<ElT>(v) ) ) return false;
+            }
+            
+            FunctorT& fn = this->functor();
+            bool& dropping = m_dropping;
+            return m_source.pushAll( [&fn, &dropping, &sink]( source_el_t v ) -> bool
+            {
+                if ( dropping && fn( v ) ) return true;
+                dropping = false;
+                return feed( sink, std::forward<source_el_t>(v) );
+            } );
+        }
+        
+    private:
+        void drop()
+        {
+            while ( m_source.hasNext() )
+            {
+                ElT next = m_source.next();
+                if ( !this->functor()( next ) )
+                {
+                    m_next = next;
+                    break;
+                }
+            }
+            m_dropping = false;
+        }
+        
+        typename Source::Iterator   m_source;
+        boost::optional<ElT>        m_next;
+        bool                        m_dropping;
+    };
+    
     template<typename Source, typename InputT>
     class CopyWrapper : public Conversions<CopyWrapper<Source, InputT>,
                                            typename std::remove_const<typename InputT::type>::type, typename std::remove_const<typename InputT::type>::type>
@@ -122,34 +493,77 @@ namespace navetas { namespace escalator {
         Iterator& getIterator() { return *this; }
         bool hasNext() { return m_source.hasNext(); }
         typename std::remove_const<typename InputT::type>::type next() { return m_source.next(); }
+        SizeHint sizeHint() { return sizeHintOf( m_source ); }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            typedef typename std::remove_const<typename InputT::type>::type value_t;
+            
+            return m_source.pushAll( [&sink]( source_el_t v ) -> bool { return feed( sink, static_cast<value_t>( v ) ); } );
+        }
+        
+        typedef typename IsAdvanceable<typename Source::Iterator>::type Advanceable;
+        size_t advance( size_t n ) { return m_source.advance( n ); }
     private:
         typename Source::Iterator m_source;
     };
 
     template<typename Source, typename FunctorT, typename InputT, typename ElT>
-    class MapWrapper : public Conversions<MapWrapper<Source, FunctorT, InputT, ElT>, ElT, ElT>
+    class MapWrapper : public Conversions<MapWrapper<Source, FunctorT, InputT, ElT>, ElT, ElT>, private FunctorHolder<FunctorT>
     {
     private:
         typedef MapWrapper<Source, FunctorT, InputT, ElT> self_t;
     public:
-        MapWrapper( const typename Source::Iterator& source, FunctorT fn ) : m_source(source), m_fn(fn)
+        MapWrapper( const typename Source::Iterator& source, FunctorT fn ) : FunctorHolder<FunctorT>(fn), m_source(source)
         {
         }
 
-        MapWrapper( typename Source::Iterator&& source, FunctorT fn ) : m_source(std::move(source)), m_fn(fn)
+        MapWrapper( typename Source::Iterator&& source, FunctorT fn ) : FunctorHolder<FunctorT>(fn), m_source(std::move(source))
         {
         }
 
         typedef MapWrapper<Source, FunctorT, InputT, ElT> Iterator;
         Iterator& getIterator() { return *this; }
         bool hasNext() { return m_source.hasNext(); }
-        ElT next() { return m_fn( m_source.next() ); }
+        ElT next() { return this->functor()( m_source.next() ); }
+        SizeHint sizeHint() { return sizeHintOf( m_source ); }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            FunctorT& fn = this->functor();
+            return m_source.pushAll( [&fn, &sink]( source_el_t v ) -> bool { return feed( sink, fn( std::forward<source_el_t>(v) ) ); } );
+        }
+        
+        // Skipped elements are never mapped
+        typedef typename IsAdvanceable<typename Source::Iterator>::type Advanceable;
+        size_t advance( size_t n ) { return m_source.advance( n ); }
+        
+        typedef typename IsBatchCapable<typename Source::Iterator>::type BatchCapable;
+        typedef typename std::remove_reference<ElT>::type batch_el_t;
+        
+        const batch_el_t* nextBatch( batch_el_t* buffer, size_t maxCount, size_t& count )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            source_el_t inBuffer[BatchSize];
+            const source_el_t* in = m_source.nextBatch( inBuffer, maxCount, count );
+            
+            FunctorT& fn = this->functor();
+            for ( size_t i = 0; i < count; ++i ) buffer[i] = fn( in[i] );
+            return buffer;
+        }
     
     private:
-        typedef std::function<ElT(InputT)> FunctorHolder_t;
-    
         typename Source::Iterator   m_source;
-        FunctorHolder_t             m_fn;
     };
     
     template<typename Source1T, typename El1T, typename Source2T, typename El2T>
@@ -172,6 +586,33 @@ namespace navetas { namespace escalator {
         Iterator& getIterator() { return *this; }
         bool hasNext() { return m_source1.hasNext() && m_source2.hasNext(); }
         std::pair<El1T, El2T> next() { return std::make_pair( m_source1.next(), m_source2.next() ); }
+        SizeHint sizeHint() { return SizeHint::min( sizeHintOf( m_source1 ), sizeHintOf( m_source2 ) ); }
+        
+        typedef std::integral_constant<bool,
+            IsAdvanceable<typename Source1T::Iterator>::value &&
+            IsAdvanceable<typename Source2T::Iterator>::value> Advanceable;
+        
+        size_t advance( size_t n ) { return std::min( m_source1.advance( n ), m_source2.advance( n ) ); }
+        
+        typedef std::integral_constant<bool,
+            IsBatchCapable<typename Source1T::Iterator>::value &&
+            IsBatchCapable<typename Source2T::Iterator>::value> BatchCapable;
+        
+        const std::pair<El1T, El2T>* nextBatch( std::pair<El1T, El2T>* buffer, size_t maxCount, size_t& count )
+        {
+            typedef typename IteratorElement<typename Source1T::Iterator>::type source1_el_t;
+            typedef typename IteratorElement<typename Source2T::Iterator>::type source2_el_t;
+            
+            source1_el_t inBuffer1[BatchSize];
+            source2_el_t inBuffer2[BatchSize];
+            size_t count1 = 0, count2 = 0;
+            const source1_el_t* in1 = m_source1.nextBatch( inBuffer1, maxCount, count1 );
+            const source2_el_t* in2 = m_source2.nextBatch( inBuffer2, maxCount, count2 );
+            
+            count = std::min( count1, count2 );
+            for ( size_t i = 0; i < count; ++i ) buffer[i] = std::pair<El1T, El2T>( in1[i], in2[i] );
+            return buffer;
+        }
         
     private:
         typename Source1T::Iterator m_source1;
@@ -179,27 +620,54 @@ namespace navetas { namespace escalator {
     };
     
     template<typename Source, typename FunctorT, typename InputT, typename ElT, typename StateT>
-    class MapWithStateWrapper : public Conversions<MapWithStateWrapper<Source, FunctorT, InputT, ElT, StateT>, ElT, ElT>
+    class MapWithStateWrapper : public Conversions<MapWithStateWrapper<Source, FunctorT, InputT, ElT, StateT>, ElT, ElT>, private FunctorHolder<FunctorT>
     {
     public:
         typedef MapWithStateWrapper<Source, FunctorT, InputT, ElT, StateT> self_t;
         
-        MapWithStateWrapper( const typename Source::Iterator& source, FunctorT fn, StateT state ) : m_source(source), m_fn(fn), m_state(state)
+        MapWithStateWrapper( const typename Source::Iterator& source, FunctorT fn, StateT state ) : FunctorHolder<FunctorT>(fn), m_source(source), m_state(state)
         {
         }
 
-        MapWithStateWrapper( typename Source::Iterator&& source, FunctorT fn, StateT state ) : m_source(std::move(source)), m_fn(fn), m_state(state)
+        MapWithStateWrapper( typename Source::Iterator&& source, FunctorT fn, StateT state ) : FunctorHolder<FunctorT>(fn), m_source(std::move(source)), m_state(state)
         {
         }
         
         typedef MapWithStateWrapper<Source, FunctorT, InputT, ElT, StateT> Iterator;
         Iterator& getIterator() { return *this; }
         bool hasNext() { return m_source.hasNext(); }
-        ElT next() { return m_fn( m_source.next(), m_state ); }
+        ElT next() { return this->functor()( m_source.next(), m_state ); }
+        SizeHint sizeHint() { return sizeHintOf( m_source ); }
+        
+        typedef typename IsPushCapable<typename Source::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            FunctorT& fn = this->functor();
+            StateT& state = m_state;
+            return m_source.pushAll( [&fn, &state, &sink]( source_el_t v ) -> bool { return feed( sink, fn( std::forward<source_el_t>(v), state ) ); } );
+        }
+        
+        typedef typename IsBatchCapable<typename Source::Iterator>::type BatchCapable;
+        typedef typename std::remove_reference<ElT>::type batch_el_t;
+        
+        const batch_el_t* nextBatch( batch_el_t* buffer, size_t maxCount, size_t& count )
+        {
+            typedef typename IteratorElement<typename Source::Iterator>::type source_el_t;
+            
+            source_el_t inBuffer[BatchSize];
+            const source_el_t* in = m_source.nextBatch( inBuffer, maxCount, count );
+            
+            FunctorT& fn = this->functor();
+            for ( size_t i = 0; i < count; ++i ) buffer[i] = fn( in[i], m_state );
+            return buffer;
+        }
     
     private:
         typename Source::Iterator   m_source;
-        FunctorT                    m_fn;
         StateT                      m_state;
     };
     
@@ -215,7 +683,7 @@ namespace navetas { namespace escalator {
     class TransformedValue
     {
     public:
-        typedef typename IterT::reference IteratorDereferenceType;
+        typedef typename std::iterator_traits<IterT>::reference IteratorDereferenceType;
         typedef decltype( std::declval<FunctorT<IteratorDereferenceType>>()( std::declval<IteratorDereferenceType>() ) ) type;
     };
    
@@ -227,7 +695,7 @@ namespace navetas { namespace escalator {
     public:
         typedef IteratorWrapper<IterT, FunctorT> self_t;
         
-        typedef FunctorT<typename IterT::reference> transformer_t;
+        typedef FunctorT<typename std::iterator_traits<IterT>::reference> transformer_t;
         typedef typename transformer_t::type el_t;
         
         IteratorWrapper( IterT start, IterT end ) : m_iter(start), m_end(end)
@@ -250,8 +718,78 @@ namespace navetas { namespace escalator {
 
             return transformer( *curr );
         }
+        
+        SizeHint sizeHint() { return sizeHint( typename std::iterator_traits<IterT>::iterator_category() ); }
+        
+        typedef typename std::is_base_of<std::random_access_iterator_tag,
+            typename std::iterator_traits<IterT>::iterator_category>::type Advanceable;
+        
+        size_t advance( size_t n )
+        {
+            size_t skipped = std::min<size_t>( n, m_end - m_iter );
+            m_iter += skipped;
+            return skipped;
+        }
+        
+        // Run subsequent map/filter and terminal operations on the
+        // TaskScheduler, using at most the given number of threads at once
+        // (0 for one per core)
+        ParallelWrapper<IterT, FunctorT, ParallelIdentityStage> par( size_t threads=0 )
+        {
+            static_assert( Advanceable::value, "Parallel execution requires a random-access source" );
+            return ParallelWrapper<IterT, FunctorT, ParallelIdentityStage>( m_iter, m_end, threads );
+        }
+        
+        typedef std::true_type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            transformer_t transformer;
+            
+            for ( ; m_iter != m_end; ++m_iter )
+            {
+                if ( !feed( sink, transformer( *m_iter ) ) )
+                {
+                    ++m_iter;
+                    return false;
+                }
+            }
+            return true;
+        }
+        
+        // Batches over contiguous storage are handed out in place
+        typedef std::integral_constant<bool,
+            IsContiguousIterator<IterT>::value &&
+            std::is_same<el_t, typename std::iterator_traits<IterT>::value_type>::value> BatchCapable;
+        
+        typedef typename std::remove_reference<el_t>::type batch_el_t;
+        
+        const batch_el_t* nextBatch( batch_el_t* buffer, size_t maxCount, size_t& count )
+        {
+            count = std::min<size_t>( maxCount, m_end - m_iter );
+            if ( count == 0 ) return buffer;
+            
+            const batch_el_t* batch = &*m_iter;
+            m_iter += count;
+            return batch;
+        }
+        
+        // ...and may be handed out whole, e.g. to vectorised reductions
+        typedef BatchCapable Contiguous;
+        
+        const batch_el_t* takeContiguous( size_t& count )
+        {
+            count = m_end - m_iter;
+            const batch_el_t* all = count == 0 ? nullptr : &*m_iter;
+            m_iter = m_end;
+            return all;
+        }
 
     private:
+        SizeHint sizeHint( std::random_access_iterator_tag ) { return SizeHint::exact( m_end - m_iter ); }
+        SizeHint sizeHint( std::input_iterator_tag ) { return SizeHint::unknown(); }
+        
         IterT m_iter;
         IterT m_end;
     };
@@ -302,14 +840,76 @@ namespace navetas { namespace escalator {
             return m_source.next();
         }
         
-    private:
-        void initiate( size_t from, size_t to, SliceBehavior behavior )
+        SizeHint sizeHint()
+        {
+            return m_count < m_to ? sizeHintOf( m_source ).atMost( m_to - m_count ) : SizeHint::exact( 0 );
+        }
+        
+        typedef typename IsAdvanceable<typename SourceT::Iterator>::type Advanceable;
+        
+        size_t advance( size_t n )
+        {
+            size_t requested = m_count < m_to ? std::min( n, m_to - m_count ) : 0;
+            size_t skipped = m_source.advance( requested );
+            m_count += skipped;
+            
+            if ( m_behavior == ASSERT_WHEN_INSUFFICIENT && skipped < requested )
+            {
+                throw SliceError( "Iterator unexpectedly exhausted" );
+            }
+            return skipped;
+        }
+        
+        // Stops the source once the end of the slice is reached
+        typedef typename IsPushCapable<typename SourceT::Iterator>::type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            typedef typename IteratorElement<typename SourceT::Iterator>::type source_el_t;
+            
+            if ( m_count >= m_to ) return true;
+            
+            size_t& count = m_count;
+            size_t to = m_to;
+            bool more = true;
+            m_source.pushAll( [&count, to, &more, &sink]( source_el_t v ) -> bool
+            {
+                count++;
+                more = feed( sink, std::forward<source_el_t>(v) );
+                return more && count < to;
+            } );
+            
+            if ( more && m_behavior == ASSERT_WHEN_INSUFFICIENT && m_count < m_to )
+            {
+                throw SliceError( "Iterator unexpectedly exhausted" );
+            }
+            return more;
+        }
+        
+        typedef std::integral_constant<bool,
+            IsBatchCapable<typename SourceT::Iterator>::value &&
+            std::is_same<typename IteratorElement<typename SourceT::Iterator>::type, ElT>::value> BatchCapable;
+        
+        typedef typename std::remove_reference<ElT>::type batch_el_t;
+        
+        const batch_el_t* nextBatch( batch_el_t* buffer, size_t maxCount, size_t& count )
         {
-            while ( m_source.hasNext() && m_count < m_from )
+            size_t requested = std::min( maxCount, m_to - m_count );
+            const batch_el_t* batch = m_source.nextBatch( buffer, requested, count );
+            m_count += count;
+            
+            if ( m_behavior == ASSERT_WHEN_INSUFFICIENT && count < requested )
             {
-                m_source.next();
-                m_count++;
+                throw SliceError( "Iterator unexpectedly exhausted" );
             }
+            return batch;
+        }
+        
+    private:
+        void initiate( size_t from, size_t to, SliceBehavior behavior )
+        {
+            m_count += skip( m_source, m_from );
 
             if(m_behavior == ASSERT_WHEN_INSUFFICIENT && m_count < m_from)
             {
@@ -372,6 +972,12 @@ namespace navetas { namespace escalator {
         
         Iterator getIterator() { return Iterator( m_data.begin(), m_data.end() ); }
         
+        // As IteratorWrapper::par
+        ParallelWrapper<typename Container::iterator, IteratorTransformFunctorT, ParallelIdentityStage> par( size_t threads=0 )
+        {
+            return getIterator().par( threads );
+        }
+        
         operator const Container&() { return m_data; }
         const Container& get() const { return m_data; }
         Container& get() { return m_data; }
@@ -394,6 +1000,33 @@ namespace navetas { namespace escalator {
             return m_count++;
         }
         
+        // Unbounded, so only useful to sinks that stop
+        typedef std::true_type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            while ( feed( sink, m_count++ ) );
+            return false;
+        }
+        
+        typedef std::true_type BatchCapable;
+        
+        const int* nextBatch( int* buffer, size_t maxCount, size_t& count )
+        {
+            for ( size_t i = 0; i < maxCount; ++i ) buffer[i] = m_count++;
+            count = maxCount;
+            return buffer;
+        }
+        
+        typedef std::true_type Advanceable;
+        
+        size_t advance( size_t n )
+        {
+            m_count += static_cast<int>( n );
+            return n;
+        }
+        
     private:
         int m_count;
     };
@@ -415,6 +1048,18 @@ namespace navetas { namespace escalator {
         bool hasNext() { return m_hasNextFn(); }
         decltype( std::declval<GetNextFnT>()() ) next() { return m_getNextFn(); }
         
+        typedef std::true_type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            while ( m_hasNextFn() )
+            {
+                if ( !feed( sink, m_getNextFn() ) ) return false;
+            }
+            return true;
+        }
+        
     private:
         HasNextFnT      m_hasNextFn;
         GetNextFnT      m_getNextFn;
@@ -438,10 +1083,25 @@ namespace navetas { namespace escalator {
             return curr;
         }
         
+        typedef std::true_type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            // getline overwrites the line anyway, so hand it over rather than copying
+            while ( m_hasNext )
+            {
+                bool more = feed( sink, std::move(m_currLine) );
+                populateNext();
+                if ( !more ) return false;
+            }
+            return true;
+        }
+        
     private:
         void populateNext()
         {
-            m_hasNext = std::getline( m_stream, m_currLine );
+            m_hasNext = static_cast<bool>( std::getline( m_stream, m_currLine ) );
         }
         
     private:
@@ -450,6 +1110,60 @@ namespace navetas { namespace escalator {
         std::string         m_currLine;
     };
     
+    // The fields of a string separated by any of a set of characters, as views
+    // found lazily. As boost::algorithm::split, adjacent separators delimit
+    // empty fields and n separators always make n + 1 fields.
+    class SplitWrapper : public Conversions<SplitWrapper, StringView, StringView>
+    {
+    public:
+        SplitWrapper( StringView data, StringView splitChars ) :
+            m_pos(data.begin()), m_end(data.end()), m_done(false),
+            m_splitChars(splitChars.data(), splitChars.size())
+        {
+        }
+        
+        typedef SplitWrapper Iterator;
+        Iterator& getIterator() { return *this; }
+        
+        bool hasNext() { return !m_done; }
+        
+        StringView next()
+        {
+            const char* split = findSplit();
+            StringView field( m_pos, split - m_pos );
+            if ( split == m_end ) m_done = true;
+            else m_pos = split + 1;
+            return field;
+        }
+        
+        SizeHint sizeHint() { return m_done ? SizeHint::exact( 0 ) : SizeHint::upperBound( m_end - m_pos + 1 ); }
+        
+        typedef std::true_type PushCapable;
+        
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            while ( !m_done )
+            {
+                if ( !feed( sink, next() ) ) return false;
+            }
+            return true;
+        }
+        
+    private:
+        const char* findSplit() const
+        {
+            return StringKernels::findAny( m_pos, m_end, m_splitChars );
+        }
+        
+        const char* m_pos;
+        const char* m_end;
+        bool        m_done;
+        CharSet     m_splitChars;
+    };
+    
+    // Owns its string, for lift() of temporaries. trim() and split() copy, as
+    // views into a temporary wrapper would dangle.
     class StringWrapper : public ContainerWrapper<std::string, char>
     {
     public:
@@ -457,16 +1171,23 @@ namespace navetas { namespace escalator {
         {
         }
         
+        StringWrapper( std::string&& data ) : ContainerWrapper(std::move(data))
+        {
+        }
+        
         StringWrapper trim()
         {
-            return StringWrapper( boost::algorithm::trim_copy(m_data) );
+            const char* begin = StringKernels::skipSpace( m_data.data(), m_data.data() + m_data.size() );
+            const char* end = StringKernels::skipSpaceBack( begin, m_data.data() + m_data.size() );
+            return StringWrapper( std::string( begin, end ) );
         }
         
         ContainerWrapper<std::vector<std::string>, std::string> split( const std::string& splitChars )
         {
             std::vector<std::string> splitVec;
             
-            boost::algorithm::split( splitVec, m_data, boost::algorithm::is_any_of(splitChars) );
+            SplitWrapper fields( m_data, splitChars );
+            while ( fields.hasNext() ) splitVec.push_back( fields.next().str() );
             
             return ContainerWrapper<std::vector<std::string>, std::string>( std::move(splitVec) );
         }
@@ -474,6 +1195,38 @@ namespace navetas { namespace escalator {
         const std::string& toString() { return m_data; }
     };
     
+    // A string by reference, as lift() of any other container. trim() and
+    // split() return views into it, so extracting fields allocates nothing.
+    // The string must outlive the wrapper and whatever it produces.
+    class StringViewWrapper : public Conversions<StringViewWrapper, char, char>
+    {
+    public:
+        StringViewWrapper( StringView data ) : m_data(data)
+        {
+        }
+        
+        typedef IteratorWrapper<const char*, CopyStripConstFunctor> Iterator;
+        Iterator getIterator() { return Iterator( m_data.begin(), m_data.end() ); }
+        
+        StringViewWrapper trim() const
+        {
+            const char* begin = StringKernels::skipSpace( m_data.begin(), m_data.end() );
+            const char* end = StringKernels::skipSpaceBack( begin, m_data.end() );
+            return StringViewWrapper( StringView( begin, end - begin ) );
+        }
+        
+        SplitWrapper split( StringView splitChars ) const
+        {
+            return SplitWrapper( m_data, splitChars );
+        }
+        
+        StringView view() const { return m_data; }
+        std::string toString() const { return m_data.str(); }
+        
+    private:
+        StringView m_data;
+    };
+    
     template<typename ElT>
     class OptionalWrapper : public Conversions<OptionalWrapper<ElT>, ElT, ElT>
     {
@@ -490,6 +1243,7 @@ namespace navetas { namespace escalator {
             }
             
             bool hasNext() { return static_cast<bool>(m_val); }
+            SizeHint sizeHint() { return SizeHint::exact( m_val ? 1 : 0 ); }
             
             ElT next()
             {
@@ -497,6 +1251,14 @@ namespace navetas { namespace escalator {
                 m_val.reset();
                 return val;
             }
+            
+            typedef std::true_type PushCapable;
+            
+            template<typename SinkT>
+            bool pushAll( SinkT&& sink )
+            {
+                return !hasNext() || feed( sink, next() );
+            }
         private:
             boost::optional<ElT> m_val;
         };
@@ -526,7 +1288,10 @@ namespace navetas { namespace escalator {
     
     inline Counter counter() { return Counter(); }
     inline IStreamWrapper lift( std::istream& data ) { return IStreamWrapper(data); }
-    inline StringWrapper lift( const std::string& data ) { return StringWrapper(data); }
+    inline StringViewWrapper lift( const std::string& data ) { return StringViewWrapper(data); }
+    inline StringViewWrapper lift( const char* data ) { return StringViewWrapper(data); }
+    inline StringViewWrapper lift( StringView data ) { return StringViewWrapper(data); }
+    inline StringWrapper lift( std::string&& data ) { return StringWrapper(std::move(data)); }
     
     template<typename ContainerT>
     ContainerWrapper<ContainerT, typename ContainerT::value_type>
@@ -0,0 +1,372 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Stages turn a chunk of the source into the lazy pipeline run over it.
+    // Each chunk gets its own copy of every functor.
+    struct ParallelIdentityStage
+    {
+        template<typename SourceT>
+        SourceT operator()( SourceT source ) const { return source; }
+    };
+
+    template<typename PrevStageT, typename FunctorT>
+    class ParallelMapStage
+    {
+    public:
+        ParallelMapStage( const PrevStageT& prev, FunctorT fn ) : m_prev(prev), m_fn(fn) {}
+
+        template<typename SourceT>
+        auto operator()( SourceT source ) const -> decltype( std::declval<const PrevStageT&>()( source ).map( std::declval<FunctorT>() ) )
+        {
+            return m_prev( std::move(source) ).map( m_fn );
+        }
+
+    private:
+        PrevStageT  m_prev;
+        FunctorT    m_fn;
+    };
+
+    template<typename PrevStageT, typename FunctorT>
+    class ParallelFlatMapStage
+    {
+    public:
+        ParallelFlatMapStage( const PrevStageT& prev, FunctorT fn ) : m_prev(prev), m_fn(fn) {}
+
+        template<typename SourceT>
+        auto operator()( SourceT source ) const -> decltype( std::declval<const PrevStageT&>()( source ).flatMap( std::declval<FunctorT>() ) )
+        {
+            return m_prev( std::move(source) ).flatMap( m_fn );
+        }
+
+    private:
+        PrevStageT  m_prev;
+        FunctorT    m_fn;
+    };
+
+    template<typename PrevStageT, typename FunctorT>
+    class ParallelFilterStage
+    {
+    public:
+        ParallelFilterStage( const PrevStageT& prev, FunctorT fn ) : m_prev(prev), m_fn(fn) {}
+
+        template<typename SourceT>
+        auto operator()( SourceT source ) const -> decltype( std::declval<const PrevStageT&>()( source ).filter( std::declval<FunctorT>() ) )
+        {
+            return m_prev( std::move(source) ).filter( m_fn );
+        }
+
+    private:
+        PrevStageT  m_prev;
+        FunctorT    m_fn;
+    };
+
+    // Parallel view of a random-access range. map, filter and flatMap are lazy
+    // as usual; terminal operations split the range into contiguous chunks, run
+    // the pipeline over each as a task on the TaskScheduler and combine the
+    // results in element order. At most threads chunks run at once, however
+    // many workers the scheduler has. There are several chunks per thread, each
+    // taken by whichever thread is next free, so threads that finish early (e.g.
+    // where a filter is more selective) take on more of the rest.
+    template<typename IterT, template<typename> class FunctorT, typename StageT>
+    class ParallelWrapper
+    {
+    public:
+        typedef IteratorWrapper<IterT, FunctorT> source_t;
+        typedef decltype( std::declval<const StageT&>()( std::declval<source_t>() ) ) pipeline_t;
+        typedef typename pipeline_t::el_t el_t;
+        typedef typename std::remove_const<typename std::remove_reference<el_t>::type>::type mutable_value_type;
+        typedef typename RetainedElement<mutable_value_type>::type retained_value_type;
+
+        ParallelWrapper( IterT begin, IterT end, size_t threads, const StageT& stage=StageT() ) :
+            m_begin(begin), m_end(end), m_threads(threads == 0 ? TaskScheduler::global().workerCount() + 1 : threads), m_stage(stage)
+        {
+        }
+
+        size_t threads() const { return m_threads; }
+
+        template<typename MapFnT>
+        ParallelWrapper<IterT, FunctorT, ParallelMapStage<StageT, MapFnT>> map( MapFnT fn )
+        {
+            return ParallelWrapper<IterT, FunctorT, ParallelMapStage<StageT, MapFnT>>( m_begin, m_end, m_threads,
+                ParallelMapStage<StageT, MapFnT>( m_stage, fn ) );
+        }
+
+        template<typename FlatMapFnT>
+        ParallelWrapper<IterT, FunctorT, ParallelFlatMapStage<StageT, FlatMapFnT>> flatMap( FlatMapFnT fn )
+        {
+            return ParallelWrapper<IterT, FunctorT, ParallelFlatMapStage<StageT, FlatMapFnT>>( m_begin, m_end, m_threads,
+                ParallelFlatMapStage<StageT, FlatMapFnT>( m_stage, fn ) );
+        }
+
+        template<typename FilterFnT>
+        ParallelWrapper<IterT, FunctorT, ParallelFilterStage<StageT, FilterFnT>> filter( FilterFnT fn )
+        {
+            return ParallelWrapper<IterT, FunctorT, ParallelFilterStage<StageT, FilterFnT>>( m_begin, m_end, m_threads,
+                ParallelFilterStage<StageT, FilterFnT>( m_stage, fn ) );
+        }
+
+        // fn is called concurrently from several threads
+        template<typename ForeachFnT>
+        void foreach( ForeachFnT fn )
+        {
+            runChunks<bool>( [&fn]( pipeline_t& p, size_t ) { p.foreach( fn ); return true; } );
+        }
+
+        // Each chunk is folded from init, so it must be an identity for combine
+        template<typename AccT, typename FoldFnT, typename CombineFnT>
+        AccT fold( AccT init, FoldFnT fn, CombineFnT combine )
+        {
+            std::vector<AccT> partials = runChunks<AccT>( [&init, &fn]( pipeline_t& p, size_t ) { return p.fold( init, fn ); } );
+
+            AccT acc = std::move(partials[0]);
+            for ( size_t i = 1; i < partials.size(); ++i ) acc = combine( std::move(acc), std::move(partials[i]) );
+            return acc;
+        }
+
+        size_t count()
+        {
+            std::vector<size_t> partials = runChunks<size_t>( []( pipeline_t& p, size_t ) { return p.count(); } );
+
+            size_t total = 0;
+            for ( size_t c : partials ) total += c;
+            return total;
+        }
+
+        mutable_value_type sum()
+        {
+            typedef boost::optional<mutable_value_type> partial_t;
+            std::vector<partial_t> partials = runChunks<partial_t>( []( pipeline_t& p, size_t ) -> partial_t
+            {
+                if ( !p.getIterator().hasNext() ) return emptyOptional<mutable_value_type>();
+                return p.sum();
+            } );
+
+            partial_t acc = emptyOptional<mutable_value_type>();
+            for ( auto& partial : partials )
+            {
+                if ( !partial ) continue;
+                if ( acc ) *acc += *partial;
+                else acc = partial;
+            }
+            ESCALATOR_ASSERT( static_cast<bool>(acc), "Sum over insufficient items" );
+            return *acc;
+        }
+
+        std::pair<size_t, retained_value_type> argMin() { return argExtremum( std::less<mutable_value_type>() ); }
+        std::pair<size_t, retained_value_type> argMax() { return argExtremum( std::greater<mutable_value_type>() ); }
+
+        retained_value_type min() { return std::template get<1>(argMin()); }
+        retained_value_type max() { return std::template get<1>(argMax()); }
+
+        // Chunks stop early once any has found a match
+        template<typename PredFnT>
+        bool exists( PredFnT fn )
+        {
+            std::atomic<bool> found( false );
+            runChunks<bool>( [&fn, &found]( pipeline_t& p, size_t )
+            {
+                auto& it = p.getIterator();
+                typedef typename IteratorElement<typename std::remove_reference<decltype(it)>::type>::type it_el_t;
+                
+                drain( it, [&fn, &found]( it_el_t v ) -> bool
+                {
+                    if ( found.load( std::memory_order_relaxed ) ) return false;
+                    if ( !fn( std::forward<it_el_t>(v) ) ) return true;
+                    found = true;
+                    return false;
+                } );
+                return true;
+            } );
+            return found;
+        }
+        
+        bool contains( const mutable_value_type& value )
+        {
+            return exists( [&value]( const mutable_value_type& v ) { return v == value; } );
+        }
+        
+        // The first match in element order. Chunks stop early once an earlier
+        // chunk has found a match.
+        template<typename PredFnT>
+        boost::optional<retained_value_type> find( PredFnT fn )
+        {
+            typedef boost::optional<retained_value_type> partial_t;
+            
+            std::atomic<size_t> firstFound( std::numeric_limits<size_t>::max() );
+            std::vector<partial_t> partials = runChunks<partial_t>( [&fn, &firstFound]( pipeline_t& p, size_t chunk )
+            {
+                auto& it = p.getIterator();
+                typedef typename IteratorElement<typename std::remove_reference<decltype(it)>::type>::type it_el_t;
+                
+                partial_t found = emptyOptional<retained_value_type>();
+                drain( it, [&fn, &firstFound, &found, chunk]( it_el_t v ) -> bool
+                {
+                    if ( firstFound.load( std::memory_order_relaxed ) < chunk ) return false;
+                    if ( !fn( v ) ) return true;
+                    found = retained_value_type( std::forward<it_el_t>(v) );
+                    return false;
+                } );
+                
+                if ( found )
+                {
+                    size_t prev = firstFound.load();
+                    while ( chunk < prev && !firstFound.compare_exchange_weak( prev, chunk ) );
+                }
+                return found;
+            } );
+            
+            for ( auto& partial : partials )
+            {
+                if ( partial ) return partial;
+            }
+            return emptyOptional<retained_value_type>();
+        }
+
+        template<typename PredFnT>
+        bool forall( PredFnT fn )
+        {
+            return !exists( [&fn]( el_t v ) { return !fn( std::forward<el_t>(v) ); } );
+        }
+
+        // Every aggregator must support merge
+        template<typename... AggTs>
+        typename Aggregation<retained_value_type, AggTs...>::result_type aggregate( const AggTs&... aggs )
+        {
+            typedef Aggregation<retained_value_type, AggTs...> partial_t;
+            std::vector<partial_t> partials = runChunks<partial_t>( [&aggs...]( pipeline_t& p, size_t )
+            {
+                partial_t aggregation( aggs... );
+                p.foreach( [&aggregation]( const mutable_value_type& v ) { aggregation.insert( retainElement( v ) ); } );
+                return aggregation;
+            } );
+
+            partial_t aggregation = partials[0];
+            for ( size_t i = 1; i < partials.size(); ++i ) aggregation.merge( partials[i] );
+            return aggregation.result();
+        }
+
+        Stats<mutable_value_type> stats()
+        {
+            std::vector<Stats<mutable_value_type>> partials = runChunks<Stats<mutable_value_type>>( []( pipeline_t& p, size_t ) { return p.stats(); } );
+
+            Stats<mutable_value_type> stats;
+            for ( auto& partial : partials ) stats.merge( partial );
+            return stats;
+        }
+
+        // One sketch per chunk, merged. Each is seeded from its chunk index, so
+        // that chunks do not all discard the same positions when they compact.
+        QuantileSketch<mutable_value_type> quantileSketch( double rankError=0.01 )
+        {
+            typedef QuantileSketch<mutable_value_type> partial_t;
+            std::vector<partial_t> partials = runChunks<partial_t>( [rankError]( pipeline_t& p, size_t chunk )
+            {
+                partial_t sketch( rankError, std::less<mutable_value_type>(), chunk + 1 );
+                p.foreach( [&sketch]( const mutable_value_type& v ) { sketch.insert( v ); } );
+                return sketch;
+            } );
+
+            partial_t sketch( rankError );
+            for ( auto& partial : partials ) sketch.merge( partial );
+            return sketch;
+        }
+
+        std::vector<mutable_value_type> approxQuantiles( const std::vector<double>& ps, double rankError=0.01 )
+        {
+            return quantileSketch( rankError ).quantiles( ps );
+        }
+
+        template<template<typename, typename ...> class Container>
+        typename ConversionHelper<retained_value_type, Container>::ContainerType lower()
+        {
+            typedef std::vector<retained_value_type> partial_t;
+            std::vector<partial_t> partials = runChunks<partial_t>( []( pipeline_t& p, size_t ) { return p.template lower<std::vector>(); } );
+
+            size_t total = 0;
+            for ( auto& partial : partials ) total += partial.size();
+
+            typename ConversionHelper<retained_value_type, Container>::ContainerType t;
+            reserveFromHint( t, SizeHint::exact( total ) );
+            for ( auto& partial : partials )
+            {
+                for ( auto& v : partial ) t.insert( t.end(), std::move(v) );
+            }
+            return t;
+        }
+
+    private:
+        // Returns fn( pipeline, chunk index ) for each chunk, in order
+        template<typename ResultT, typename ChunkFnT>
+        std::vector<ResultT> runChunks( ChunkFnT fn )
+        {
+            const size_t ChunksPerThread = 8;
+
+            size_t size = m_end - m_begin;
+            size_t chunks = std::max<size_t>( 1, std::min( m_threads * ChunksPerThread, size ) );
+
+            std::vector<boost::optional<ResultT>> results( chunks );
+            auto runChunk = [this, &fn, &results, size, chunks]( size_t i )
+            {
+                pipeline_t pipeline = m_stage( source_t( m_begin + size * i / chunks, m_begin + size * (i + 1) / chunks ) );
+                results[i] = fn( pipeline, i );
+            };
+            parallelForAtMost( chunks, m_threads, runChunk );
+
+            std::vector<ResultT> unwrapped;
+            unwrapped.reserve( chunks );
+            for ( auto& r : results ) unwrapped.push_back( std::move(*r) );
+            return unwrapped;
+        }
+
+        // As the sequential versions: the first extremal element wins, and an
+        // empty sequence gives ( 0, retained_value_type() )
+        template<typename CompareT>
+        std::pair<size_t, retained_value_type> argExtremum( CompareT cmp )
+        {
+            typedef boost::optional<std::pair<size_t, retained_value_type>> best_t;
+            typedef std::pair<size_t, best_t> partial_t;
+
+            std::vector<partial_t> partials = runChunks<partial_t>( [&cmp]( pipeline_t& p, size_t )
+            {
+                auto& it = p.getIterator();
+                typedef typename IteratorElement<typename std::remove_reference<decltype(it)>::type>::type it_el_t;
+
+                size_t i = 0;
+                best_t best;
+                drain( it, [&i, &best, &cmp]( it_el_t v )
+                {
+                    if ( !best || cmp( v, best->second ) ) best = std::make_pair( i, retained_value_type( std::forward<it_el_t>(v) ) );
+                    ++i;
+                } );
+                return partial_t( i, best );
+            } );
+
+            size_t offset = 0;
+            bool found = false;
+            std::pair<size_t, retained_value_type> best( 0, retained_value_type() );
+            for ( auto& partial : partials )
+            {
+                const best_t& chunkBest = partial.second;
+                if ( chunkBest && ( !found || cmp( chunkBest->second, best.second ) ) )
+                {
+                    best = std::make_pair( offset + chunkBest->first, chunkBest->second );
+                    found = true;
+                }
+                offset += partial.first;
+            }
+            return best;
+        }
+
+        IterT       m_begin;
+        IterT       m_end;
+        size_t      m_threads;
+        StageT      m_stage;
+    };
+
+}}
+
+#endif
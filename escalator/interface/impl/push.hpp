@@ -0,0 +1,215 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // As well as the pull protocol (hasNext()/next()), an Iterator may support
+    // internal iteration by implementing:
+    //     typedef std::true_type PushCapable;
+    //     template<typename SinkT> bool pushAll( SinkT&& sink );
+    // pushAll feeds every remaining element to sink in turn. Stages implement it
+    // in terms of their source's pushAll, so a chain of map/filter/etc. fuses into
+    // a single loop driven by the underlying source, with no per-stage hasNext()
+    // checks or look-ahead buffering.
+    //
+    // A sink returning bool may stop the push early by returning false, in which
+    // case pushAll stops feeding it, reads nothing further from its source and
+    // returns false. The iterator is left as if the elements pushed so far had
+    // been pulled. Sinks returning anything else take every element, and pushAll
+    // then returns true.
+    template<typename IteratorT>
+    class IsPushCapable
+    {
+    private:
+        template<typename T> static typename T::PushCapable test( int );
+        template<typename T> static std::false_type test( ... );
+
+    public:
+        typedef decltype( test<IteratorT>( 0 ) ) type;
+        static const bool value = type::value;
+    };
+
+    // The type handed out by an Iterator, and therefore the type it pushes
+    template<typename IteratorT>
+    struct IteratorElement
+    {
+        typedef decltype( std::declval<IteratorT&>().next() ) type;
+    };
+
+    // Whether a sink taking ElT can ask for a push to stop
+    template<typename SinkT, typename ElT>
+    struct IsStoppingSink : public std::is_same<
+        decltype( std::declval<SinkT&>()( std::declval<ElT>() ) ), bool>
+    {
+    };
+    
+    template<typename SinkT, typename T>
+    bool feed( SinkT& sink, T&& v, std::true_type )
+    {
+        return sink( std::forward<T>(v) );
+    }
+    
+    template<typename SinkT, typename T>
+    bool feed( SinkT& sink, T&& v, std::false_type )
+    {
+        sink( std::forward<T>(v) );
+        return true;
+    }
+    
+    // Pass v to sink, returning false if the sink wants no more elements
+    template<typename SinkT, typename T>
+    bool feed( SinkT& sink, T&& v )
+    {
+        return feed( sink, std::forward<T>(v), typename IsStoppingSink<SinkT, T&&>::type() );
+    }
+
+    // Stages over cheap-to-copy (e.g. numeric) elements may also support a block
+    // protocol:
+    //     typedef std::true_type BatchCapable;
+    //     const el_t* nextBatch( el_t* buffer, size_t maxCount, size_t& count );
+    // nextBatch produces up to maxCount (never more than BatchSize) elements,
+    // either written into buffer or, for sources over contiguous storage, as a
+    // pointer straight into that storage. A short batch (count < maxCount) means
+    // the stage is exhausted. Working a block at a time keeps each stage's inner
+    // loop simple enough for the compiler to vectorise. Once a stage has handed
+    // out a batch it must only be consumed in batches from then on.
+    const size_t BatchSize = 512;
+    
+    template<typename T>
+    struct IsBatchable : public std::integral_constant<bool,
+        (std::is_scalar<T>::value || std::is_trivial<T>::value) && !std::is_const<T>::value>
+    {
+    };
+    
+    template<typename T1, typename T2>
+    struct IsBatchable<std::pair<T1, T2>> : public std::integral_constant<bool,
+        IsBatchable<T1>::value && IsBatchable<T2>::value>
+    {
+    };
+    
+    template<typename IteratorT>
+    class IsBatchCapable
+    {
+    private:
+        template<typename T> static typename T::BatchCapable test( int );
+        template<typename T> static std::false_type test( ... );
+        
+    public:
+        static const bool value = decltype( test<IteratorT>( 0 ) )::value &&
+            IsBatchable<typename IteratorElement<IteratorT>::type>::value;
+        typedef std::integral_constant<bool, value> type;
+    };
+
+    // Stages that can skip elements without producing them (e.g. over
+    // random-access storage) may implement:
+    //     typedef std::true_type Advanceable;
+    //     size_t advance( size_t n );
+    // advance skips up to n elements and returns how many were actually skipped,
+    // which is less than n only if the stage ran out.
+    template<typename IteratorT>
+    class IsAdvanceable
+    {
+    private:
+        template<typename T> static typename T::Advanceable test( int );
+        template<typename T> static std::false_type test( ... );
+        
+    public:
+        typedef decltype( test<IteratorT>( 0 ) ) type;
+        static const bool value = type::value;
+    };
+    
+    template<typename IteratorT>
+    size_t skip( IteratorT& it, size_t n, std::true_type )
+    {
+        return it.advance( n );
+    }
+    
+    template<typename IteratorT>
+    size_t skip( IteratorT& it, size_t n, std::false_type )
+    {
+        size_t skipped = 0;
+        while ( skipped < n && it.hasNext() )
+        {
+            it.next();
+            skipped++;
+        }
+        return skipped;
+    }
+    
+    // Skip up to n elements of it, returning the number skipped
+    template<typename IteratorT>
+    size_t skip( IteratorT& it, size_t n )
+    {
+        return skip( it, n, typename IsAdvanceable<IteratorT>::type() );
+    }
+
+    // Stages over contiguous storage of their elements may hand out everything
+    // that remains at once:
+    //     typedef std::true_type Contiguous;
+    //     const el_t* takeContiguous( size_t& count );
+    // after which the stage is exhausted.
+    template<typename IteratorT>
+    class IsContiguous
+    {
+    private:
+        template<typename T> static typename T::Contiguous test( int );
+        template<typename T> static std::false_type test( ... );
+        
+    public:
+        typedef decltype( test<IteratorT>( 0 ) ) type;
+        static const bool value = type::value;
+    };
+    
+    template<typename IteratorT, typename SinkT, typename PushCapableT>
+    bool drain( IteratorT& it, SinkT&& sink, std::true_type, PushCapableT )
+    {
+        typedef typename IteratorElement<IteratorT>::type el_t;
+        
+        el_t buffer[BatchSize];
+        size_t count = BatchSize;
+        while ( count == BatchSize )
+        {
+            const el_t* batch = it.nextBatch( buffer, BatchSize, count );
+            for ( size_t i = 0; i < count; ++i ) sink( batch[i] );
+        }
+        return true;
+    }
+
+    template<typename IteratorT, typename SinkT>
+    bool drain( IteratorT& it, SinkT&& sink, std::false_type, std::true_type )
+    {
+        return it.pushAll( std::forward<SinkT>(sink) );
+    }
+
+    template<typename IteratorT, typename SinkT>
+    bool drain( IteratorT& it, SinkT&& sink, std::false_type, std::false_type )
+    {
+        while ( it.hasNext() )
+        {
+            if ( !feed( sink, it.next() ) ) return false;
+        }
+        return true;
+    }
+
+    // Feed all remaining elements of it to sink, or until the sink stops it,
+    // returning false in the latter case. Chains that can push do so, as the
+    // fused loop beats staging each block through per-stage buffers. Chains that
+    // cannot (e.g. zip) go a block at a time where every stage supports it, and
+    // otherwise fall back to pulling. Sinks that can stop are never fed in
+    // blocks, so nothing is read past the element they stop at.
+    template<typename IteratorT, typename SinkT>
+    bool drain( IteratorT& it, SinkT&& sink )
+    {
+        typedef typename IteratorElement<IteratorT>::type el_t;
+        
+        return drain( it, std::forward<SinkT>(sink),
+            std::integral_constant<bool, IsBatchCapable<IteratorT>::value && !IsPushCapable<IteratorT>::value &&
+                !IsStoppingSink<typename std::remove_reference<SinkT>::type, el_t>::value>(),
+            typename IsPushCapable<IteratorT>::type() );
+    }
+
+}}
+
+#endif
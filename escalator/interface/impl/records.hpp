@@ -0,0 +1,360 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+#if defined(ESCALATOR_POSIX)
+
+namespace navetas { namespace escalator {
+
+    // Whether a record reader reads the next chunks on a background thread
+    // while the pipeline works through the current one
+    enum ReadAhead
+    {
+        BACKGROUND_READ_AHEAD,
+        NO_READ_AHEAD
+    };
+
+    // Splits what is read from a file descriptor into delimited records, handed
+    // out as views into the reader's buffers. Data arrives a chunk at a time,
+    // each read into a buffer after some headroom. A record split across chunks
+    // is completed by copying its start into the next buffer's headroom, so
+    // only records longer than the headroom are assembled separately, in a
+    // buffer that grows geometrically until the record is complete.
+    //
+    // A record stays valid until the one after it has been read: the buffer
+    // holding it is kept until another record has been handed out from a later
+    // one. That is only enough for a single step of lookahead (e.g. filter);
+    // anything holding records for longer must copy them, as the collecting
+    // operations (lower, sorts, distinct, groupBy etc.) do.
+    class RecordReader
+    {
+    public:
+        RecordReader( int fd, bool ownsFd, char delimiter, ReadAhead readAhead, size_t chunkSize ) :
+            m_fd(fd), m_ownsFd(ownsFd), m_delimiter(delimiter),
+            m_chunkSize(std::max<size_t>( chunkSize, 1 )), m_headroom(m_chunkSize / 8),
+            m_pos(nullptr), m_end(nullptr), m_scanned(nullptr), m_handedOut(false), m_assembling(false), m_exhausted(false),
+            m_stop(false), m_sourceDone(false), m_error(0)
+        {
+            if ( readAhead == BACKGROUND_READ_AHEAD ) m_thread = std::thread( [this]() { readAheadLoop(); } );
+        }
+
+        ~RecordReader()
+        {
+            if ( m_thread.joinable() )
+            {
+                {
+                    std::lock_guard<std::mutex> lock( m_mutex );
+                    m_stop = true;
+                }
+                m_cond.notify_all();
+                m_thread.join();
+            }
+            if ( m_ownsFd ) ::close( m_fd );
+        }
+
+        RecordReader( const RecordReader& ) = delete;
+        RecordReader& operator=( const RecordReader& ) = delete;
+
+        bool hasNext()
+        {
+            return m_pos != m_end || refill();
+        }
+
+        StringView next()
+        {
+            const char* delim;
+            while ( !( delim = findDelimiter() ) )
+            {
+                // The last record need not be terminated
+                if ( !refill() ) return handOut( m_end, m_end );
+            }
+            return handOut( delim, delim + 1 );
+        }
+
+    private:
+        static const size_t ReadyChunks = 2;
+        static const int PollMs = 50;
+
+        struct Chunk
+        {
+            std::vector<char>   buffer;
+            size_t              size;
+        };
+
+        const char* findDelimiter()
+        {
+            if ( m_scanned == m_end ) return nullptr;
+            const void* found = std::memchr( m_scanned, m_delimiter, m_end - m_scanned );
+            m_scanned = found ? static_cast<const char*>( found ) + 1 : m_end;
+            return static_cast<const char*>( found );
+        }
+
+        StringView handOut( const char* recordEnd, const char* nextPos )
+        {
+            StringView record( m_pos, recordEnd - m_pos );
+            m_pos = m_scanned = nextPos;
+            m_handedOut = true;
+            return record;
+        }
+
+        // Continue the unread data with the next chunk, returning false at the
+        // end of input
+        bool refill()
+        {
+            Chunk next;
+            if ( m_exhausted || !take( next ) )
+            {
+                m_exhausted = true;
+                return false;
+            }
+
+            size_t tail = m_end - m_pos;
+            size_t scanned = m_scanned - m_pos;
+            size_t size = tail + next.size;
+            if ( m_assembling && !m_handedOut )
+            {
+                // Still reading the record being assembled, which starts the
+                // current buffer: extend it in place, growing geometrically so
+                // that a long record is copied a constant number of times
+                if ( size > m_current.capacity() ) m_current.reserve( std::max( size, m_current.capacity() * 2 ) );
+                m_current.resize( size );
+                std::memcpy( m_current.data() + tail, next.buffer.data() + m_headroom, next.size );
+                give( std::move(next.buffer) );
+                
+                m_pos = m_current.data();
+                m_end = m_pos + size;
+                m_scanned = m_pos + scanned;
+                return true;
+            }
+            
+            char* start;
+            bool assembling = tail > m_headroom;
+            if ( !assembling )
+            {
+                start = next.buffer.data() + m_headroom - tail;
+                if ( tail > 0 ) std::memcpy( start, m_pos, tail );
+            }
+            else
+            {
+                std::vector<char> assembled;
+                assembled.reserve( size * 2 );
+                assembled.resize( size );
+                std::memcpy( assembled.data(), m_pos, tail );
+                std::memcpy( assembled.data() + tail, next.buffer.data() + m_headroom, next.size );
+                give( std::move(next.buffer) );
+                next.buffer.swap( assembled );
+                start = next.buffer.data();
+            }
+
+            // The current buffer is kept while the last record handed out may be
+            // in it; otherwise it only held the start of the record being read
+            if ( m_handedOut )
+            {
+                give( std::move(m_previous) );
+                m_previous.swap( m_current );
+            }
+            else
+            {
+                give( std::move(m_current) );
+            }
+            m_current.swap( next.buffer );
+            m_handedOut = false;
+            m_assembling = assembling;
+
+            m_pos = start;
+            m_end = start + size;
+            m_scanned = start + scanned;
+            return true;
+        }
+
+        bool take( Chunk& chunk )
+        {
+            if ( !m_thread.joinable() )
+            {
+                chunk.buffer = freeBuffer();
+                int error = readChunk( chunk );
+                ESCALATOR_ASSERT( error == 0, "Failed to read records: " << std::strerror( error ) );
+                return chunk.size > 0;
+            }
+
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_cond.wait( lock, [this]() { return !m_filled.empty() || m_sourceDone; } );
+            if ( m_filled.empty() )
+            {
+                ESCALATOR_ASSERT( m_error == 0, "Failed to read records: " << std::strerror( m_error ) );
+                return false;
+            }
+            chunk = std::move( m_filled.front() );
+            m_filled.pop_front();
+            lock.unlock();
+            m_cond.notify_all();
+            return true;
+        }
+
+        // Buffers assembling long records are larger than a chunk needs, and
+        // are freed rather than reused
+        void give( std::vector<char>&& buffer )
+        {
+            if ( buffer.empty() || buffer.capacity() > m_headroom + m_chunkSize ) return;
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_free.push_back( std::move(buffer) );
+        }
+
+        std::vector<char> freeBuffer()
+        {
+            std::vector<char> buffer;
+            {
+                std::lock_guard<std::mutex> lock( m_mutex );
+                if ( !m_free.empty() )
+                {
+                    buffer.swap( m_free.back() );
+                    m_free.pop_back();
+                }
+            }
+            buffer.resize( m_headroom + m_chunkSize );
+            return buffer;
+        }
+
+        // One read into the chunk after its headroom, returning errno on failure
+        int readChunk( Chunk& chunk )
+        {
+            while ( true )
+            {
+                ssize_t n = ::read( m_fd, chunk.buffer.data() + m_headroom, m_chunkSize );
+                if ( n >= 0 )
+                {
+                    chunk.size = static_cast<size_t>( n );
+                    return 0;
+                }
+                if ( errno != EINTR ) return errno;
+            }
+        }
+
+        // Keep up to two chunks ready. Waits for input with a timeout, so that
+        // the reader can be destroyed even while a pipe is idle.
+        void readAheadLoop()
+        {
+            while ( true )
+            {
+                {
+                    std::unique_lock<std::mutex> lock( m_mutex );
+                    m_cond.wait( lock, [this]() { return m_stop || m_filled.size() < ReadyChunks; } );
+                    if ( m_stop ) return;
+                }
+
+                pollfd ready;
+                ready.fd = m_fd;
+                ready.events = POLLIN;
+                int polled = ::poll( &ready, 1, PollMs );
+                int error = polled < 0 && errno != EINTR ? errno : 0;
+
+                Chunk chunk;
+                chunk.size = 0;
+                if ( polled > 0 )
+                {
+                    chunk.buffer = freeBuffer();
+                    error = readChunk( chunk );
+                }
+                else if ( error == 0 )
+                {
+                    // Timed out or interrupted: check for a stop and wait again
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock( m_mutex );
+                    if ( chunk.size > 0 ) m_filled.push_back( std::move(chunk) );
+                    else
+                    {
+                        m_sourceDone = true;
+                        m_error = error;
+                    }
+                }
+                m_cond.notify_all();
+                if ( chunk.size == 0 ) return;
+            }
+        }
+
+        int                 m_fd;
+        bool                m_ownsFd;
+        char                m_delimiter;
+        size_t              m_chunkSize;
+        size_t              m_headroom;
+
+        // Read by the consuming thread only
+        std::vector<char>   m_current;
+        std::vector<char>   m_previous;
+        const char*         m_pos;
+        const char*         m_end;
+        const char*         m_scanned;
+        bool                m_handedOut;
+        bool                m_assembling;
+        bool                m_exhausted;
+
+        // Shared with the read-ahead thread, under m_mutex
+        std::mutex                  m_mutex;
+        std::condition_variable     m_cond;
+        std::deque<Chunk>           m_filled;
+        std::vector<std::vector<char>> m_free;
+        bool                        m_stop;
+        bool                        m_sourceDone;
+        int                         m_error;
+        std::thread                 m_thread;
+    };
+
+    // The records read from a file descriptor, as views valid until the record
+    // after them has been read (see RecordReader). For input that cannot be
+    // mapped: pipes, FIFOs, stdin. Copies of the wrapper share one reader, and
+    // so one position in the input.
+    class RecordsWrapper : public Conversions<RecordsWrapper, StringView, StringView>
+    {
+    public:
+        RecordsWrapper( std::shared_ptr<RecordReader> reader ) : m_reader(reader)
+        {
+        }
+
+        typedef RecordsWrapper Iterator;
+        Iterator& getIterator() { return *this; }
+
+        bool hasNext() { return m_reader->hasNext(); }
+        StringView next() { return m_reader->next(); }
+
+        typedef std::true_type PushCapable;
+
+        template<typename SinkT>
+        bool pushAll( SinkT&& sink )
+        {
+            RecordReader& reader = *m_reader;
+            while ( reader.hasNext() )
+            {
+                if ( !feed( sink, reader.next() ) ) return false;
+            }
+            return true;
+        }
+
+    private:
+        std::shared_ptr<RecordReader> m_reader;
+    };
+
+    // Records of fd, which stays open (and owned by the caller)
+    inline RecordsWrapper lift_fd_records( int fd, char delimiter='\n',
+        ReadAhead readAhead=BACKGROUND_READ_AHEAD, size_t chunkSize=1 << 20 )
+    {
+        return RecordsWrapper( std::make_shared<RecordReader>( fd, false, delimiter, readAhead, chunkSize ) );
+    }
+
+    // Records of the file (or FIFO etc.) at path, closed with the last copy of
+    // the wrapper
+    inline RecordsWrapper lift_file_records( const std::string& path, char delimiter='\n',
+        ReadAhead readAhead=BACKGROUND_READ_AHEAD, size_t chunkSize=1 << 20 )
+    {
+        int fd = ::open( path.c_str(), O_RDONLY );
+        ESCALATOR_ASSERT( fd >= 0, "Failed to open " << path << ": " << std::strerror( errno ) );
+        return RecordsWrapper( std::make_shared<RecordReader>( fd, true, delimiter, readAhead, chunkSize ) );
+    }
+
+}}
+
+#endif
+
+#endif
@@ -0,0 +1,332 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Work-stealing pool that parallel operations run on. Each worker owns a
+    // deque: it pushes and pops its own tasks at the back, and when that runs
+    // dry steals from the front of the others' (the oldest, and so typically
+    // largest, pieces of work). Tasks submitted from outside the pool go on a
+    // shared queue. Threads waiting on a TaskGroup run queued tasks, and only
+    // sleep when there is nothing to steal, so nested parallel operations reuse
+    // the same workers instead of oversubscribing the machine.
+    class TaskScheduler
+    {
+    public:
+        typedef std::function<void()> Task;
+
+        explicit TaskScheduler( size_t workers ) : m_queued(0), m_stopping(false)
+        {
+            ESCALATOR_ASSERT( workers > 0, "A scheduler needs at least one worker" );
+            for ( size_t i = 0; i < workers; ++i ) m_queues.push_back( std::unique_ptr<TaskQueue>( new TaskQueue() ) );
+
+            try
+            {
+                for ( size_t i = 0; i < workers; ++i ) m_threads.push_back( std::thread( [this, i]() { workerLoop( i ); } ) );
+            }
+            catch ( ... )
+            {
+                shutdown();
+                throw;
+            }
+        }
+
+        ~TaskScheduler() { shutdown(); }
+
+        size_t workerCount() const { return m_queues.size(); }
+
+        // The process-wide pool, started on first use
+        static TaskScheduler& global()
+        {
+            globalStarted() = true;
+            static TaskScheduler scheduler( globalWorkerCount() );
+            return scheduler;
+        }
+
+        // Set the number of workers in the global pool. Only valid before it
+        // has started; by default there is one per core, less the caller's.
+        static void setGlobalWorkerCount( size_t workers )
+        {
+            ESCALATOR_ASSERT( !globalStarted(), "The global scheduler has already started" );
+            ESCALATOR_ASSERT( workers > 0, "A scheduler needs at least one worker" );
+            globalWorkerCount() = workers;
+        }
+
+        void submit( Task task )
+        {
+            WorkerContext* context = currentWorker().get();
+            TaskQueue& queue = ( context && context->scheduler == this ) ? *m_queues[context->index] : m_injected;
+            {
+                std::lock_guard<std::mutex> lock( queue.mutex );
+                queue.tasks.push_back( std::move(task) );
+                m_queued++;
+            }
+
+            // Taking the lock orders this with a worker checking m_queued before sleeping
+            {
+                std::lock_guard<std::mutex> lock( m_sleepMutex );
+            }
+            m_wake.notify_one();
+        }
+
+        // Run one queued task on the calling thread, if there is one
+        bool tryRunOne()
+        {
+            WorkerContext* context = currentWorker().get();
+            bool isWorker = context && context->scheduler == this;
+
+            Task task;
+            if ( findTask( isWorker ? context->index : m_queues.size(), task ) )
+            {
+                task();
+                return true;
+            }
+            return false;
+        }
+
+        // Sleep until done() holds or a task is queued. Threads waiting on
+        // a TaskGroup call this once they have found nothing to run.
+        template<typename DoneT>
+        void waitForWork( DoneT done )
+        {
+            std::unique_lock<std::mutex> lock( m_sleepMutex );
+            m_wake.wait( lock, [this, &done]() { return m_queued > 0 || done(); } );
+        }
+
+        // Wake the threads in waitForWork to check whether they are done
+        void notifyWaiters()
+        {
+            // As in submit, the lock orders this with a waiter's check
+            {
+                std::lock_guard<std::mutex> lock( m_sleepMutex );
+            }
+            m_wake.notify_all();
+        }
+
+    private:
+        struct TaskQueue
+        {
+            std::mutex          mutex;
+            std::deque<Task>    tasks;
+        };
+
+        struct WorkerContext
+        {
+            TaskScheduler*  scheduler;
+            size_t          index;
+        };
+
+        static void noCleanup( WorkerContext* ) {}
+
+        static boost::thread_specific_ptr<WorkerContext>& currentWorker()
+        {
+            static boost::thread_specific_ptr<WorkerContext> context( &TaskScheduler::noCleanup );
+            return context;
+        }
+
+        static std::atomic<bool>& globalStarted()
+        {
+            static std::atomic<bool> started( false );
+            return started;
+        }
+
+        static size_t& globalWorkerCount()
+        {
+            static size_t workers = std::max<size_t>( 2, std::thread::hardware_concurrency() ) - 1;
+            return workers;
+        }
+
+        bool popBack( TaskQueue& queue, Task& task )
+        {
+            std::lock_guard<std::mutex> lock( queue.mutex );
+            if ( queue.tasks.empty() ) return false;
+            task = std::move( queue.tasks.back() );
+            queue.tasks.pop_back();
+            m_queued--;
+            return true;
+        }
+
+        bool popFront( TaskQueue& queue, Task& task )
+        {
+            std::lock_guard<std::mutex> lock( queue.mutex );
+            if ( queue.tasks.empty() ) return false;
+            task = std::move( queue.tasks.front() );
+            queue.tasks.pop_front();
+            m_queued--;
+            return true;
+        }
+
+        // self is the calling worker's index, or workerCount() from outside the pool
+        bool findTask( size_t self, Task& task )
+        {
+            if ( m_queued == 0 ) return false;
+            if ( self < m_queues.size() && popBack( *m_queues[self], task ) ) return true;
+            if ( popFront( m_injected, task ) ) return true;
+
+            size_t count = m_queues.size();
+            for ( size_t i = 1; i <= count; ++i )
+            {
+                size_t victim = ( self + i ) % count;
+                if ( victim != self && popFront( *m_queues[victim], task ) ) return true;
+            }
+            return false;
+        }
+
+        void workerLoop( size_t index )
+        {
+            WorkerContext context = { this, index };
+            currentWorker().reset( &context );
+
+            Task task;
+            while ( true )
+            {
+                if ( findTask( index, task ) )
+                {
+                    task();
+                    task = Task();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock( m_sleepMutex );
+                m_wake.wait( lock, [this]() { return m_stopping || m_queued > 0; } );
+                if ( m_stopping ) break;
+            }
+            currentWorker().reset();
+        }
+
+        void shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> lock( m_sleepMutex );
+                m_stopping = true;
+            }
+            m_wake.notify_all();
+            for ( auto& t : m_threads ) t.join();
+            m_threads.clear();
+        }
+
+        std::vector<std::unique_ptr<TaskQueue>> m_queues;
+        TaskQueue                               m_injected;
+        std::vector<std::thread>                m_threads;
+        std::atomic<size_t>                     m_queued;
+        std::mutex                              m_sleepMutex;
+        std::condition_variable                 m_wake;
+        bool                                    m_stopping;
+    };
+
+    // A set of tasks that can be waited on together. wait() runs queued work
+    // until every task in the group has finished, then rethrows the first
+    // exception any of them raised.
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup( TaskScheduler& scheduler=TaskScheduler::global() ) : m_scheduler(scheduler), m_pending(0)
+        {
+        }
+
+        ~TaskGroup()
+        {
+            // Tasks may refer to the waiter's stack, so never leave them running
+            try { wait(); }
+            catch ( ... ) {}
+        }
+
+        TaskScheduler& scheduler() { return m_scheduler; }
+
+        template<typename FnT>
+        void run( FnT fn )
+        {
+            m_pending++;
+            m_scheduler.submit( [this, fn]()
+            {
+                try { fn(); }
+                catch ( ... ) { recordError( std::current_exception() ); }
+
+                // Must be the last access to the group, as the waiter may then
+                // destroy it. The scheduler outlives it.
+                TaskScheduler& scheduler = m_scheduler;
+                if ( --m_pending == 0 ) scheduler.notifyWaiters();
+            } );
+        }
+
+        void wait()
+        {
+            while ( m_pending > 0 )
+            {
+                // Nothing to steal: the rest of the group is running elsewhere
+                if ( !m_scheduler.tryRunOne() ) m_scheduler.waitForWork( [this]() { return m_pending == 0; } );
+            }
+
+            std::exception_ptr error;
+            {
+                std::lock_guard<std::mutex> lock( m_errorMutex );
+                std::swap( error, m_error );
+            }
+            if ( error ) std::rethrow_exception( error );
+        }
+
+    private:
+        TaskGroup( const TaskGroup& );
+        TaskGroup& operator=( const TaskGroup& );
+
+        void recordError( std::exception_ptr error )
+        {
+            std::lock_guard<std::mutex> lock( m_errorMutex );
+            if ( !m_error ) m_error = error;
+        }
+
+        TaskScheduler&          m_scheduler;
+        std::atomic<size_t>     m_pending;
+        std::mutex              m_errorMutex;
+        std::exception_ptr      m_error;
+    };
+
+    template<typename FnT>
+    void parallelForRange( TaskGroup& group, size_t from, size_t to, FnT& fn )
+    {
+        // Hand off the upper half and carry on with the lower, so idle workers
+        // steal the largest remaining pieces
+        while ( to - from > 1 )
+        {
+            size_t mid = from + ( to - from ) / 2;
+            group.run( [&group, &fn, mid, to]() { parallelForRange( group, mid, to, fn ); } );
+            to = mid;
+        }
+        fn( from );
+    }
+
+    // Runs fn( i ) for each i in [0, count) on the scheduler, returning once all
+    // have finished and rethrowing the first exception raised
+    template<typename FnT>
+    void parallelFor( size_t count, FnT& fn, TaskScheduler& scheduler=TaskScheduler::global() )
+    {
+        if ( count == 0 ) return;
+        if ( count == 1 )
+        {
+            fn( 0 );
+            return;
+        }
+
+        TaskGroup group( scheduler );
+        group.run( [&group, &fn, count]() { parallelForRange( group, 0, count, fn ); } );
+        group.wait();
+    }
+
+    // As parallelFor, with at most maxConcurrency of the calls running at once:
+    // that many tasks each take the next unclaimed index until none are left
+    template<typename FnT>
+    void parallelForAtMost( size_t count, size_t maxConcurrency, FnT& fn, TaskScheduler& scheduler=TaskScheduler::global() )
+    {
+        std::atomic<size_t> next( 0 );
+        auto claim = [&next, &fn, count]( size_t )
+        {
+            for ( size_t i = next++; i < count; i = next++ ) fn( i );
+        };
+        parallelFor( std::min( count, std::max<size_t>( 1, maxConcurrency ) ), claim, scheduler );
+    }
+
+}}
+
+#endif
@@ -0,0 +1,217 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+// Reductions over contiguous arithmetic storage are vectorised with GCC vector
+// extensions: 16 byte vectors (SSE2 on x86-64) always, and 32 byte vectors on
+// x86 CPUs that support AVX2, detected at runtime. Define ESCALATOR_NO_SIMD to
+// use the scalar loops instead.
+#if defined(__GNUC__) && !defined(__clang__) && !defined(ESCALATOR_NO_SIMD)
+#   define ESCALATOR_SIMD_VECTORS
+#   if defined(__x86_64__) || defined(__i386__)
+#       define ESCALATOR_SIMD_AVX2
+#   endif
+#endif
+
+
+namespace navetas { namespace escalator {
+
+    template<typename T>
+    struct IsSimdElement : public std::integral_constant<bool,
+        std::is_same<T, int>::value || std::is_same<T, int64_t>::value ||
+        std::is_same<T, float>::value || std::is_same<T, double>::value>
+    {
+    };
+
+    // Sources whose remaining elements can be reduced in place by SimdKernels
+    template<typename IteratorT>
+    struct IsSimdReducible : public std::integral_constant<bool,
+        IsContiguous<IteratorT>::value &&
+        IsSimdElement<typename std::remove_reference<typename IteratorElement<IteratorT>::type>::type>::value>
+    {
+    };
+
+#if defined(ESCALATOR_SIMD_VECTORS)
+
+    template<typename T, size_t Bytes>
+    struct SimdVector
+    {
+        typedef T type __attribute__(( vector_size( Bytes ) ));
+        static const size_t Lanes = Bytes / sizeof(T);
+    };
+
+    // The kernels are written once for any vector width and inlined into a
+    // wrapper per instruction set. Each keeps two accumulators to hide latency.
+    template<typename T, size_t Bytes>
+    inline __attribute__(( always_inline )) T simdSum( const T* p, size_t n )
+    {
+        typedef typename SimdVector<T, Bytes>::type vec_t;
+        const size_t Lanes = SimdVector<T, Bytes>::Lanes;
+
+        vec_t acc0 = {}, acc1 = {};
+        size_t blocks = n / ( 2 * Lanes );
+        for ( size_t b = 0; b < blocks; ++b )
+        {
+            vec_t x0, x1;
+            std::memcpy( &x0, p + 2 * Lanes * b, Bytes );
+            std::memcpy( &x1, p + 2 * Lanes * b + Lanes, Bytes );
+            acc0 += x0;
+            acc1 += x1;
+        }
+        acc0 += acc1;
+
+        T total = T();
+        for ( size_t l = 0; l < Lanes; ++l ) total += acc0[l];
+        for ( size_t i = 2 * Lanes * blocks; i < n; ++i ) total += p[i];
+        return total;
+    }
+
+    // The least (or greatest) element under < (or >), as a scalar loop starting
+    // from p[0] would find it. Lanes start from p[0] too, so none can get stuck
+    // on a NaN unless p[0] is one.
+    template<typename T, size_t Bytes, bool Greatest>
+    inline __attribute__(( always_inline )) T simdExtremum( const T* p, size_t n )
+    {
+        typedef typename SimdVector<T, Bytes>::type vec_t;
+        const size_t Lanes = SimdVector<T, Bytes>::Lanes;
+
+        vec_t ext0, ext1;
+        for ( size_t l = 0; l < Lanes; ++l ) ext0[l] = ext1[l] = p[0];
+
+        size_t blocks = n / ( 2 * Lanes );
+        for ( size_t b = 0; b < blocks; ++b )
+        {
+            vec_t x0, x1;
+            std::memcpy( &x0, p + 2 * Lanes * b, Bytes );
+            std::memcpy( &x1, p + 2 * Lanes * b + Lanes, Bytes );
+            if ( Greatest )
+            {
+                ext0 = x0 > ext0 ? x0 : ext0;
+                ext1 = x1 > ext1 ? x1 : ext1;
+            }
+            else
+            {
+                ext0 = x0 < ext0 ? x0 : ext0;
+                ext1 = x1 < ext1 ? x1 : ext1;
+            }
+        }
+
+        T ext = p[0];
+        for ( size_t l = 0; l < Lanes; ++l )
+        {
+            if ( Greatest ? ext0[l] > ext : ext0[l] < ext ) ext = ext0[l];
+            if ( Greatest ? ext1[l] > ext : ext1[l] < ext ) ext = ext1[l];
+        }
+        for ( size_t i = 2 * Lanes * blocks; i < n; ++i )
+        {
+            if ( Greatest ? p[i] > ext : p[i] < ext ) ext = p[i];
+        }
+        return ext;
+    }
+
+    // A plain loop, which the compiler vectorises for whichever instruction set
+    // the wrapper targets where the predicate is simple enough
+    template<typename T, typename PredT>
+    inline __attribute__(( always_inline )) size_t simdCountIf( const T* p, size_t n, PredT& pred )
+    {
+        size_t count = 0;
+        for ( size_t i = 0; i < n; ++i ) count += pred( p[i] ) ? 1 : 0;
+        return count;
+    }
+
+#if defined(ESCALATOR_SIMD_AVX2)
+
+    inline bool cpuHasAvx2()
+    {
+        static const bool avx2 = __builtin_cpu_supports( "avx2" );
+        return avx2;
+    }
+
+    template<typename T>
+    __attribute__(( target( "avx2" ) )) T simdSumAvx2( const T* p, size_t n )
+    {
+        return simdSum<T, 32>( p, n );
+    }
+
+    template<typename T, bool Greatest>
+    __attribute__(( target( "avx2" ) )) T simdExtremumAvx2( const T* p, size_t n )
+    {
+        return simdExtremum<T, 32, Greatest>( p, n );
+    }
+
+    template<typename T, typename PredT>
+    __attribute__(( target( "avx2" ) )) size_t simdCountIfAvx2( const T* p, size_t n, PredT& pred )
+    {
+        return simdCountIf( p, n, pred );
+    }
+
+#endif
+#endif
+
+    // Reductions over n contiguous elements, picking the widest kernel the CPU
+    // supports. sum and the extrema require n > 0. Floating point sums are
+    // accumulated in several lanes, so may round differently to a sequential
+    // loop.
+    template<typename T>
+    struct SimdKernels
+    {
+        static T sum( const T* p, size_t n )
+        {
+#if defined(ESCALATOR_SIMD_AVX2)
+            if ( cpuHasAvx2() ) return simdSumAvx2( p, n );
+#endif
+#if defined(ESCALATOR_SIMD_VECTORS)
+            return simdSum<T, 16>( p, n );
+#else
+            T total = p[0];
+            for ( size_t i = 1; i < n; ++i ) total += p[i];
+            return total;
+#endif
+        }
+
+        template<bool Greatest>
+        static T extremum( const T* p, size_t n )
+        {
+#if defined(ESCALATOR_SIMD_AVX2)
+            if ( cpuHasAvx2() ) return simdExtremumAvx2<T, Greatest>( p, n );
+#endif
+#if defined(ESCALATOR_SIMD_VECTORS)
+            return simdExtremum<T, 16, Greatest>( p, n );
+#else
+            T ext = p[0];
+            for ( size_t i = 1; i < n; ++i )
+            {
+                if ( Greatest ? p[i] > ext : p[i] < ext ) ext = p[i];
+            }
+            return ext;
+#endif
+        }
+
+        // The first extremal element and its index, as argMin/argMax
+        template<bool Greatest>
+        static std::pair<size_t, T> argExtremum( const T* p, size_t n )
+        {
+            T ext = extremum<Greatest>( p, n );
+            for ( size_t i = 0; i < n; ++i )
+            {
+                if ( p[i] == ext ) return std::make_pair( i, p[i] );
+            }
+            // Only where p[0] is NaN
+            return std::make_pair( size_t(0), p[0] );
+        }
+
+        template<typename PredT>
+        static size_t countIf( const T* p, size_t n, PredT& pred )
+        {
+#if defined(ESCALATOR_SIMD_AVX2)
+            if ( cpuHasAvx2() ) return simdCountIfAvx2( p, n, pred );
+#endif
+            size_t count = 0;
+            for ( size_t i = 0; i < n; ++i ) count += pred( p[i] ) ? 1 : 0;
+            return count;
+        }
+    };
+
+}}
+
+#endif
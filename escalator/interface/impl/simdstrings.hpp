@@ -0,0 +1,341 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Whitespace as isspace in the "C" locale
+    inline bool isAsciiSpace( char c )
+    {
+        return c == ' ' || static_cast<unsigned char>( c - '\t' ) < 5;
+    }
+
+    // A set of characters to search for, e.g. split separators. Sets of up to
+    // MaxVectorChars distinct characters are searched for a block at a time,
+    // with one vector compare per character; larger ones a byte at a time.
+    class CharSet
+    {
+    public:
+        static const size_t MaxVectorChars = 4;
+
+        CharSet( const char* chars, size_t n ) : m_count(0)
+        {
+            std::fill( m_table, m_table + 256, false );
+            for ( size_t i = 0; i < n; ++i )
+            {
+                unsigned char c = static_cast<unsigned char>( chars[i] );
+                if ( m_table[c] ) continue;
+                m_table[c] = true;
+                if ( m_count < MaxVectorChars ) m_chars[m_count] = chars[i];
+                ++m_count;
+            }
+        }
+
+        size_t size() const { return m_count; }
+        const char* chars() const { return m_chars; }
+        bool contains( char c ) const { return m_table[static_cast<unsigned char>( c )]; }
+
+    private:
+        size_t  m_count;
+        char    m_chars[MaxVectorChars];
+        bool    m_table[256];
+    };
+
+#if defined(ESCALATOR_SIMD_VECTORS)
+
+    // The lanes of a comparison result, lane i in bit i
+    template<size_t Bytes>
+    struct ByteMask
+    {
+        typedef typename SimdVector<signed char, Bytes>::type mask_t;
+        static const uint32_t All = static_cast<uint32_t>( ( uint64_t(1) << Bytes ) - 1 );
+
+        static inline __attribute__(( always_inline )) uint32_t bits( const mask_t& m )
+        {
+            uint32_t b = 0;
+            for ( size_t l = 0; l < Bytes; ++l ) b |= uint32_t( m[l] & 1 ) << l;
+            return b;
+        }
+    };
+
+#if defined(__SSE2__)
+
+    template<>
+    inline __attribute__(( always_inline )) uint32_t ByteMask<16>::bits( const mask_t& m )
+    {
+        return static_cast<uint32_t>( _mm_movemask_epi8( (__m128i) m ) );
+    }
+
+    // In halves, so that it can be inlined into kernels with or without AVX2
+    // enabled (the 256 bit movemask is only available with it)
+    template<>
+    inline __attribute__(( always_inline )) uint32_t ByteMask<32>::bits( const mask_t& m )
+    {
+        ByteMask<16>::mask_t lo, hi;
+        std::memcpy( &lo, &m, 16 );
+        std::memcpy( &hi, reinterpret_cast<const char*>( &m ) + 16, 16 );
+        return ByteMask<16>::bits( lo ) | ( ByteMask<16>::bits( hi ) << 16 );
+    }
+
+#endif
+
+    // Vectors are filled in through references, as returning 32 byte vectors
+    // by value from functions not compiled for AVX2 changes their ABI
+
+    template<size_t Bytes>
+    inline __attribute__(( always_inline )) void broadcastByte( typename SimdVector<unsigned char, Bytes>::type& v, char c )
+    {
+        for ( size_t l = 0; l < Bytes; ++l ) v[l] = static_cast<unsigned char>( c );
+    }
+
+    template<size_t Bytes>
+    inline __attribute__(( always_inline )) void loadBytes( typename SimdVector<unsigned char, Bytes>::type& v, const char* p )
+    {
+        std::memcpy( &v, p, Bytes );
+    }
+
+    // Bits for the bytes of the block at p that are any of want[0..N)
+    template<size_t Bytes, size_t N>
+    inline __attribute__(( always_inline )) uint32_t anyOfBits( const char* p, const typename SimdVector<unsigned char, Bytes>::type* want )
+    {
+        typename SimdVector<unsigned char, Bytes>::type x;
+        loadBytes<Bytes>( x, p );
+        typename ByteMask<Bytes>::mask_t m = x == want[0];
+        for ( size_t k = 1; k < N; ++k ) m |= x == want[k];
+        return ByteMask<Bytes>::bits( m );
+    }
+
+    // Bits for the bytes of the block at p that are not whitespace
+    template<size_t Bytes>
+    inline __attribute__(( always_inline )) uint32_t nonSpaceBits( const char* p )
+    {
+        typename SimdVector<unsigned char, Bytes>::type x, space, tab, count;
+        loadBytes<Bytes>( x, p );
+        broadcastByte<Bytes>( space, ' ' );
+        broadcastByte<Bytes>( tab, '\t' );
+        broadcastByte<Bytes>( count, 5 );
+        typename ByteMask<Bytes>::mask_t isSpace = ( x == space ) | ( ( x - tab ) < count );
+        return ~ByteMask<Bytes>::bits( isSpace ) & ByteMask<Bytes>::All;
+    }
+
+    // The scans below go a block at a time. The remainder of a range at least
+    // a block long is covered by one more block ending at its end, overlapping
+    // what has been scanned already; shorter ranges go a byte at a time.
+
+    // The first of chars[0..N) in [p, end), or end
+    template<size_t Bytes, size_t N>
+    inline __attribute__(( always_inline )) const char* simdFindAny( const char* p, const char* end, const char* chars )
+    {
+        typename SimdVector<unsigned char, Bytes>::type want[N];
+        for ( size_t k = 0; k < N; ++k ) broadcastByte<Bytes>( want[k], chars[k] );
+
+        const char* begin = p;
+        for ( ; end - p >= ptrdiff_t(Bytes); p += Bytes )
+        {
+            uint32_t bits = anyOfBits<Bytes, N>( p, want );
+            if ( bits ) return p + __builtin_ctz( bits );
+        }
+        if ( p == end ) return end;
+
+        if ( end - begin >= ptrdiff_t(Bytes) )
+        {
+            const char* last = end - Bytes;
+            uint32_t bits = anyOfBits<Bytes, N>( last, want ) >> ( p - last );
+            return bits ? p + __builtin_ctz( bits ) : end;
+        }
+        for ( ; p != end; ++p )
+        {
+            for ( size_t k = 0; k < N; ++k )
+            {
+                if ( *p == chars[k] ) return p;
+            }
+        }
+        return end;
+    }
+
+    // The first non-whitespace character in [p, end), or end
+    template<size_t Bytes>
+    inline __attribute__(( always_inline )) const char* simdSkipSpace( const char* p, const char* end )
+    {
+        // Most strings have nothing to trim
+        if ( p == end || !isAsciiSpace( *p ) ) return p;
+
+        const char* begin = p;
+        for ( ; end - p >= ptrdiff_t(Bytes); p += Bytes )
+        {
+            uint32_t bits = nonSpaceBits<Bytes>( p );
+            if ( bits ) return p + __builtin_ctz( bits );
+        }
+        if ( p == end ) return end;
+
+        if ( end - begin >= ptrdiff_t(Bytes) )
+        {
+            const char* last = end - Bytes;
+            uint32_t bits = nonSpaceBits<Bytes>( last ) >> ( p - last );
+            return bits ? p + __builtin_ctz( bits ) : end;
+        }
+        while ( p != end && isAsciiSpace( *p ) ) ++p;
+        return p;
+    }
+
+    // The end of [begin, end) without its trailing whitespace
+    template<size_t Bytes>
+    inline __attribute__(( always_inline )) const char* simdSkipSpaceBack( const char* begin, const char* end )
+    {
+        if ( end == begin || !isAsciiSpace( end[-1] ) ) return end;
+
+        const char* p = end;
+        for ( ; p - begin >= ptrdiff_t(Bytes); p -= Bytes )
+        {
+            uint32_t bits = nonSpaceBits<Bytes>( p - Bytes );
+            if ( bits ) return p - Bytes + ( 32 - __builtin_clz( bits ) );
+        }
+        if ( p == begin ) return begin;
+
+        if ( end - begin >= ptrdiff_t(Bytes) )
+        {
+            uint32_t bits = nonSpaceBits<Bytes>( begin ) & ( ( 1u << ( p - begin ) ) - 1 );
+            return bits ? begin + ( 32 - __builtin_clz( bits ) ) : begin;
+        }
+        while ( p != begin && isAsciiSpace( p[-1] ) ) --p;
+        return p;
+    }
+
+    // The first occurrence of needle[0..k) in [p, end), or end, for k >= 2.
+    // Candidates are positions matching both the first and last characters of
+    // the needle, a block at a time; only those are compared in full.
+    template<size_t Bytes>
+    inline __attribute__(( always_inline )) const char* simdSearch( const char* p, const char* end, const char* needle, size_t k )
+    {
+        typename SimdVector<unsigned char, Bytes>::type first, last, head, tail;
+        broadcastByte<Bytes>( first, needle[0] );
+        broadcastByte<Bytes>( last, needle[k - 1] );
+
+        for ( ; end - p >= ptrdiff_t(Bytes + k - 1); p += Bytes )
+        {
+            loadBytes<Bytes>( head, p );
+            loadBytes<Bytes>( tail, p + k - 1 );
+            typename ByteMask<Bytes>::mask_t m = ( head == first ) & ( tail == last );
+            for ( uint32_t bits = ByteMask<Bytes>::bits( m ); bits; bits &= bits - 1 )
+            {
+                const char* candidate = p + __builtin_ctz( bits );
+                if ( std::memcmp( candidate + 1, needle + 1, k - 2 ) == 0 ) return candidate;
+            }
+        }
+        return std::search( p, end, needle, needle + k );
+    }
+
+#if defined(ESCALATOR_SIMD_AVX2)
+
+    template<size_t N>
+    __attribute__(( target( "avx2" ) )) const char* simdFindAnyAvx2( const char* p, const char* end, const char* chars )
+    {
+        return simdFindAny<32, N>( p, end, chars );
+    }
+
+    __attribute__(( target( "avx2" ) )) inline const char* simdSkipSpaceAvx2( const char* p, const char* end )
+    {
+        return simdSkipSpace<32>( p, end );
+    }
+
+    __attribute__(( target( "avx2" ) )) inline const char* simdSkipSpaceBackAvx2( const char* begin, const char* end )
+    {
+        return simdSkipSpaceBack<32>( begin, end );
+    }
+
+    __attribute__(( target( "avx2" ) )) inline const char* simdSearchAvx2( const char* p, const char* end, const char* needle, size_t k )
+    {
+        return simdSearch<32>( p, end, needle, k );
+    }
+
+#endif
+#endif
+
+    // Character scans over [p, end) for splitting, trimming and searching
+    // strings, picking the widest kernel the CPU supports as SimdKernels does.
+    // Each returns a pointer into the range, end where nothing is found.
+    struct StringKernels
+    {
+        static const char* findAny( const char* p, const char* end, const CharSet& set )
+        {
+#if defined(ESCALATOR_SIMD_VECTORS)
+            switch ( set.size() )
+            {
+            case 0:
+                return end;
+            case 1:
+                return findAny<1>( p, end, set.chars() );
+            case 2:
+                return findAny<2>( p, end, set.chars() );
+            case 3:
+                return findAny<3>( p, end, set.chars() );
+            case 4:
+                return findAny<4>( p, end, set.chars() );
+            }
+#endif
+            while ( p != end && !set.contains( *p ) ) ++p;
+            return p;
+        }
+
+        static const char* skipSpace( const char* p, const char* end )
+        {
+#if defined(ESCALATOR_SIMD_AVX2)
+            if ( cpuHasAvx2() ) return simdSkipSpaceAvx2( p, end );
+#endif
+#if defined(ESCALATOR_SIMD_VECTORS)
+            return simdSkipSpace<16>( p, end );
+#else
+            while ( p != end && isAsciiSpace( *p ) ) ++p;
+            return p;
+#endif
+        }
+
+        static const char* skipSpaceBack( const char* begin, const char* end )
+        {
+#if defined(ESCALATOR_SIMD_AVX2)
+            if ( cpuHasAvx2() ) return simdSkipSpaceBackAvx2( begin, end );
+#endif
+#if defined(ESCALATOR_SIMD_VECTORS)
+            return simdSkipSpaceBack<16>( begin, end );
+#else
+            while ( end != begin && isAsciiSpace( end[-1] ) ) --end;
+            return end;
+#endif
+        }
+
+        // The first occurrence of needle[0..k); p itself for an empty needle
+        static const char* search( const char* p, const char* end, const char* needle, size_t k )
+        {
+            if ( k == 0 ) return p;
+            if ( k == 1 )
+            {
+                const void* found = p == end ? nullptr : std::memchr( p, needle[0], end - p );
+                return found ? static_cast<const char*>( found ) : end;
+            }
+#if defined(ESCALATOR_SIMD_AVX2)
+            if ( cpuHasAvx2() ) return simdSearchAvx2( p, end, needle, k );
+#endif
+#if defined(ESCALATOR_SIMD_VECTORS)
+            return simdSearch<16>( p, end, needle, k );
+#else
+            return std::search( p, end, needle, needle + k );
+#endif
+        }
+
+    private:
+#if defined(ESCALATOR_SIMD_VECTORS)
+        template<size_t N>
+        static const char* findAny( const char* p, const char* end, const char* chars )
+        {
+#if defined(ESCALATOR_SIMD_AVX2)
+            if ( cpuHasAvx2() ) return simdFindAnyAvx2<N>( p, end, chars );
+#endif
+            return simdFindAny<16, N>( p, end, chars );
+        }
+#endif
+    };
+
+}}
+
+#endif
@@ -0,0 +1,164 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Approximate quantiles of a stream in fixed memory (a KLL sketch). Elements
+    // are kept in a stack of compactors, where each element at level h stands
+    // for 2^h inputs. When a level fills up it is sorted and every other element
+    // (from a random offset) moves up a level, with the rest discarded. Upper
+    // levels get the most space, so memory is about 3k elements plus a couple
+    // per level, whatever the input size.
+    //
+    // rankError is the error, as a fraction of the count, allowed in the rank of
+    // a returned quantile. It holds with high probability, and sets k. Sketches
+    // of the same rankError can be merged, e.g. from one per thread, without
+    // losing accuracy; give each a different seed, so that their compactions
+    // make independent choices.
+    template<typename T, typename CompareT>
+    class QuantileSketch
+    {
+    public:
+        explicit QuantileSketch( double rankError=0.01, CompareT cmp=CompareT(), uint64_t seed=0 ) :
+            m_k(0), m_count(0), m_size(0), m_capacity(0), m_random(mixSeed( seed )), m_cmp(cmp)
+        {
+            ESCALATOR_ASSERT( rankError > 0.0 && rankError < 1.0, "Rank error out of range: " << rankError );
+            m_k = std::max<size_t>( 8, static_cast<size_t>( std::ceil( 1.7 / rankError ) ) );
+            addLevel();
+        }
+
+        template<typename V>
+        void insert( V&& v )
+        {
+            m_levels[0].push_back( std::forward<V>(v) );
+            m_count++;
+            m_size++;
+            if ( m_size > m_capacity ) compress();
+        }
+
+        void merge( const QuantileSketch& other )
+        {
+            ESCALATOR_ASSERT( m_k == other.m_k, "Merging quantile sketches of different rank errors" );
+            while ( m_levels.size() < other.m_levels.size() ) addLevel();
+            for ( size_t h = 0; h < other.m_levels.size(); ++h )
+            {
+                m_levels[h].insert( m_levels[h].end(), other.m_levels[h].begin(), other.m_levels[h].end() );
+            }
+            m_count += other.m_count;
+            m_size += other.m_size;
+            while ( m_size > m_capacity ) compress();
+        }
+
+        // The number of elements inserted, and the number retained
+        size_t count() const { return m_count; }
+        size_t retained() const { return m_size; }
+
+        T quantile( double p ) const { return quantiles( std::vector<double>( 1, p ) )[0]; }
+
+        // The retained element at (approximately) each p-quantile, p in [0, 1]
+        std::vector<T> quantiles( const std::vector<double>& ps ) const
+        {
+            ESCALATOR_ASSERT( m_count > 0, "Quantiles over insufficient items" );
+
+            std::vector<std::pair<T, uint64_t>> weighted;
+            weighted.reserve( m_size );
+            for ( size_t h = 0; h < m_levels.size(); ++h )
+            {
+                for ( const T& v : m_levels[h] ) weighted.push_back( std::make_pair( v, uint64_t(1) << h ) );
+            }
+
+            CompareT cmp = m_cmp;
+            std::sort( weighted.begin(), weighted.end(),
+                [&cmp]( const std::pair<T, uint64_t>& a, const std::pair<T, uint64_t>& b ) { return cmp( a.first, b.first ); } );
+            for ( size_t i = 1; i < weighted.size(); ++i ) weighted[i].second += weighted[i - 1].second;
+
+            std::vector<T> res;
+            res.reserve( ps.size() );
+            for ( double p : ps )
+            {
+                ESCALATOR_ASSERT( p >= 0.0 && p <= 1.0, "Quantile out of range: " << p );
+
+                // The first element whose cumulative weight reaches rank p * ( count - 1 )
+                uint64_t rank = static_cast<uint64_t>( p * ( m_count - 1 ) ) + 1;
+                auto found = std::lower_bound( weighted.begin(), weighted.end(), rank,
+                    []( const std::pair<T, uint64_t>& w, uint64_t r ) { return w.second < r; } );
+                res.push_back( found == weighted.end() ? weighted.back().first : found->first );
+            }
+            return res;
+        }
+
+    private:
+        // Level h of H gets k * (2/3)^(H - 1 - h), and at least two
+        void addLevel()
+        {
+            m_levels.push_back( std::vector<T>() );
+
+            m_capacities.resize( m_levels.size() );
+            m_capacity = 0;
+            for ( size_t h = 0; h < m_levels.size(); ++h )
+            {
+                double depth = static_cast<double>( m_levels.size() - 1 - h );
+                m_capacities[h] = std::max<size_t>( 2, static_cast<size_t>( m_k * std::pow( 2.0 / 3.0, depth ) ) );
+                m_capacity += m_capacities[h];
+            }
+        }
+
+        // Compact the lowest full level
+        void compress()
+        {
+            for ( size_t h = 0; h < m_levels.size(); ++h )
+            {
+                if ( m_levels[h].size() < m_capacities[h] ) continue;
+
+                if ( h + 1 == m_levels.size() ) addLevel();
+
+                std::vector<T>& level = m_levels[h];
+                std::vector<T>& up = m_levels[h + 1];
+                std::sort( level.begin(), level.end(), m_cmp );
+
+                // With an odd count the smallest element stays behind
+                size_t keep = level.size() & 1;
+                size_t promoted = ( level.size() - keep ) / 2;
+                for ( size_t i = keep + randomBit(); i < level.size(); i += 2 ) up.push_back( std::move(level[i]) );
+                level.erase( level.begin() + keep, level.end() );
+
+                m_size -= promoted;
+                return;
+            }
+        }
+
+        // A splitmix64 step, so that nearby seeds (e.g. chunk indices) start
+        // unrelated sequences. xorshift must not start from zero.
+        static uint64_t mixSeed( uint64_t seed )
+        {
+            uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+            z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+            z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+            z ^= z >> 31;
+            return z != 0 ? z : 0x9e3779b97f4a7c15ull;
+        }
+
+        size_t randomBit()
+        {
+            // xorshift64
+            m_random ^= m_random << 13;
+            m_random ^= m_random >> 7;
+            m_random ^= m_random << 17;
+            return static_cast<size_t>( m_random >> 63 );
+        }
+
+        size_t                          m_k;
+        size_t                          m_count;
+        size_t                          m_size;
+        size_t                          m_capacity;
+        uint64_t                        m_random;
+        CompareT                        m_cmp;
+        std::vector<std::vector<T>>     m_levels;
+        std::vector<size_t>             m_capacities;
+    };
+
+}}
+
+#endif
@@ -0,0 +1,207 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Ranges at least this long are sorted in parallel, where there is more than one core
+    const size_t ParallelSortThreshold = 1 << 15;
+
+    // Chunks and merge pieces are not split below this size
+    const size_t ParallelSortGrain = 1 << 12;
+
+    // One independent part of merging two adjacent sorted runs
+    struct MergePiece
+    {
+        size_t a0, a1;
+        size_t b0, b1;
+        size_t out;
+    };
+
+    // Merge each pair of adjacent runs [bounds[k], bounds[k + width]) and
+    // [bounds[k + width], bounds[k + 2 * width]) from src into dst. Each merge
+    // is cut into independent pieces so the last rounds, with few long runs,
+    // still use every thread. Pieces are split on the longer run, resolving
+    // ties so that elements of the first run come first, which keeps the merge
+    // stable.
+    template<typename SrcIt, typename DstIt, typename CompareT>
+    void parallelMergeRound( SrcIt src, DstIt dst, const std::vector<size_t>& bounds, size_t width, size_t tasks,
+        CompareT& cmp, TaskScheduler& scheduler )
+    {
+        std::vector<MergePiece> pieces;
+        size_t runs = bounds.size() - 1;
+        size_t pairs = ( runs + 2 * width - 1 ) / ( 2 * width );
+        for ( size_t k = 0; k < runs; k += 2 * width )
+        {
+            size_t lo = bounds[k];
+            size_t mid = bounds[std::min( k + width, runs )];
+            size_t hi = bounds[std::min( k + 2 * width, runs )];
+
+            size_t split = std::max<size_t>( 1, std::min( tasks / pairs, ( hi - lo ) / ParallelSortGrain ) );
+            bool splitFirst = ( mid - lo ) >= ( hi - mid );
+
+            size_t prevA = lo, prevB = mid;
+            for ( size_t p = 1; p <= split; ++p )
+            {
+                size_t a = mid, b = hi;
+                if ( p < split && splitFirst )
+                {
+                    a = lo + ( mid - lo ) * p / split;
+                    b = std::lower_bound( src + mid, src + hi, src[a], cmp ) - src;
+                }
+                else if ( p < split )
+                {
+                    b = mid + ( hi - mid ) * p / split;
+                    a = std::upper_bound( src + lo, src + mid, src[b], cmp ) - src;
+                }
+
+                MergePiece piece = { prevA, a, prevB, b, lo + ( prevA - lo ) + ( prevB - mid ) };
+                pieces.push_back( piece );
+                prevA = a;
+                prevB = b;
+            }
+        }
+
+        auto mergePiece = [src, dst, &pieces, &cmp]( size_t i )
+        {
+            const MergePiece& piece = pieces[i];
+            CompareT c = cmp;
+            std::merge(
+                std::make_move_iterator( src + piece.a0 ), std::make_move_iterator( src + piece.a1 ),
+                std::make_move_iterator( src + piece.b0 ), std::make_move_iterator( src + piece.b1 ),
+                dst + piece.out, c );
+        };
+        parallelFor( pieces.size(), mergePiece, scheduler );
+    }
+
+    // Parallel merge sort: sort a power-of-two number of chunks independently,
+    // then merge them pairwise through a buffer allocated with (a rebinding
+    // of) alloc. Stable if stable is set, in which case the chunks are stable
+    // sorted.
+    template<typename RandomIt, typename CompareT, typename AllocT>
+    typename std::enable_if<IsAllocator<AllocT>::value>::type parallelSort( RandomIt begin, RandomIt end, CompareT cmp, bool stable,
+        const AllocT& alloc, TaskScheduler& scheduler=TaskScheduler::global() )
+    {
+        typedef typename std::iterator_traits<RandomIt>::value_type value_t;
+        typedef typename RebindAlloc<AllocT, value_t>::type buffer_alloc_t;
+
+        size_t size = end - begin;
+        size_t threads = scheduler.workerCount() + 1;
+
+        size_t chunks = 1;
+        while ( chunks < 2 * threads && size / ( chunks * 2 ) >= ParallelSortGrain ) chunks *= 2;
+
+        if ( chunks == 1 )
+        {
+            if ( stable ) std::stable_sort( begin, end, cmp );
+            else std::sort( begin, end, cmp );
+            return;
+        }
+
+        std::vector<size_t> bounds( chunks + 1 );
+        for ( size_t i = 0; i <= chunks; ++i ) bounds[i] = size * i / chunks;
+
+        auto sortChunk = [begin, &bounds, &cmp, stable]( size_t i )
+        {
+            CompareT c = cmp;
+            if ( stable ) std::stable_sort( begin + bounds[i], begin + bounds[i + 1], c );
+            else std::sort( begin + bounds[i], begin + bounds[i + 1], c );
+        };
+        parallelFor( chunks, sortChunk, scheduler );
+
+        // Alternate between the range and the buffer, one round per doubling of
+        // run length. The buffer starts as the sorted chunks moved out of the
+        // range, so elements are never default constructed (they may hold
+        // containers with allocators that cannot be).
+        std::vector<value_t, buffer_alloc_t> buffer( std::make_move_iterator( begin ), std::make_move_iterator( end ), buffer_alloc_t( alloc ) );
+        bool inBuffer = true;
+        for ( size_t width = 1; width < chunks; width *= 2 )
+        {
+            if ( inBuffer ) parallelMergeRound( buffer.begin(), begin, bounds, width, 4 * threads, cmp, scheduler );
+            else parallelMergeRound( begin, buffer.begin(), bounds, width, 4 * threads, cmp, scheduler );
+            inBuffer = !inBuffer;
+        }
+
+        if ( inBuffer )
+        {
+            auto moveBack = [begin, &buffer, &bounds]( size_t i )
+            {
+                std::move( buffer.begin() + bounds[i], buffer.begin() + bounds[i + 1], begin + bounds[i] );
+            };
+            parallelFor( chunks, moveBack, scheduler );
+        }
+    }
+
+    template<typename RandomIt, typename CompareT>
+    void parallelSort( RandomIt begin, RandomIt end, CompareT cmp, bool stable, TaskScheduler& scheduler=TaskScheduler::global() )
+    {
+        typedef typename std::iterator_traits<RandomIt>::value_type value_t;
+
+        parallelSort( begin, end, cmp, stable, std::allocator<value_t>(), scheduler );
+    }
+
+    template<typename RandomIt, typename CompareT, typename AllocT>
+    void sortRange( RandomIt begin, RandomIt end, CompareT cmp, bool stable, const AllocT& alloc, std::true_type )
+    {
+        if ( static_cast<size_t>( end - begin ) >= ParallelSortThreshold && std::thread::hardware_concurrency() > 1 )
+        {
+            parallelSort( begin, end, cmp, stable, alloc );
+        }
+        else if ( stable ) std::stable_sort( begin, end, cmp );
+        else std::sort( begin, end, cmp );
+    }
+
+    // Elements that can't be moved into a buffer are always sorted in place
+    template<typename RandomIt, typename CompareT, typename AllocT>
+    void sortRange( RandomIt begin, RandomIt end, CompareT cmp, bool stable, const AllocT&, std::false_type )
+    {
+        if ( stable ) std::stable_sort( begin, end, cmp );
+        else std::sort( begin, end, cmp );
+    }
+
+    // Large ranges are sorted in parallel, with their merge buffer allocated
+    // with (a rebinding of) alloc, usually the container's own allocator
+    template<typename RandomIt, typename CompareT, typename AllocT>
+    void sortRange( RandomIt begin, RandomIt end, CompareT cmp, bool stable, const AllocT& alloc )
+    {
+        typedef typename std::iterator_traits<RandomIt>::value_type value_t;
+
+        sortRange( begin, end, cmp, stable, alloc, std::integral_constant<bool,
+            std::is_move_constructible<value_t>::value && std::is_move_assignable<value_t>::value>() );
+    }
+
+    template<typename RandomIt, typename CompareT>
+    void sortRange( RandomIt begin, RandomIt end, CompareT cmp, bool stable )
+    {
+        typedef typename std::iterator_traits<RandomIt>::value_type value_t;
+
+        sortRange( begin, end, cmp, stable, std::allocator<value_t>() );
+    }
+
+    template<typename RandomIt, typename RankIt, typename CompareT>
+    void selectRanks( RandomIt first, RandomIt begin, RandomIt end, RankIt ranksBegin, RankIt ranksEnd, CompareT& cmp )
+    {
+        if ( ranksBegin == ranksEnd ) return;
+
+        RankIt mid = ranksBegin + ( ranksEnd - ranksBegin ) / 2;
+        RandomIt nth = first + *mid;
+        std::nth_element( begin, nth, end, cmp );
+
+        selectRanks( first, begin, nth, ranksBegin, mid, cmp );
+        selectRanks( first, nth + 1, end, mid + 1, ranksEnd, cmp );
+    }
+
+    // Reorder [begin, end) so that the element at each offset in [ranksBegin,
+    // ranksEnd), which must be sorted and distinct, is the one a full sort would
+    // put there. Selecting the middle rank first splits the range for the rest,
+    // so k ranks cost O(n log k) rather than a sort's O(n log n).
+    template<typename RandomIt, typename RankIt, typename CompareT>
+    void selectRanks( RandomIt begin, RandomIt end, RankIt ranksBegin, RankIt ranksEnd, CompareT cmp )
+    {
+        selectRanks( begin, begin, end, ranksBegin, ranksEnd, cmp );
+    }
+
+}}
+
+#endif
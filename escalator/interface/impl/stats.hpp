@@ -0,0 +1,115 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Descriptive statistics gathered in one pass. The mean and variance are
+    // updated incrementally (Welford), which stays accurate where summing
+    // squares would cancel, e.g. for small spreads around large values. Stats
+    // merge in order (Chan et al.), so those of consecutive chunks combine into
+    // those of the whole, indices included.
+    template<typename T>
+    class Stats
+    {
+    public:
+        Stats() : m_count(0), m_sum(), m_mean(0.0), m_m2(0.0)
+        {
+        }
+
+        void insert( const T& v )
+        {
+            if ( m_count == 0 ) m_sum = v;
+            else m_sum += v;
+
+            if ( !m_min || v < m_min->second ) m_min = std::make_pair( m_count, v );
+            if ( !m_max || m_max->second < v ) m_max = std::make_pair( m_count, v );
+
+            m_count++;
+            double x = static_cast<double>( v );
+            double delta = x - m_mean;
+            m_mean += delta / static_cast<double>( m_count );
+            m_m2 += delta * ( x - m_mean );
+        }
+
+        // Combine with the stats of elements following these
+        void merge( const Stats& other )
+        {
+            if ( other.m_count == 0 ) return;
+            if ( m_count == 0 )
+            {
+                *this = other;
+                return;
+            }
+
+            m_sum += other.m_sum;
+            if ( other.m_min->second < m_min->second ) m_min = std::make_pair( m_count + other.m_min->first, other.m_min->second );
+            if ( m_max->second < other.m_max->second ) m_max = std::make_pair( m_count + other.m_max->first, other.m_max->second );
+
+            double n1 = static_cast<double>( m_count );
+            double n2 = static_cast<double>( other.m_count );
+            double delta = other.m_mean - m_mean;
+            m_mean += delta * n2 / ( n1 + n2 );
+            m_m2 += other.m_m2 + delta * delta * n1 * n2 / ( n1 + n2 );
+            m_count += other.m_count;
+        }
+
+        size_t count() const { return m_count; }
+
+        T sum() const
+        {
+            ESCALATOR_ASSERT( m_count > 0, "Sum over insufficient items" );
+            return m_sum;
+        }
+
+        double mean() const
+        {
+            ESCALATOR_ASSERT( m_count > 0, "Mean over insufficient items" );
+            return m_mean;
+        }
+
+        // Population variance, and the unbiased sample variance
+        double variance() const
+        {
+            ESCALATOR_ASSERT( m_count > 0, "Variance over insufficient items" );
+            return m_m2 / static_cast<double>( m_count );
+        }
+
+        double sampleVariance() const
+        {
+            ESCALATOR_ASSERT( m_count > 1, "Sample variance over insufficient items" );
+            return m_m2 / static_cast<double>( m_count - 1 );
+        }
+
+        double stddev() const { return std::sqrt( variance() ); }
+        double sampleStddev() const { return std::sqrt( sampleVariance() ); }
+
+        // As for the terminals of the same name, the first extremal element wins
+        std::pair<size_t, T> argMin() const
+        {
+            ESCALATOR_ASSERT( m_count > 0, "Min over insufficient items" );
+            return *m_min;
+        }
+
+        std::pair<size_t, T> argMax() const
+        {
+            ESCALATOR_ASSERT( m_count > 0, "Max over insufficient items" );
+            return *m_max;
+        }
+
+        T min() const { return argMin().second; }
+        T max() const { return argMax().second; }
+
+    private:
+        size_t                                  m_count;
+        T                                       m_sum;
+        double                                  m_mean;
+        double                                  m_m2;
+        boost::optional<std::pair<size_t, T>>   m_min;
+        boost::optional<std::pair<size_t, T>>   m_max;
+    };
+
+}}
+
+#endif
@@ -0,0 +1,217 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // Element formatters append the text of one value to a string, as it would
+    // be written by operator<< to a stream in the classic locale. Integers,
+    // floating point numbers, characters and strings are formatted directly;
+    // anything else goes through operator<< (see StringBuilder).
+    template<typename T, typename Enable=void>
+    struct ElementFormatter;
+
+    // Digits two at a time, from a table of the pairs 00 to 99
+    inline char* formatDecimal( uint64_t value, char* end )
+    {
+        static const char pairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        char* p = end;
+        while ( value >= 100 )
+        {
+            const char* pair = pairs + ( value % 100 ) * 2;
+            value /= 100;
+            *--p = pair[1];
+            *--p = pair[0];
+        }
+        if ( value >= 10 )
+        {
+            const char* pair = pairs + value * 2;
+            *--p = pair[1];
+            *--p = pair[0];
+        }
+        else
+        {
+            *--p = static_cast<char>( '0' + value );
+        }
+        return p;
+    }
+
+    template<typename T>
+    struct IsCharacter : public std::integral_constant<bool,
+        std::is_same<T, char>::value || std::is_same<T, signed char>::value || std::is_same<T, unsigned char>::value>
+    {
+    };
+
+    template<typename T>
+    bool isNegative( T value, std::true_type ) { return value < 0; }
+
+    template<typename T>
+    bool isNegative( T, std::false_type ) { return false; }
+
+    template<typename T>
+    struct ElementFormatter<T, typename std::enable_if<std::is_integral<T>::value && !IsCharacter<T>::value && !std::is_same<T, bool>::value>::type>
+    {
+        static void append( std::string& out, T value )
+        {
+            typedef typename std::make_unsigned<T>::type unsigned_t;
+
+            char buffer[24];
+            char* end = buffer + sizeof(buffer);
+            bool negative = isNegative( value, typename std::is_signed<T>::type() );
+            // Negated as unsigned, so that the minimum value does not overflow
+            unsigned_t magnitude = negative ? static_cast<unsigned_t>( unsigned_t(0) - static_cast<unsigned_t>( value ) ) : static_cast<unsigned_t>( value );
+            char* p = formatDecimal( magnitude, end );
+            if ( negative ) *--p = '-';
+            out.append( p, end );
+        }
+    };
+
+    template<typename T>
+    struct ElementFormatter<T, typename std::enable_if<IsCharacter<T>::value>::type>
+    {
+        static void append( std::string& out, T value )
+        {
+            out.push_back( static_cast<char>( value ) );
+        }
+    };
+
+    template<>
+    struct ElementFormatter<bool>
+    {
+        static void append( std::string& out, bool value ) { out.push_back( value ? '1' : '0' ); }
+    };
+
+    // %g with the stream's default precision of 6, which is how operator<<
+    // formats, with the C locale's decimal point swapped back for '.'
+    template<typename T>
+    struct ElementFormatter<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+        static void append( std::string& out, T value )
+        {
+            char buffer[64];
+            int size = std::is_same<T, long double>::value ?
+                std::snprintf( buffer, sizeof(buffer), "%Lg", static_cast<long double>( value ) ) :
+                std::snprintf( buffer, sizeof(buffer), "%g", static_cast<double>( value ) );
+            size = std::min<int>( size, sizeof(buffer) - 1 );
+
+            char point = *std::localeconv()->decimal_point;
+            if ( point != '.' ) std::replace( buffer, buffer + size, point, '.' );
+            out.append( buffer, size );
+        }
+    };
+
+    template<>
+    struct ElementFormatter<std::string>
+    {
+        static void append( std::string& out, const std::string& value ) { out.append( value ); }
+    };
+
+    template<>
+    struct ElementFormatter<StringView>
+    {
+        static void append( std::string& out, const StringView& value ) { out.append( value.data(), value.size() ); }
+    };
+
+    template<>
+    struct ElementFormatter<const char*>
+    {
+        static void append( std::string& out, const char* value ) { out.append( value ); }
+    };
+
+    template<>
+    struct ElementFormatter<char*> : public ElementFormatter<const char*>
+    {
+    };
+
+    template<typename T>
+    struct HasElementFormatter
+    {
+        template<typename U> static std::true_type check( decltype( &ElementFormatter<U>::append ) );
+        template<typename U> static std::false_type check( ... );
+
+        static const bool value = decltype( check<T>( nullptr ) )::value;
+    };
+
+    // A streambuf appending straight to a string, so that user types written
+    // with operator<< are not copied through a stringstream's own buffer
+    class StringAppendBuf : public std::streambuf
+    {
+    public:
+        explicit StringAppendBuf( std::string& out ) : m_out(out)
+        {
+        }
+
+    protected:
+        int_type overflow( int_type c )
+        {
+            if ( !traits_type::eq_int_type( c, traits_type::eof() ) ) m_out.push_back( traits_type::to_char_type( c ) );
+            return traits_type::not_eof( c );
+        }
+
+        std::streamsize xsputn( const char* s, std::streamsize n )
+        {
+            m_out.append( s, static_cast<size_t>( n ) );
+            return n;
+        }
+
+    private:
+        std::string&    m_out;
+    };
+
+    // Appends formatted values to a string. The stream used for types without
+    // an ElementFormatter is only constructed when one is first appended.
+    class StringBuilder
+    {
+    public:
+        explicit StringBuilder( std::string& out ) : m_out(out)
+        {
+        }
+
+        template<typename T>
+        StringBuilder& append( const T& value )
+        {
+            appendImpl( value, std::integral_constant<bool, HasElementFormatter<T>::value>() );
+            return *this;
+        }
+
+        StringBuilder& append( const char* value )
+        {
+            m_out.append( value );
+            return *this;
+        }
+
+        void reserve( size_t size ) { if ( size > m_out.capacity() ) m_out.reserve( size ); }
+
+        std::string& str() { return m_out; }
+
+    private:
+        template<typename T>
+        void appendImpl( const T& value, std::true_type )
+        {
+            ElementFormatter<T>::append( m_out, value );
+        }
+
+        template<typename T>
+        void appendImpl( const T& value, std::false_type )
+        {
+            if ( !m_stream )
+            {
+                m_buf.reset( new StringAppendBuf( m_out ) );
+                m_stream.reset( new std::ostream( m_buf.get() ) );
+            }
+            *m_stream << value;
+        }
+
+        std::string&                        m_out;
+        std::unique_ptr<StringAppendBuf>    m_buf;
+        std::unique_ptr<std::ostream>       m_stream;
+    };
+
+}}
+
+#endif
@@ -0,0 +1,128 @@
+#if !defined(ESCALATOR_INTERNAL)
+#   error "This file is an escalator implementation file. Please do not include directly."
+#else
+
+
+namespace navetas { namespace escalator {
+
+    // A non-owning view of a run of characters, e.g. a line of a mapped file.
+    // It is only valid while whatever owns the characters is alive; str() takes
+    // a copy that outlives it. Converts implicitly to std::string, so functions
+    // taking strings can be applied to views directly (at the cost of the copy).
+    class StringView
+    {
+    public:
+        typedef char value_type;
+        typedef const char* iterator;
+        typedef const char* const_iterator;
+        static const size_t npos = static_cast<size_t>( -1 );
+
+        StringView() : m_data(nullptr), m_size(0) {}
+        StringView( const char* data, size_t size ) : m_data(data), m_size(size) {}
+        StringView( const char* data ) : m_data(data), m_size(std::strlen( data )) {}
+        StringView( const std::string& s ) : m_data(s.data()), m_size(s.size()) {}
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        size_t length() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+
+        const char* begin() const { return m_data; }
+        const char* end() const { return m_data + m_size; }
+        char operator[]( size_t i ) const { return m_data[i]; }
+
+        StringView substr( size_t pos, size_t count=npos ) const
+        {
+            ESCALATOR_ASSERT( pos <= m_size, "Substring out of range: " << pos );
+            return StringView( m_data + pos, std::min( count, m_size - pos ) );
+        }
+
+        size_t find( char c, size_t pos=0 ) const
+        {
+            if ( pos >= m_size ) return npos;
+            const void* found = std::memchr( m_data + pos, c, m_size - pos );
+            return found ? static_cast<const char*>( found ) - m_data : npos;
+        }
+
+        // The first occurrence of needle at or after pos
+        size_t find( const StringView& needle, size_t pos=0 ) const
+        {
+            if ( pos > m_size ) return npos;
+            if ( needle.empty() ) return pos;
+            const char* found = StringKernels::search( m_data + pos, end(), needle.data(), needle.size() );
+            return found == end() ? npos : found - m_data;
+        }
+
+        size_t find_first_of( const StringView& chars, size_t pos=0 ) const
+        {
+            if ( pos >= m_size ) return npos;
+            const char* found = StringKernels::findAny( m_data + pos, end(), CharSet( chars.data(), chars.size() ) );
+            return found == end() ? npos : found - m_data;
+        }
+
+        bool contains( const StringView& needle ) const { return find( needle ) != npos; }
+
+        std::string str() const { return std::string( m_data, m_size ); }
+        operator std::string() const { return str(); }
+
+        int compare( const StringView& other ) const
+        {
+            int c = m_size == 0 || other.m_size == 0 ? 0 : std::memcmp( m_data, other.m_data, std::min( m_size, other.m_size ) );
+            if ( c != 0 ) return c;
+            return m_size < other.m_size ? -1 : ( m_size > other.m_size ? 1 : 0 );
+        }
+
+    private:
+        const char* m_data;
+        size_t      m_size;
+    };
+
+    inline bool operator==( const StringView& l, const StringView& r ) { return l.size() == r.size() && l.compare( r ) == 0; }
+    inline bool operator!=( const StringView& l, const StringView& r ) { return !( l == r ); }
+    inline bool operator<( const StringView& l, const StringView& r ) { return l.compare( r ) < 0; }
+    inline bool operator>( const StringView& l, const StringView& r ) { return r < l; }
+
+    inline std::ostream& operator<<( std::ostream& os, const StringView& v )
+    {
+        return os.write( v.data(), v.size() );
+    }
+
+    template<>
+    struct IsHashable<StringView> : public std::true_type
+    {
+    };
+
+    // FNV-1a, as std::hash has no overload for bare character ranges
+    template<>
+    struct ElementHash<StringView>
+    {
+        size_t operator()( const StringView& v ) const
+        {
+            uint64_t h = 0xcbf29ce484222325ull;
+            for ( char c : v )
+            {
+                h ^= static_cast<unsigned char>( c );
+                h *= 0x100000001b3ull;
+            }
+            return static_cast<size_t>( h );
+        }
+    };
+
+    // Strings hash as views of their text, so that string-keyed hash tables
+    // can be probed with views without copying them
+    template<>
+    struct ElementHash<std::string> : public ElementHash<StringView>
+    {
+    };
+
+    // A view's text is only valid while its source is, which for lines and
+    // records read from a file may be no longer than a single step
+    template<>
+    struct RetainedElement<StringView>
+    {
+        typedef std::string type;
+    };
+
+}}
+
+#endif
@@ -63,6 +63,81 @@ namespace navetas { namespace escalator {
         typedef decltype(std::declval<FunctorT>()( std::declval<InputT>() )) out_t;
     };
     
+    // Holds a user functor by its concrete type so calls through it can be inlined.
+    // Stateless functors (e.g. captureless lambdas) are held as a base class and so
+    // take up no space. Lambdas are copyable but not assignable, so holders of
+    // non-assignable functors re-construct them on assignment instead.
+    template<typename FunctorT,
+        bool IsEmpty=std::is_empty<FunctorT>::value,
+        bool IsAssignable=std::is_copy_assignable<FunctorT>::value>
+    class FunctorHolder
+    {
+    public:
+        FunctorHolder( const FunctorT& fn ) : m_fn( fn ) {}
+        
+        // From the functor rather than the optional, which is always set, so
+        // that the compiler does not see a path copying it uninitialised
+        FunctorHolder( const FunctorHolder& other ) : m_fn( other.functor() ) {}
+        
+        FunctorHolder& operator=( const FunctorHolder& other )
+        {
+            if ( this != &other )
+            {
+                m_fn = boost::none;
+                m_fn = boost::in_place( other.functor() );
+            }
+            return *this;
+        }
+        
+        FunctorT& functor() { return *m_fn; }
+        const FunctorT& functor() const { return *m_fn; }
+        
+    private:
+        boost::optional<FunctorT> m_fn;
+    };
+    
+    template<typename FunctorT>
+    class FunctorHolder<FunctorT, false, true>
+    {
+    public:
+        FunctorHolder( const FunctorT& fn ) : m_fn( fn ) {}
+        
+        FunctorT& functor() { return m_fn; }
+        const FunctorT& functor() const { return m_fn; }
+        
+    private:
+        FunctorT m_fn;
+    };
+    
+    template<typename FunctorT, bool IsAssignable>
+    class FunctorHolder<FunctorT, true, IsAssignable> : private FunctorT
+    {
+    public:
+        FunctorHolder( const FunctorT& fn ) : FunctorT( fn ) {}
+        
+        FunctorHolder( const FunctorHolder& other ) : FunctorT( other.functor() ) {}
+        
+        // No state, so nothing to assign
+        FunctorHolder& operator=( const FunctorHolder& ) { return *this; }
+        
+        FunctorT& functor() { return *this; }
+        const FunctorT& functor() const { return *this; }
+    };
+    
+    // Iterators known to address contiguous storage
+    template<typename IterT>
+    struct IsContiguousIterator
+    {
+        typedef typename std::iterator_traits<IterT>::value_type value_t;
+        
+        static const bool value = std::is_pointer<IterT>::value ||
+            std::is_same<IterT, std::string::iterator>::value ||
+            std::is_same<IterT, std::string::const_iterator>::value ||
+            ( !std::is_same<value_t, bool>::value &&
+                ( std::is_same<IterT, typename std::vector<value_t>::iterator>::value ||
+                  std::is_same<IterT, typename std::vector<value_t>::const_iterator>::value ) );
+    };
+    
     template<typename T>
     class IdentityFunctor
     {
@@ -129,6 +204,29 @@ namespace navetas { namespace escalator {
         type operator()( T& v ) { return v; }
     };
     
+    // An empty optional, to start a search or accumulation from. Copying a
+    // boost::optional of a trivially copyable type copies its storage whether
+    // or not it is set, which g++ reports as maybe-uninitialized, so for those
+    // types the storage is value initialised as well.
+    template<typename T>
+    boost::optional<T> emptyOptional( std::true_type )
+    {
+        return boost::optional<T>( false, T() );
+    }
+    
+    template<typename T>
+    boost::optional<T> emptyOptional( std::false_type )
+    {
+        return boost::none;
+    }
+    
+    template<typename T>
+    boost::optional<T> emptyOptional()
+    {
+        return emptyOptional<T>( std::integral_constant<bool,
+            std::is_trivially_copyable<T>::value && std::is_default_constructible<T>::value>() );
+    }
+    
     class EmptyError : public std::range_error
     {
     public:
@@ -136,6 +234,25 @@ namespace navetas { namespace escalator {
         EmptyError( const char* what_arg ) : std::range_error( what_arg ) {}
     };
     
+    // Whether sortBy computes each key once up front, or on every comparison.
+    // By default keys are cached unless they look cheap: the key function
+    // returns a reference (a projection of the element), or maps a scalar to a
+    // scalar.
+    enum KeyCaching
+    {
+        AUTO_KEY_CACHING,
+        CACHE_KEYS,
+        RECOMPUTE_KEYS
+    };
+    
+    // Key order of groupBy/countBy results that are built with a hash table:
+    // sorted by key, or in the order each key was first seen
+    enum KeyOrder
+    {
+        SORTED_KEYS,
+        UNSORTED_KEYS
+    };
+    
     enum SliceBehavior
     {
         RETURN_UPTO,
@@ -148,6 +265,133 @@ namespace navetas { namespace escalator {
         SliceError( const char* what_arg ) : std::range_error( what_arg ) {}
     };
     
+    // Input text that does not match what was expected of it
+    class ParseError : public std::runtime_error
+    {
+    public:
+        ParseError( const std::string& what_arg ) : std::runtime_error( what_arg ) {}
+        ParseError( const char* what_arg ) : std::runtime_error( what_arg ) {}
+    };
+    
+    // How many elements an Iterator has left to hand out: either exactly, as an
+    // upper bound, or unknown
+    class SizeHint
+    {
+    public:
+        static SizeHint exact( size_t size ) { return SizeHint( size, true ); }
+        static SizeHint upperBound( size_t size ) { return SizeHint( size, false ); }
+        static SizeHint unknown() { return SizeHint( std::numeric_limits<size_t>::max(), false ); }
+        
+        bool isExact() const { return m_exact; }
+        bool isBounded() const { return m_exact || m_size != std::numeric_limits<size_t>::max(); }
+        size_t size() const { return m_size; }
+        
+        SizeHint asUpperBound() const { return SizeHint( m_size, false ); }
+        
+        SizeHint atMost( size_t limit ) const
+        {
+            return SizeHint( std::min( m_size, limit ), m_exact );
+        }
+        
+        SizeHint plus( size_t extra ) const
+        {
+            if ( !isBounded() ) return *this;
+            size_t size = m_size + extra;
+            return size < m_size ? unknown() : SizeHint( size, m_exact );
+        }
+        
+        // For sequences consumed in lock-step, e.g. by zip
+        static SizeHint min( const SizeHint& a, const SizeHint& b )
+        {
+            return SizeHint( std::min( a.m_size, b.m_size ), a.m_exact && b.m_exact );
+        }
+        
+    private:
+        SizeHint( size_t size, bool exact ) : m_size( size ), m_exact( exact ) {}
+        
+        size_t  m_size;
+        bool    m_exact;
+    };
+    
+    template<typename IteratorT>
+    auto sizeHintOfImpl( IteratorT& it, int ) -> decltype( it.sizeHint() )
+    {
+        return it.sizeHint();
+    }
+    
+    template<typename IteratorT>
+    SizeHint sizeHintOfImpl( IteratorT&, ... )
+    {
+        return SizeHint::unknown();
+    }
+    
+    // Iterators may optionally implement SizeHint sizeHint()
+    template<typename IteratorT>
+    SizeHint sizeHintOf( IteratorT&& it )
+    {
+        return sizeHintOfImpl( it, 0 );
+    }
+    
+    template<typename ContainerT>
+    auto reserveFromHintImpl( ContainerT& c, const SizeHint& hint, int ) -> decltype( c.reserve( hint.size() ), void() )
+    {
+        if ( hint.isExact() ) c.reserve( c.size() + hint.size() );
+    }
+    
+    template<typename ContainerT>
+    void reserveFromHintImpl( ContainerT&, const SizeHint&, ... )
+    {
+    }
+    
+    // Reserve space for elements still to be inserted where the container supports
+    // it. Upper bounds (e.g. from a filter) are ignored as they can be arbitrarily loose.
+    template<typename ContainerT>
+    void reserveFromHint( ContainerT& c, const SizeHint& hint )
+    {
+        reserveFromHintImpl( c, hint, 0 );
+    }
+    
+    // The type elements are kept as once collected into a container (by lower,
+    // retain, sorts, groupBy, distinct and the like). Non-owning elements whose
+    // referent may not outlive the source, such as StringView, specialise this
+    // to an owning type they convert to.
+    template<typename T>
+    struct RetainedElement
+    {
+        typedef T type;
+    };
+    
+    template<typename T1, typename T2>
+    struct RetainedElement<std::pair<T1, T2>>
+    {
+        typedef std::pair<typename RetainedElement<T1>::type, typename RetainedElement<T2>::type> type;
+    };
+    
+    template<typename... Ts>
+    struct RetainedElement<std::tuple<Ts...>>
+    {
+        typedef std::tuple<typename RetainedElement<Ts>::type...> type;
+    };
+
+    // An element as its retained type: converted when that differs, and
+    // otherwise passed through without a copy
+    template<typename T>
+    struct IsRetained : public std::is_same<typename RetainedElement<typename std::decay<T>::type>::type, typename std::decay<T>::type>
+    {
+    };
+
+    template<typename T>
+    typename std::enable_if<IsRetained<T>::value, T&&>::type retainElement( T&& v )
+    {
+        return std::forward<T>(v);
+    }
+
+    template<typename T>
+    typename std::enable_if<!IsRetained<T>::value, typename RetainedElement<typename std::decay<T>::type>::type>::type retainElement( T&& v )
+    {
+        return typename RetainedElement<typename std::decay<T>::type>::type( std::forward<T>(v) );
+    }
+    
     template<typename ElT, template<typename, typename ...> class Container>
     struct MakeContainerType
     {
@@ -166,6 +410,87 @@ namespace navetas { namespace escalator {
         typedef std::multimap<El1T, El2T> type;
     };
     
+    // Whether T looks like a standard allocator. The allocator-taking overloads
+    // of operations are only viable for allocators, so they do not compete with
+    // those taking an option (e.g. a KeyOrder) in the same position.
+    template<typename T>
+    struct IsAllocator
+    {
+        template<typename U> static std::true_type check( typename U::value_type*, decltype( std::declval<U&>().allocate( 1 ) )* );
+        template<typename U> static std::false_type check( ... );
+        
+        static const bool value = decltype( check<T>( nullptr, nullptr ) )::value;
+    };
+    
+    template<typename AllocT, typename T, typename Enable=void>
+    struct RebindAlloc
+    {
+    };
+    
+    template<typename AllocT, typename T>
+    struct RebindAlloc<AllocT, T, typename std::enable_if<IsAllocator<AllocT>::value>::type>
+    {
+        typedef typename std::allocator_traits<AllocT>::template rebind_alloc<T> type;
+    };
+    
+    template<typename T, typename AllocT, typename Enable=void>
+    struct AllocVector
+    {
+    };
+    
+    template<typename T, typename AllocT>
+    struct AllocVector<T, AllocT, typename std::enable_if<IsAllocator<AllocT>::value>::type>
+    {
+        typedef std::vector<T, typename RebindAlloc<AllocT, T>::type> type;
+    };
+    
+    // As MakeContainerType, for containers allocating with (a rebinding of)
+    // AllocT. make() is an empty container using alloc.
+    template<typename ElT, template<typename, typename ...> class Container, typename AllocT>
+    struct MakeAllocContainerType
+    {
+        typedef Container<ElT, typename RebindAlloc<AllocT, ElT>::type> type;
+        
+        static type make( const AllocT& alloc ) { return type( typename RebindAlloc<AllocT, ElT>::type( alloc ) ); }
+    };
+    
+    template<typename ElT, template<typename, typename ...> class Container, typename AllocT>
+    struct MakeAllocSetType
+    {
+        typedef Container<ElT, std::less<ElT>, typename RebindAlloc<AllocT, ElT>::type> type;
+        
+        static type make( const AllocT& alloc ) { return type( std::less<ElT>(), typename RebindAlloc<AllocT, ElT>::type( alloc ) ); }
+    };
+    
+    template<typename ElT, typename AllocT>
+    struct MakeAllocContainerType<ElT, std::set, AllocT> : public MakeAllocSetType<ElT, std::set, AllocT>
+    {
+    };
+    
+    template<typename ElT, typename AllocT>
+    struct MakeAllocContainerType<ElT, std::multiset, AllocT> : public MakeAllocSetType<ElT, std::multiset, AllocT>
+    {
+    };
+    
+    template<typename El1T, typename El2T, template<typename, typename ...> class Container, typename AllocT>
+    struct MakeAllocMapType
+    {
+        typedef typename RebindAlloc<AllocT, std::pair<const El1T, El2T>>::type alloc_t;
+        typedef Container<El1T, El2T, std::less<El1T>, alloc_t> type;
+        
+        static type make( const AllocT& alloc ) { return type( std::less<El1T>(), alloc_t( alloc ) ); }
+    };
+    
+    template<typename El1T, typename El2T, typename AllocT>
+    struct MakeAllocContainerType<std::pair<El1T, El2T>, std::map, AllocT> : public MakeAllocMapType<El1T, El2T, std::map, AllocT>
+    {
+    };
+    
+    template<typename El1T, typename El2T, typename AllocT>
+    struct MakeAllocContainerType<std::pair<El1T, El2T>, std::multimap, AllocT> : public MakeAllocMapType<El1T, El2T, std::multimap, AllocT>
+    {
+    };
+    
 }}
 
 #endif
@@ -0,0 +1,704 @@
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/find.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "escalator.hpp"
+
+using namespace boost::unit_test;
+
+using namespace navetas::escalator;
+
+// Benchmarks are registered alongside the unit tests. By default they run over
+// small inputs and only check that the variants being compared agree. Set
+// ESCALATOR_BENCH_SCALE (e.g. to 100) to run them at a useful size and print
+// timings.
+
+namespace
+{
+    size_t benchScale()
+    {
+        const char* scale = std::getenv( "ESCALATOR_BENCH_SCALE" );
+        return scale ? std::max( std::atoi( scale ), 1 ) : 1;
+    }
+    
+    template<typename FnT>
+    auto timed( const std::string& name, FnT fn ) -> decltype( fn() )
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto res = fn();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        
+        if ( std::getenv( "ESCALATOR_BENCH_SCALE" ) )
+        {
+            std::cout << "  " << name << ": " << elapsed.count() << "ms" << std::endl;
+        }
+        return res;
+    }
+}
+
+// A map/map/sum chain should compile down to the same loop as the handwritten version
+void benchMapChain()
+{
+    std::vector<int64_t> v( 1000000 * benchScale() );
+    for ( size_t i = 0; i < v.size(); ++i ) v[i] = i % 1000;
+    
+    auto f = []( int64_t x ) { return x * 3; };
+    auto g = []( int64_t x ) { return x + 1; };
+    
+    int64_t handwritten = timed( "map chain (handwritten)", [&]()
+    {
+        int64_t acc = 0;
+        for ( int64_t x : v ) acc += g( f( x ) );
+        return acc;
+    } );
+    
+    int64_t lifted = timed( "map chain (lift)", [&]() { return lift(v).map( f ).map( g ).sum(); } );
+    
+    BOOST_CHECK_EQUAL( handwritten, lifted );
+}
+
+// Zips can't push, so are driven a block at a time
+void benchZipChain()
+{
+    std::vector<double> a( 1000000 * benchScale() );
+    std::vector<double> b( a.size() );
+    for ( size_t i = 0; i < a.size(); ++i )
+    {
+        a[i] = static_cast<double>( i % 100 );
+        b[i] = static_cast<double>( i % 7 );
+    }
+    
+    double handwritten = timed( "zip dot product (handwritten)", [&]()
+    {
+        double acc = 0.0;
+        for ( size_t i = 0; i < a.size(); ++i ) acc += a[i] * b[i];
+        return acc;
+    } );
+    
+    double pulled = timed( "zip dot product (pull)", [&]()
+    {
+        double acc = 0.0;
+        auto it = lift(a).zip( lift(b) );
+        while ( it.hasNext() )
+        {
+            auto p = it.next();
+            acc += p.first * p.second;
+        }
+        return acc;
+    } );
+    
+    double lifted = timed( "zip dot product (lift)", [&]()
+    {
+        return lift(a).zip( lift(b) ).fold( 0.0, []( double acc, const std::pair<double, double>& p ) { return acc + p.first * p.second; } );
+    } );
+    
+    BOOST_CHECK_EQUAL( handwritten, pulled );
+    BOOST_CHECK_EQUAL( handwritten, lifted );
+}
+
+// Per-task overhead of the scheduler: many empty tasks through one group, and
+// many small parallelFor calls
+void benchSchedulerSpawnJoin()
+{
+    size_t tasks = 10000 * benchScale();
+    
+    size_t spawned = timed( "scheduler spawn/join (empty tasks)", [&]()
+    {
+        std::atomic<size_t> ran( 0 );
+        TaskGroup group;
+        for ( size_t i = 0; i < tasks; ++i ) group.run( [&ran]() { ran++; } );
+        group.wait();
+        return ran.load();
+    } );
+    
+    size_t forked = timed( "scheduler parallelFor (8-way, repeated)", [&]()
+    {
+        std::atomic<size_t> ran( 0 );
+        auto body = [&ran]( size_t ) { ran++; };
+        for ( size_t i = 0; i < tasks / 8; ++i ) parallelFor( 8, body );
+        return ran.load();
+    } );
+    
+    BOOST_CHECK_EQUAL( spawned, tasks );
+    BOOST_CHECK_EQUAL( forked, ( tasks / 8 ) * 8 );
+}
+
+// A filter whose cost is concentrated in one part of the range. With one fixed
+// chunk per thread the thread that gets the expensive part dominates; stealing
+// spreads it out.
+void benchSchedulerSkewed()
+{
+    std::vector<int> v( 200000 * benchScale() );
+    for ( size_t i = 0; i < v.size(); ++i ) v[i] = static_cast<int>( i );
+    
+    size_t expensiveEnd = v.size() / 8;
+    auto pred = [expensiveEnd]( int x )
+    {
+        uint32_t h = static_cast<uint32_t>( x );
+        size_t rounds = static_cast<size_t>( x ) < expensiveEnd ? 200 : 1;
+        for ( size_t r = 0; r < rounds; ++r ) h = h * 2654435761u + 0x9e3779b9u;
+        return ( h & 3 ) == 0;
+    };
+    
+    size_t threads = TaskScheduler::global().workerCount() + 1;
+    
+    size_t sequential = timed( "skewed filter (sequential)", [&]() { return lift(v).filter( pred ).count(); } );
+    
+    size_t fixedSplit = timed( "skewed filter (one chunk per thread)", [&]()
+    {
+        std::vector<size_t> counts( threads );
+        std::vector<std::thread> workers;
+        for ( size_t t = 0; t < threads; ++t )
+        {
+            workers.push_back( std::thread( [&, t]()
+            {
+                counts[t] = lift( v.begin() + v.size() * t / threads, v.begin() + v.size() * (t + 1) / threads ).filter( pred ).count();
+            } ) );
+        }
+        for ( auto& w : workers ) w.join();
+        return lift(counts).sum();
+    } );
+    
+    size_t stolen = timed( "skewed filter (par)", [&]() { return lift(v).par( threads ).filter( pred ).count(); } );
+    
+    BOOST_CHECK_EQUAL( sequential, fixedSplit );
+    BOOST_CHECK_EQUAL( sequential, stolen );
+}
+
+// Large sorts go through the parallel merge sort
+void benchSort()
+{
+    std::vector<int64_t> v( 200000 * benchScale() );
+    uint64_t h = 1;
+    for ( auto& x : v ) x = static_cast<int64_t>( ( h = h * 6364136223846793005ull + 1442695040888963407ull ) >> 16 );
+    
+    std::vector<int64_t> expected = timed( "sort (std::sort)", [&]()
+    {
+        std::vector<int64_t> copy = v;
+        std::sort( copy.begin(), copy.end() );
+        return copy;
+    } );
+    
+    std::vector<int64_t> parallel = timed( "sort (parallelSort)", [&]()
+    {
+        std::vector<int64_t> copy = v;
+        parallelSort( copy.begin(), copy.end(), std::less<int64_t>(), false );
+        return copy;
+    } );
+    
+    std::vector<int64_t> stable = timed( "sort (parallelSort, stable)", [&]()
+    {
+        std::vector<int64_t> copy = v;
+        parallelSort( copy.begin(), copy.end(), std::less<int64_t>(), true );
+        return copy;
+    } );
+    
+    std::vector<int64_t> lifted = timed( "sort (lift)", [&]() { return lift(v).sort().lower<std::vector>(); } );
+    
+    BOOST_CHECK( parallel == expected );
+    BOOST_CHECK( stable == expected );
+    BOOST_CHECK( lifted == expected );
+}
+
+// sortBy with a key that is costly to build (formatted strings) and with a
+// trivial one, computing keys once up front vs on every comparison
+void benchSortBy()
+{
+    std::vector<int> v( 50000 * benchScale() );
+    uint32_t h = 1;
+    for ( auto& x : v ) x = static_cast<int>( ( h = h * 1103515245u + 12345u ) >> 8 );
+    
+    auto expensive = []( int x ) { return std::to_string( x ); };
+    auto trivial = []( int x ) { return x; };
+    
+    std::vector<int> cached = timed( "sortBy expensive key (cached)", [&]() { return lift(v).sortBy( expensive, CACHE_KEYS ).lower<std::vector>(); } );
+    std::vector<int> recomputed = timed( "sortBy expensive key (recomputed)", [&]() { return lift(v).sortBy( expensive, RECOMPUTE_KEYS ).lower<std::vector>(); } );
+    
+    std::vector<int> trivialCached = timed( "sortBy trivial key (cached)", [&]() { return lift(v).sortBy( trivial, CACHE_KEYS ).lower<std::vector>(); } );
+    std::vector<int> trivialRecomputed = timed( "sortBy trivial key (recomputed)", [&]() { return lift(v).sortBy( trivial, RECOMPUTE_KEYS ).lower<std::vector>(); } );
+    
+    BOOST_CHECK( lift(cached).map( expensive ).lower<std::vector>() == lift(recomputed).map( expensive ).lower<std::vector>() );
+    BOOST_CHECK( trivialCached == trivialRecomputed );
+}
+
+// Tree-based (std::map/std::set) vs hash-based aggregation, from a few keys
+// to nearly all distinct
+void benchHashAggregation()
+{
+    std::vector<int> v( 200000 * benchScale() );
+    uint32_t h = 1;
+    for ( auto& x : v ) x = static_cast<int>( ( h = h * 1103515245u + 12345u ) >> 4 );
+    
+    for ( size_t cardinality : { size_t(16), size_t(4096), v.size() } )
+    {
+        std::string suffix = " (" + std::to_string( cardinality ) + " keys)";
+        auto key = [cardinality]( int x ) { return static_cast<size_t>( x ) % cardinality; };
+        
+        auto tree = timed( "countBy tree" + suffix, [&]() { return lift(v).countBy( key ).lower<std::vector>(); } );
+        auto hashed = timed( "countBy hash, sorted" + suffix, [&]() { return lift(v).countBy( key, SORTED_KEYS ).lower<std::vector>(); } );
+        auto unsorted = timed( "countBy hash, unsorted" + suffix, [&]() { return lift(v).countBy( key, UNSORTED_KEYS ).lower<std::vector>(); } );
+        BOOST_CHECK( tree == hashed );
+        BOOST_CHECK_EQUAL( tree.size(), unsorted.size() );
+        
+        auto identity = []( int x ) { return x; };
+        auto treeGroups = timed( "groupBy tree" + suffix, [&]() { return lift(v).groupBy( key, identity ).lower<std::vector>(); } );
+        auto hashGroups = timed( "groupBy hash, sorted" + suffix, [&]() { return lift(v).groupBy( key, identity, SORTED_KEYS ).lower<std::vector>(); } );
+        BOOST_CHECK( treeGroups == hashGroups );
+        
+        auto keys = lift(v).map( key ).lower<std::vector>();
+        auto treeDistinct = timed( "distinct tree" + suffix, [&]() { return lift(keys).distinctWith( std::less<size_t>() ).lower<std::vector>(); } );
+        auto hashDistinct = timed( "distinct hash" + suffix, [&]() { return lift(keys).distinct().lower<std::vector>(); } );
+        BOOST_CHECK( treeDistinct == hashDistinct );
+    }
+}
+
+// Searches whose answer is near the front of a long input should cost no more
+// than a handwritten loop that breaks out
+void benchEarlyExit()
+{
+    std::vector<int64_t> v( 10000000 * benchScale() );
+    for ( size_t i = 0; i < v.size(); ++i ) v[i] = static_cast<int64_t>( i );
+    
+    int64_t target = static_cast<int64_t>( v.size() / 100 );
+    auto isTarget = [target]( int64_t x ) { return x * 3 == target * 3; };
+    
+    size_t handwritten = timed( "exists near front (handwritten)", [&]()
+    {
+        for ( size_t i = 0; i < v.size(); ++i )
+        {
+            if ( isTarget( v[i] ) ) return i;
+        }
+        return v.size();
+    } );
+    
+    bool found = timed( "exists near front (lift)", [&]() { return lift(v).map( []( int64_t x ) { return x + 0; } ).exists( isTarget ); } );
+    size_t index = timed( "indexWhere near front (lift)", [&]() { return lift(v).indexWhere( isTarget ).get(); } );
+    bool parFound = timed( "exists near front (par)", [&]() { return lift(v).par().exists( isTarget ); } );
+    
+    BOOST_CHECK( found );
+    BOOST_CHECK( parFound );
+    BOOST_CHECK_EQUAL( handwritten, index );
+}
+
+// p50/p90/p99 from one selection buffer vs a full sort
+void benchQuantiles()
+{
+    // An odd count, so that every quantile asked for falls exactly on a rank
+    std::vector<double> v( 1000000 * benchScale() + 1 );
+    uint64_t h = 1;
+    for ( auto& x : v ) x = static_cast<double>( ( h = h * 6364136223846793005ull + 1442695040888963407ull ) >> 20 );
+    
+    std::vector<double> ps { 0.5, 0.9, 0.99 };
+    
+    std::vector<double> sorted = timed( "quantiles (sort)", [&]()
+    {
+        std::vector<double> copy = v;
+        std::sort( copy.begin(), copy.end() );
+        std::vector<double> res;
+        for ( double p : ps ) res.push_back( copy[static_cast<size_t>( p * ( copy.size() - 1 ) )] );
+        return res;
+    } );
+    
+    std::vector<double> selected = timed( "quantiles (selection)", [&]() { return lift(v).quantiles( ps ); } );
+    double median = timed( "median (selection)", [&]() { return lift(v).median(); } );
+    
+    BOOST_CHECK_EQUAL( sorted[0], median );
+    BOOST_CHECK( sorted == selected );
+}
+
+// One stats() pass vs a traversal per statistic
+void benchStats()
+{
+    std::vector<double> v( 1000000 * benchScale() );
+    for ( size_t i = 0; i < v.size(); ++i ) v[i] = static_cast<double>( ( i * 7919 ) % 10007 );
+    
+    double separate = timed( "mean/min/max/count (separate passes)", [&]()
+    {
+        return lift(v).mean() + lift(v).min() + lift(v).max() + static_cast<double>( lift(v).count() );
+    } );
+    
+    double fused = timed( "mean/min/max/count (stats)", [&]()
+    {
+        auto s = lift(v).stats();
+        return s.mean() + s.min() + s.max() + static_cast<double>( s.count() );
+    } );
+    
+    BOOST_CHECK_CLOSE( separate, fused, 1e-9 );
+}
+
+// Several aggregates of parsed single-shot input: retain then one pass each, vs
+// one aggregate() pass
+void benchAggregate()
+{
+    std::string text;
+    for ( size_t i = 0; i < 200000 * benchScale(); ++i ) text += std::to_string( ( i * 7919 ) % 10007 ) + "\n";
+    auto parse = []( const std::string& l ) { return std::stoll( l ); };
+    auto parity = []( int64_t v ) { return v % 2; };
+    
+    int64_t retained = timed( "sum/max/countBy (retain, then separate passes)", [&]()
+    {
+        std::istringstream lines( text );
+        auto values = lift(lines).map( parse ).retain<std::vector>();
+        return values.sum() + values.max() + static_cast<int64_t>( values.countBy( parity, UNSORTED_KEYS ).count() );
+    } );
+    
+    int64_t aggregated = timed( "sum/max/countBy (aggregate)", [&]()
+    {
+        std::istringstream lines( text );
+        auto res = lift(lines).map( parse ).aggregate( agg::sum(), agg::max(), agg::countBy( parity, UNSORTED_KEYS ) );
+        return std::get<0>( res ) + std::get<1>( res ).get() + static_cast<int64_t>( std::get<2>( res ).size() );
+    } );
+    
+    BOOST_CHECK_EQUAL( retained, aggregated );
+}
+
+// Reductions over a vector of doubles, element by element (through an identity
+// map) vs the vectorised contiguous kernels
+void benchContiguousReductions()
+{
+    std::vector<double> v( 10000000 * benchScale() );
+    for ( size_t i = 0; i < v.size(); ++i ) v[i] = static_cast<double>( ( i * 7919 ) % 10007 );
+    auto identity = []( double x ) { return x; };
+    auto large = []( double x ) { return x > 5000.0; };
+    
+    double scalar = timed( "sum/min/max/count(pred) (element by element)", [&]()
+    {
+        return lift(v).map( identity ).sum() + lift(v).map( identity ).min() + lift(v).map( identity ).max() +
+            static_cast<double>( lift(v).map( identity ).count( large ) );
+    } );
+    
+    double vectorised = timed( "sum/min/max/count(pred) (contiguous)", [&]()
+    {
+        return lift(v).sum() + lift(v).min() + lift(v).max() + static_cast<double>( lift(v).count( large ) );
+    } );
+    
+    BOOST_CHECK_CLOSE( scalar, vectorised, 1e-9 );
+}
+
+// Total line length of a file read through an ifstream vs mapped
+void benchMmapLines()
+{
+    char path[] = "/tmp/escalatorbenchXXXXXX";
+    int fd = mkstemp( path );
+    BOOST_REQUIRE( fd >= 0 );
+    close( fd );
+    {
+        std::ofstream out( path, std::ios::binary );
+        for ( size_t i = 0; i < 500000 * benchScale(); ++i ) out << "request " << ( i * 7919 ) % 10007 << " served in " << i % 97 << "ms\n";
+    }
+    auto length = []( const std::string& l ) { return l.size(); };
+    auto viewLength = []( StringView l ) { return l.size(); };
+    
+    size_t streamed = timed( "line lengths (ifstream)", [&]()
+    {
+        std::ifstream in( path );
+        return lift(in).map( length ).sum();
+    } );
+    
+    size_t mapped = timed( "line lengths (lift_mmap_lines)", [&]()
+    {
+        return lift_mmap_lines( path ).map( viewLength ).sum();
+    } );
+    
+    std::remove( path );
+    BOOST_CHECK_EQUAL( streamed, mapped );
+}
+
+// Total record length of the same text piped through an ifstream-style
+// getline loop vs the buffered record reader
+void benchFdRecords()
+{
+    std::string text;
+    for ( size_t i = 0; i < 500000 * benchScale(); ++i )
+    {
+        text += "request " + std::to_string( ( i * 7919 ) % 10007 ) + " served in " + std::to_string( i % 97 ) + "ms\n";
+    }
+    auto length = []( const std::string& l ) { return l.size(); };
+    auto viewLength = []( StringView l ) { return l.size(); };
+    
+    // Run fn over the read end of a pipe fed by another thread
+    auto piped = [&text]( std::function<size_t( int )> fn )
+    {
+        int fds[2];
+        BOOST_REQUIRE( pipe( fds ) == 0 );
+        std::thread writer( [&text, &fds]()
+        {
+            for ( size_t i = 0; i < text.size(); i += 1 << 16 )
+            {
+                size_t n = std::min<size_t>( 1 << 16, text.size() - i );
+                if ( write( fds[1], text.data() + i, n ) != static_cast<ssize_t>( n ) ) break;
+            }
+            close( fds[1] );
+        } );
+        size_t res = fn( fds[0] );
+        writer.join();
+        close( fds[0] );
+        return res;
+    };
+    
+    size_t streamed = timed( "record lengths (getline on /dev/fd)", [&]()
+    {
+        return piped( [&]( int fd )
+        {
+            std::ifstream in( "/dev/fd/" + std::to_string( fd ) );
+            return lift(in).map( length ).sum();
+        } );
+    } );
+    
+    size_t direct = timed( "record lengths (lift_fd_records, no read-ahead)", [&]()
+    {
+        return piped( [&]( int fd ) { return lift_fd_records( fd, '\n', NO_READ_AHEAD ).map( viewLength ).sum(); } );
+    } );
+    
+    size_t readAhead = timed( "record lengths (lift_fd_records)", [&]()
+    {
+        return piped( [&]( int fd ) { return lift_fd_records( fd ).map( viewLength ).sum(); } );
+    } );
+    
+    BOOST_CHECK_EQUAL( streamed, direct );
+    BOOST_CHECK_EQUAL( streamed, readAhead );
+}
+
+// Summing the trimmed integer fields of comma separated records: owning
+// strings per field (split into a vector, trim_copy) vs lazy views
+void benchSplitTrim()
+{
+    std::vector<std::string> records;
+    for ( size_t i = 0; i < 100000 * benchScale(); ++i )
+    {
+        records.push_back( " " + std::to_string( i % 1000 ) + ",  " + std::to_string( i % 77 ) + " ,3, " + std::to_string( i % 10 ) + "  " );
+    }
+    
+    int64_t copied = timed( "field sum (owning split/trim)", [&]()
+    {
+        return lift(records).map( []( const std::string& r )
+        {
+            return lift( std::string( r ) ).split( "," ).map( []( const std::string& f )
+            {
+                return int64_t( boost::lexical_cast<int>( lift( std::string( f ) ).trim().toString() ) );
+            } ).sum();
+        } ).sum();
+    } );
+    
+    int64_t viewed = timed( "field sum (view split/trim)", [&]()
+    {
+        return lift(records).map( []( const std::string& r )
+        {
+            return lift(r).split( "," ).map( []( StringView f )
+            {
+                StringView trimmed = lift(f).trim().view();
+                return int64_t( boost::lexical_cast<int>( trimmed.data(), trimmed.size() ) );
+            } ).sum();
+        } ).sum();
+    } );
+    
+    BOOST_CHECK_EQUAL( copied, viewed );
+}
+
+void benchCsv()
+{
+    std::stringstream text;
+    for ( size_t i = 0; i < 100000 * benchScale(); ++i )
+    {
+        text << i << ",item" << i % 97 << ", " << ( i % 1000 ) * 0.25 << " ," << i % 13 << "\n";
+    }
+    const std::string csv = text.str();
+    
+    double chained = timed( "weighted sum (split/trim/lexical_cast)", [&]()
+    {
+        std::istringstream in( csv );
+        return lift(in).map( []( const std::string& line )
+        {
+            std::vector<std::string> fields = lift(line).split( "," ).map( []( StringView f ) { return lift(f).trim().toString(); } ).lower<std::vector>();
+            return boost::lexical_cast<double>( fields[2] ) * boost::lexical_cast<int>( fields[3] );
+        } ).sum();
+    } );
+    
+    double parsed = timed( "weighted sum (lift_csv)", [&]()
+    {
+        std::istringstream in( csv );
+        return lift_csv( in, csvSchema<double, int>( { 2, 3 } ) ).map( []( const std::tuple<double, int>& r )
+        {
+            return std::get<0>( r ) * std::get<1>( r );
+        } ).sum();
+    } );
+    
+    BOOST_CHECK_CLOSE( chained, parsed, 1e-9 );
+}
+
+// Tokens and matches over log lines: boost::algorithm split (is_any_of),
+// trim_copy and find_first vs the vectorised kernels behind split(), trim()
+// and StringView::find
+void benchStringKernels()
+{
+    const char* levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+    std::vector<std::string> lines;
+    for ( size_t i = 0; i < 50000 * benchScale(); ++i )
+    {
+        lines.push_back( "  2026-10-16 12:" + std::to_string( 10 + i % 50 ) + ":" + std::to_string( 10 + i % 49 ) +
+            "\t" + levels[i % 4] + "\t[worker-" + std::to_string( i % 16 ) + "] GET /api/v1/items/" + std::to_string( i * 7919 % 100003 ) +
+            "?page=" + std::to_string( i % 9 ) + " status=" + std::to_string( i % 7 ? 200 : 503 ) + " latency_ms=" + std::to_string( i % 997 ) + "   " );
+    }
+    
+    size_t boosted = timed( "tokens and errors (boost split/trim/find_first)", [&]()
+    {
+        size_t total = 0;
+        std::vector<std::string> fields;
+        for ( const std::string& l : lines )
+        {
+            std::string trimmed = boost::algorithm::trim_copy( l );
+            boost::algorithm::split( fields, trimmed, boost::algorithm::is_any_of( " \t=?" ) );
+            total += fields.size();
+            if ( !boost::algorithm::find_first( trimmed, "status=503" ).empty() ) total += 1000;
+        }
+        return total;
+    } );
+    
+    size_t kernels = timed( "tokens and errors (StringView split/trim/find)", [&]()
+    {
+        return lift(lines).map( []( const std::string& l )
+        {
+            StringView trimmed = lift(l).trim().view();
+            return lift(trimmed).split( " \t=?" ).count() + ( trimmed.contains( "status=503" ) ? 1000 : 0 );
+        } ).sum();
+    } );
+    
+    BOOST_CHECK_EQUAL( boosted, kernels );
+}
+
+// Joining numbers for a bulk-load payload: a stringstream with one << per
+// element (as mkString used to) vs mkString and mkStringInto a reused buffer
+void benchMkString()
+{
+    std::vector<int64_t> ids;
+    std::vector<double> prices;
+    for ( size_t i = 0; i < 200000 * benchScale(); ++i )
+    {
+        ids.push_back( static_cast<int64_t>( i * 7919 ) - 500000 );
+        prices.push_back( ( i % 10007 ) * 0.37 );
+    }
+    
+    std::string streamed = timed( "join (stringstream)", [&]()
+    {
+        std::stringstream ss;
+        for ( size_t i = 0; i < ids.size(); ++i ) ss << ( i ? "," : "" ) << ids[i];
+        ss << "\n";
+        for ( size_t i = 0; i < prices.size(); ++i ) ss << ( i ? "," : "" ) << prices[i];
+        return ss.str();
+    } );
+    
+    std::string built = timed( "join (mkString)", [&]()
+    {
+        return lift(ids).mkString( "," ) + "\n" + lift(prices).mkString( "," );
+    } );
+    
+    std::string buffer;
+    for ( size_t round = 0; round < 2; ++round )
+    {
+        timed( "join (mkStringInto a reused buffer)", [&]()
+        {
+            buffer.clear();
+            lift(ids).mkStringInto( buffer, "," ) += "\n";
+            lift(prices).mkStringInto( buffer, "," );
+            return buffer.size();
+        } );
+    }
+    
+    BOOST_CHECK( streamed == built );
+    BOOST_CHECK( streamed == buffer );
+}
+
+// Many small requests on several threads at once, each sorting, grouping and
+// deduplicating its batch: intermediates on the shared heap vs a per-thread
+// arena released after every request
+void benchArenaRequests()
+{
+    const size_t threads = 4;
+    const size_t requests = 2000 * benchScale();
+    std::vector<std::vector<int>> batches;
+    for ( size_t b = 0; b < 64; ++b )
+    {
+        std::vector<int> batch;
+        for ( size_t i = 0; i < 500; ++i ) batch.push_back( static_cast<int>( ( ( b + 1 ) * i * 7919 ) % 1009 ) );
+        batches.push_back( batch );
+    }
+    auto mod13 = []( int v ) { return v % 13; };
+    
+    // Runs request( thread, batch ) for every request, across the threads
+    auto serve = [&]( std::function<size_t( size_t, const std::vector<int>& )> request )
+    {
+        std::vector<size_t> totals( threads, 0 );
+        std::vector<std::thread> workers;
+        for ( size_t t = 0; t < threads; ++t )
+        {
+            workers.push_back( std::thread( [&, t]()
+            {
+                for ( size_t r = t; r < requests; r += threads ) totals[t] += request( t, batches[r % batches.size()] );
+            } ) );
+        }
+        for ( auto& w : workers ) w.join();
+        return lift(totals).sum();
+    };
+    
+    size_t heap = timed( "requests (heap)", [&]()
+    {
+        return serve( [&]( size_t, const std::vector<int>& batch )
+        {
+            size_t groups = lift(batch).groupBy( mod13, mod13 ).count();
+            size_t distinct = lift(batch).distinct().count();
+            return lift(batch).sort().lower<std::vector>()[batch.size() / 2] + groups + distinct;
+        } );
+    } );
+    
+    std::vector<std::unique_ptr<Arena>> arenas;
+    for ( size_t t = 0; t < threads; ++t ) arenas.push_back( std::unique_ptr<Arena>( new Arena() ) );
+    size_t arena = timed( "requests (per-thread arena)", [&]()
+    {
+        return serve( [&]( size_t t, const std::vector<int>& batch )
+        {
+            ArenaAllocator<int> alloc( *arenas[t] );
+            size_t res;
+            {
+                size_t groups = lift(batch).groupBy( mod13, mod13, alloc ).count();
+                size_t distinct = lift(batch).distinct( alloc ).count();
+                res = lift(batch).sort( alloc ).lower<std::vector>( alloc )[batch.size() / 2] + groups + distinct;
+            }
+            arenas[t]->release();
+            return res;
+        } );
+    } );
+    
+    BOOST_CHECK_EQUAL( heap, arena );
+}
+
+void addBenchmarks( test_suite *t )
+{
+    test_suite* benchmarks = BOOST_TEST_SUITE( "benchmarks" );
+    benchmarks->add( BOOST_TEST_CASE( benchMapChain ) );
+    benchmarks->add( BOOST_TEST_CASE( benchZipChain ) );
+    benchmarks->add( BOOST_TEST_CASE( benchSchedulerSpawnJoin ) );
+    benchmarks->add( BOOST_TEST_CASE( benchSchedulerSkewed ) );
+    benchmarks->add( BOOST_TEST_CASE( benchSort ) );
+    benchmarks->add( BOOST_TEST_CASE( benchSortBy ) );
+    benchmarks->add( BOOST_TEST_CASE( benchHashAggregation ) );
+    benchmarks->add( BOOST_TEST_CASE( benchEarlyExit ) );
+    benchmarks->add( BOOST_TEST_CASE( benchQuantiles ) );
+    benchmarks->add( BOOST_TEST_CASE( benchStats ) );
+    benchmarks->add( BOOST_TEST_CASE( benchAggregate ) );
+    benchmarks->add( BOOST_TEST_CASE( benchContiguousReductions ) );
+    benchmarks->add( BOOST_TEST_CASE( benchMmapLines ) );
+    benchmarks->add( BOOST_TEST_CASE( benchFdRecords ) );
+    benchmarks->add( BOOST_TEST_CASE( benchSplitTrim ) );
+    benchmarks->add( BOOST_TEST_CASE( benchCsv ) );
+    benchmarks->add( BOOST_TEST_CASE( benchStringKernels ) );
+    benchmarks->add( BOOST_TEST_CASE( benchMkString ) );
+    benchmarks->add( BOOST_TEST_CASE( benchArenaRequests ) );
+    t->add( benchmarks );
+}
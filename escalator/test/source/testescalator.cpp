@@ -3,6 +3,10 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+
 #include "escalator.hpp"
 
 using namespace boost::unit_test;
@@ -726,7 +730,6 @@ void testGenericLift()
     {
     public:
         Source() : m_eof(false), m_val(0) {}
-        typedef int value_type;
         bool eof() { return m_eof; }
         int pop() { return m_val; }
 
@@ -832,6 +835,1533 @@ void testIteratorAndIterable()
     }
 }
 
+void testPushIteration()
+{
+    std::vector<int> a = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    
+    // Linear chains over iterators push, chains through zip/slice fall back to pulling
+    {
+        auto chain = lift(a).map( []( int v ) { return v * 2; } ).filter( []( int v ) { return v > 4; } ).zipWithIndex();
+        BOOST_CHECK( IsPushCapable<decltype(chain)>::value );
+        
+        auto zipped = lift(a).zip( lift(a) ).map( []( const std::pair<int, int>& p ) { return p.first; } );
+        BOOST_CHECK( !IsPushCapable<decltype(zipped)>::value );
+        BOOST_CHECK_EQUAL( zipped.sum(), 55 );
+        
+        BOOST_CHECK_EQUAL( lift(a).take(3).map( []( int v ) { return v + 1; } ).sum(), 9 );
+    }
+    
+    // Switching from pulling to pushing part way through loses nothing
+    {
+        auto filtered = lift(a).filter( []( int v ) { return v % 3 != 0; } );
+        BOOST_CHECK_EQUAL( filtered.next(), 1 );
+        BOOST_CHECK( filtered.hasNext() );
+        CHECK_SAME_ELEMENTS( filtered.lower<std::vector>(), std::vector<int> { 2, 4, 5, 7, 8, 10 } );
+    }
+    
+    {
+        std::vector<std::vector<int>> d = { { 1, 2, 3 }, {}, { 4 }, { 5, 6 } };
+        auto flat = lift_cref(d)
+            .map( []( const std::vector<int>& inner ) { return lift(inner); } )
+            .flatMap( []( int v ) { return v * 10; } );
+        
+        BOOST_CHECK_EQUAL( flat.next(), 10 );
+        BOOST_CHECK( flat.hasNext() );
+        CHECK_SAME_ELEMENTS( flat.lower<std::vector>(), std::vector<int> { 20, 30, 40, 50, 60 } );
+    }
+    
+    {
+        std::istringstream iss( "a\nbb\n\nccc" );
+        std::vector<size_t> lengths;
+        lift(iss).foreach( [&lengths]( const std::string& line ) { lengths.push_back( line.size() ); } );
+        CHECK_SAME_ELEMENTS( lengths, std::vector<size_t> { 1, 2, 0, 3 } );
+    }
+    
+    BOOST_CHECK_EQUAL( lift(a).mkString(","), "1,2,3,4,5,6,7,8,9,10" );
+    BOOST_CHECK_EQUAL( lift(std::vector<int>()).mkString(","), "" );
+    BOOST_CHECK_EQUAL( lift(a).filter( []( int v ) { return v > 5; } ).count(), 5 );
+}
+
+void testFunctorStorage()
+{
+    std::vector<int> a = { 1, 2, 3, 4, 5 };
+    
+    // Captureless lambdas are stored without taking up any space
+    auto plusOne = []( int v ) { return v + 1; };
+    BOOST_CHECK( std::is_empty<FunctorHolder<decltype(plusOne)>>::value );
+    BOOST_CHECK_EQUAL( lift(a).map( plusOne ).sum(), 20 );
+    
+    // Wrappers holding capturing (non-assignable) lambdas remain assignable,
+    // which flatMap relies on for its inner sequences
+    int offset = 10;
+    std::vector<std::vector<int>> d = { { 1, 2 }, {}, { 3 } };
+    std::vector<int> res = lift_cref(d)
+        .map( [offset]( const std::vector<int>& inner ) { return lift(inner).map( [offset]( int v ) { return v + offset; } ); } )
+        .flatten()
+        .lower<std::vector>();
+    CHECK_SAME_ELEMENTS( res, std::vector<int> { 11, 12, 13 } );
+    
+    auto m1 = lift(a).map( [offset]( int v ) { return v * offset; } );
+    auto m2 = m1;
+    m2.next();
+    m1 = m2;
+    BOOST_CHECK_EQUAL( m1.sum(), 140 );
+}
+
+void testBatchIteration()
+{
+    // Enough elements to span several batches
+    std::vector<int> a;
+    for ( int i = 0; i < 5000; ++i ) a.push_back( i );
+    
+    auto numeric = lift(a).map( []( int v ) { return v * 0.5; } ).filter( []( double v ) { return v > 1.0; } );
+    auto strings = lift(a).map( []( int v ) { return std::to_string(v); } );
+    BOOST_CHECK( IsBatchCapable<decltype(lift(a))>::value );
+    BOOST_CHECK( IsBatchCapable<decltype(numeric)>::value );
+    BOOST_CHECK( IsBatchCapable<decltype(lift(a).zip( counter() ).take(10))>::value );
+    BOOST_CHECK( !IsBatchCapable<decltype(lift_ref(a))>::value );
+    BOOST_CHECK( !IsBatchCapable<decltype(strings)>::value );
+    
+    int64_t expected = 0;
+    for ( int v : a ) if ( v % 7 == 3 ) expected += v * 2;
+    
+    BOOST_CHECK_EQUAL( lift(a).filter( []( int v ) { return v % 7 == 3; } ).map( []( int v ) { return int64_t(v) * 2; } ).take(5000).sum(), expected );
+    BOOST_CHECK_EQUAL( lift(a).filter( []( int v ) { return v % 7 == 3; } ).take(5000).count(), 714 );
+    
+    std::vector<std::pair<int, int>> zipped = lift(a).zip( counter().drop(10) ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( zipped.size(), 5000 );
+    BOOST_CHECK_EQUAL( zipped[4321].first, 4321 );
+    BOOST_CHECK_EQUAL( zipped[4321].second, 4331 );
+    
+    BOOST_CHECK_EQUAL( counter().slice(1000, 3000).fold( 0, []( int acc, int v ) { return acc + ( v & 1 ); } ), 1000 );
+    
+    std::vector<std::pair<int, size_t>> indexed = lift(a).filter( []( int v ) { return v >= 4000; } ).zipWithIndex().lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( indexed.size(), 1000 );
+    BOOST_CHECK_EQUAL( indexed[999].first, 4999 );
+    BOOST_CHECK_EQUAL( indexed[999].second, 999 );
+    
+    CHECK_SAME_ELEMENTS( lift(a).take(2000, ASSERT_WHEN_INSUFFICIENT).drop(1998).lower<std::vector>(), std::vector<int> { 1998, 1999 } );
+    BOOST_CHECK_THROW( lift(a).take(6000, ASSERT_WHEN_INSUFFICIENT).count(), SliceError );
+}
+
+void testSizeHints()
+{
+    std::vector<int> a;
+    for ( int i = 0; i < 1000; ++i ) a.push_back( i );
+    std::list<int> l( a.begin(), a.end() );
+    
+    auto mapped = lift(a).map( []( int v ) { return v * 2; } );
+    BOOST_CHECK( sizeHintOf( mapped ).isExact() );
+    BOOST_CHECK_EQUAL( sizeHintOf( mapped ).size(), 1000 );
+    
+    auto zipped = lift(a).zip( lift(a).drop(10) );
+    BOOST_CHECK( sizeHintOf( zipped ).isExact() );
+    BOOST_CHECK_EQUAL( sizeHintOf( zipped ).size(), 990 );
+    
+    auto sliced = lift(a).slice( 100, 200 );
+    BOOST_CHECK( sizeHintOf( sliced ).isExact() );
+    BOOST_CHECK_EQUAL( sizeHintOf( sliced ).size(), 100 );
+    BOOST_CHECK_EQUAL( sizeHintOf( lift(a).take(5000) ).size(), 1000 );
+    
+    // Filters and unbounded sources only give an upper bound, or nothing
+    auto filtered = lift(a).filter( []( int v ) { return v % 3 == 0; } );
+    BOOST_CHECK( !sizeHintOf( filtered ).isExact() );
+    BOOST_CHECK_EQUAL( sizeHintOf( filtered ).size(), 1000 );
+    BOOST_CHECK( !sizeHintOf( counter() ).isBounded() );
+    BOOST_CHECK( !sizeHintOf( counter().take(10) ).isExact() );
+    BOOST_CHECK_EQUAL( sizeHintOf( counter().take(10) ).size(), 10 );
+    BOOST_CHECK( !sizeHintOf( lift(l) ).isExact() );
+    
+    // Exact hints allocate once
+    std::vector<int> lowered = mapped.lower<std::vector>();
+    BOOST_CHECK_EQUAL( lowered.size(), 1000 );
+    BOOST_CHECK_EQUAL( lowered.capacity(), 1000 );
+    
+    std::vector<int> slicedLowered = lift(a).slice( 100, 200 ).lower<std::vector>();
+    BOOST_CHECK_EQUAL( slicedLowered.capacity(), 100 );
+    
+    // A loose bound must not over-allocate
+    std::vector<int> filteredLowered = lift(a).filter( []( int v ) { return v < 10; } ).lower<std::vector>();
+    BOOST_CHECK_EQUAL( filteredLowered.size(), 10 );
+    BOOST_CHECK( filteredLowered.capacity() < 1000 );
+    
+    CHECK_SAME_ELEMENTS( lift(l).map( []( int v ) { return v + 1; } ).take(3).lower<std::vector>(), std::vector<int> { 1, 2, 3 } );
+}
+
+void testRandomAccessSkip()
+{
+    std::vector<int> a;
+    for ( int i = 0; i < 1000; ++i ) a.push_back( i );
+    std::deque<int> d( a.begin(), a.end() );
+    std::list<int> l( a.begin(), a.end() );
+    
+    auto identity = []( int v ) { return v; };
+    auto positive = []( int v ) { return v > 0; };
+    BOOST_CHECK( IsAdvanceable<decltype(lift(a))>::value );
+    BOOST_CHECK( IsAdvanceable<decltype(lift(d).map( identity ))>::value );
+    BOOST_CHECK( IsAdvanceable<decltype(lift(a).zip( counter() ))>::value );
+    BOOST_CHECK( !IsAdvanceable<decltype(lift(l))>::value );
+    BOOST_CHECK( !IsAdvanceable<decltype(lift(a).filter( positive ))>::value );
+    
+    // Skipped elements are never mapped
+    int calls = 0;
+    auto page = lift(a).map( [&calls]( int v ) { calls++; return v * 2; } ).drop(900).take(5).lower<std::vector>();
+    CHECK_SAME_ELEMENTS( page, std::vector<int> { 1800, 1802, 1804, 1806, 1808 } );
+    BOOST_CHECK_EQUAL( calls, 5 );
+    
+    CHECK_SAME_ELEMENTS( lift(d).drop(10).drop(20).take(2).lower<std::vector>(), std::vector<int> { 30, 31 } );
+    CHECK_SAME_ELEMENTS( lift(l).slice(500, 502).lower<std::vector>(), std::vector<int> { 500, 501 } );
+    CHECK_SAME_ELEMENTS( lift(a).zip( counter() ).drop(998).map( []( std::pair<int, int> p ) { return p.first + p.second; } ).lower<std::vector>(),
+        std::vector<int> { 1996, 1998 } );
+    CHECK_SAME_ELEMENTS( counter().drop(1000000).take(2).lower<std::vector>(), std::vector<int> { 1000000, 1000001 } );
+    
+    BOOST_CHECK_EQUAL( lift(a).drop(5000).count(), 0 );
+    BOOST_CHECK_THROW( lift(a).drop(1001, ASSERT_WHEN_INSUFFICIENT), SliceError );
+    BOOST_CHECK_THROW( lift(a).take(2000, ASSERT_WHEN_INSUFFICIENT).drop(1500), SliceError );
+    BOOST_CHECK_EQUAL( lift(a).take(10, ASSERT_WHEN_INSUFFICIENT).drop(20).count(), 0 );
+    BOOST_CHECK_EQUAL( lift(a).take(10).drop(20).count(), 0 );
+}
+
+void testParallel()
+{
+    std::vector<int> a;
+    for ( int i = 0; i < 100000; ++i ) a.push_back( (i * 7919) % 100003 );
+    
+    auto square = []( int v ) { return int64_t(v) * v; };
+    auto odd = []( int64_t v ) { return (v & 1) == 1; };
+    
+    std::vector<int64_t> expected = lift(a).map( square ).filter( odd ).lower<std::vector>();
+    CHECK_SAME_ELEMENTS( lift(a).par(4).map( square ).filter( odd ).lower<std::vector>(), expected );
+    CHECK_SAME_ELEMENTS( lift(a).par().map( square ).filter( odd ).lower<std::vector>(), expected );
+    BOOST_CHECK_EQUAL( lift(a).par(4).map( square ).filter( odd ).count(), expected.size() );
+    BOOST_CHECK_EQUAL( lift(a).par(4).map( square ).sum(), lift(a).map( square ).sum() );
+    BOOST_CHECK_EQUAL( lift(a).par(3).fold( int64_t(0), []( int64_t acc, int v ) { return acc + v; }, []( int64_t x, int64_t y ) { return x + y; } ),
+        lift(a).fold( int64_t(0), []( int64_t acc, int v ) { return acc + v; } ) );
+    
+    // Ties go to the first occurrence, as sequentially
+    std::vector<int> ties { 5, 1, 9, 1, 9, 3, 1, 9 };
+    auto notFive = []( int v ) { return v != 5; };
+    for ( size_t threads = 1; threads <= 10; ++threads )
+    {
+        BOOST_CHECK( lift(ties).par(threads).argMin() == lift(ties).argMin() );
+        BOOST_CHECK( lift(ties).par(threads).argMax() == lift(ties).argMax() );
+        BOOST_CHECK( lift(ties).par(threads).filter( notFive ).argMin() == lift(ties).filter( notFive ).argMin() );
+    }
+    BOOST_CHECK_EQUAL( lift(a).par(4).min(), lift(a).min() );
+    BOOST_CHECK_EQUAL( lift(a).par(4).max(), lift(a).max() );
+    
+    BOOST_CHECK( lift(a).par(4).exists( []( int v ) { return v == 12345; } ) );
+    BOOST_CHECK( !lift(a).par(4).exists( []( int v ) { return v < 0; } ) );
+    BOOST_CHECK( lift(a).par(4).forall( []( int v ) { return v >= 0; } ) );
+    BOOST_CHECK( !lift(a).par(4).forall( []( int v ) { return v != 12345; } ) );
+    
+    std::atomic<int64_t> total( 0 );
+    lift(a).par(4).foreach( [&total]( int v ) { total += v; } );
+    BOOST_CHECK_EQUAL( total.load(), lift(a).map( []( int v ) { return int64_t(v); } ).sum() );
+
+    // No more chunks run at once than asked for, whatever the pool's size
+    for ( size_t threads : { size_t(1), size_t(2) } )
+    {
+        std::atomic<int> running( 0 ), peak( 0 );
+        auto slow = [&running, &peak]( int v )
+        {
+            int now = ++running;
+            for ( int seen = peak; now > seen && !peak.compare_exchange_weak( seen, now ); ) {}
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            --running;
+            return v;
+        };
+        std::vector<int> head = lift(a).take( 64 ).lower<std::vector>();
+        BOOST_CHECK_EQUAL( lift(head).par(threads).map( slow ).sum(), lift(head).sum() );
+        BOOST_CHECK( peak.load() >= 1 && peak.load() <= static_cast<int>( threads ) );
+    }
+
+    // Works from a retained container, and with more threads than elements
+    auto sorted = lift(ties).sort();
+    CHECK_SAME_ELEMENTS( sorted.par(16).map( []( int v ) { return v * 10; } ).lower<std::vector>(),
+        std::vector<int> { 10, 10, 10, 30, 50, 90, 90, 90 } );
+    
+    std::vector<int> empty;
+    BOOST_CHECK_EQUAL( lift(empty).par(4).count(), 0 );
+    BOOST_CHECK( lift(empty).par(4).lower<std::vector>().empty() );
+    BOOST_CHECK( !lift(empty).par(4).exists( []( int ) { return true; } ) );
+    BOOST_CHECK_THROW( lift(empty).par(4).sum(), std::runtime_error );
+    
+    // Exceptions propagate to the caller
+    BOOST_CHECK_THROW( lift(a).par(4).map( []( int v ) -> int { if ( v == 99999 ) throw std::logic_error( "bad" ); return v; } ).count(), std::logic_error );
+}
+
+void testScheduler()
+{
+    TaskScheduler scheduler( 3 );
+    BOOST_CHECK_EQUAL( scheduler.workerCount(), 3 );
+    
+    std::atomic<int> ran( 0 );
+    {
+        TaskGroup group( scheduler );
+        for ( int i = 0; i < 1000; ++i ) group.run( [&ran]() { ran++; } );
+        group.wait();
+        BOOST_CHECK_EQUAL( ran.load(), 1000 );
+    }
+    
+    // Tasks may spawn into their own group, and the first error is rethrown from wait
+    {
+        TaskGroup group( scheduler );
+        group.run( [&group, &ran]()
+        {
+            for ( int i = 0; i < 10; ++i ) group.run( [&ran]() { ran++; } );
+            throw std::logic_error( "failed" );
+        } );
+        BOOST_CHECK_THROW( group.wait(), std::logic_error );
+        BOOST_CHECK_EQUAL( ran.load(), 1010 );
+        
+        group.wait();
+    }
+    
+    // A waiter with nothing to steal sleeps until its group is done
+    {
+        std::clock_t before = std::clock();
+        TaskGroup group( scheduler );
+        group.run( []() { std::this_thread::sleep_for( std::chrono::milliseconds( 300 ) ); } );
+        group.wait();
+        BOOST_CHECK( std::clock() - before < CLOCKS_PER_SEC / 10 );
+    }
+    
+    std::vector<int> hits( 10000, 0 );
+    auto mark = [&hits]( size_t i ) { hits[i]++; };
+    parallelFor( hits.size(), mark, scheduler );
+    BOOST_CHECK( lift(hits).forall( []( int h ) { return h == 1; } ) );
+    
+    // Nested parallel operations share the pool rather than deadlocking or
+    // starting threads of their own
+    std::vector<std::vector<int>> rows( 64, std::vector<int>( 1000, 1 ) );
+    std::atomic<int> total( 0 );
+    lift(rows).par(8).foreach( [&total]( const std::vector<int>& row ) { total += lift(row).par(8).sum(); } );
+    BOOST_CHECK_EQUAL( total.load(), 64000 );
+    
+    std::vector<std::vector<int>> ragged;
+    for ( int i = 0; i < 100; ++i ) ragged.push_back( std::vector<int>( i % 5, i ) );
+    auto liftRow = []( const std::vector<int>& row ) { return lift(row); };
+    auto twice = []( int v ) { return v * 2; };
+    CHECK_SAME_ELEMENTS( lift(ragged).par(4).map( liftRow ).flatMap( twice ).lower<std::vector>(),
+        lift(ragged).map( liftRow ).flatMap( twice ).lower<std::vector>() );
+    
+    // The global pool can only be resized before it starts
+    BOOST_CHECK( TaskScheduler::global().workerCount() > 0 );
+    BOOST_CHECK_THROW( TaskScheduler::setGlobalWorkerCount( 2 ), std::runtime_error );
+}
+
+void testParallelSort()
+{
+    TaskScheduler scheduler( 3 );
+    
+    for ( size_t size : { size_t(0), size_t(1), size_t(5000), size_t(40000), size_t(100003) } )
+    {
+        std::vector<int> a( size );
+        uint32_t h = 1;
+        for ( auto& v : a ) v = ( h = h * 1103515245u + 12345u ) >> 20;
+        
+        std::vector<int> expected = a;
+        std::sort( expected.begin(), expected.end() );
+        
+        std::vector<int> sorted = a;
+        parallelSort( sorted.begin(), sorted.end(), std::less<int>(), false, scheduler );
+        BOOST_CHECK( sorted == expected );
+        
+        // Stability: sort by a coarse key, with the original index as payload
+        std::vector<std::pair<int, size_t>> keyed;
+        for ( size_t i = 0; i < a.size(); ++i ) keyed.push_back( std::make_pair( a[i] % 64, i ) );
+        auto byKey = []( const std::pair<int, size_t>& l, const std::pair<int, size_t>& r ) { return l.first < r.first; };
+        
+        std::vector<std::pair<int, size_t>> stableExpected = keyed;
+        std::stable_sort( stableExpected.begin(), stableExpected.end(), byKey );
+        parallelSort( keyed.begin(), keyed.end(), byKey, true, scheduler );
+        BOOST_CHECK( keyed == stableExpected );
+        
+        CHECK_SAME_ELEMENTS( lift(a).sort().lower<std::vector>(), expected );
+        CHECK_SAME_ELEMENTS( lift(a).sortWith( std::greater<int>() ).lower<std::vector>(), std::vector<int>( expected.rbegin(), expected.rend() ) );
+    }
+
+    // The merge buffer comes from the allocator given
+    {
+        std::vector<int> a( 100003 );
+        uint32_t h = 1;
+        for ( auto& v : a ) v = ( h = h * 1103515245u + 12345u ) >> 20;
+        std::vector<int> expected = a;
+        std::sort( expected.begin(), expected.end() );
+
+        Arena arena;
+        parallelSort( a.begin(), a.end(), std::less<int>(), false, ArenaAllocator<int>( arena ), scheduler );
+        BOOST_CHECK( a == expected );
+        BOOST_CHECK_EQUAL( arena.bytesAllocated(), a.size() * sizeof(int) );
+    }
+
+    std::vector<std::pair<int, std::string>> words { { 3, "c" }, { 1, "a" }, { 3, "a" }, { 2, "b" }, { 1, "z" } };
+    auto first = []( const std::pair<int, std::string>& p ) { return p.first; };
+    auto stable = lift(words).stableSortBy( first ).map( []( const std::pair<int, std::string>& p ) { return p.second; } ).lower<std::vector>();
+    CHECK_SAME_ELEMENTS( stable, std::vector<std::string> { "a", "z", "b", "c", "a" } );
+    CHECK_SAME_ELEMENTS( lift(words).sortBy( first ).map( first ).lower<std::vector>(), std::vector<int> { 1, 1, 2, 3, 3 } );
+}
+
+void testSortByKeyCaching()
+{
+    std::vector<int> a;
+    for ( int i = 0; i < 2000; ++i ) a.push_back( (i * 7919) % 2003 );
+    
+    std::vector<int> expected = a;
+    std::sort( expected.begin(), expected.end(), []( int l, int r ) { return std::to_string(l) < std::to_string(r); } );
+    
+    // Keys returned by value are computed once per element
+    int calls = 0;
+    auto asString = [&calls]( int v ) { calls++; return std::to_string(v); };
+    CHECK_SAME_ELEMENTS( lift(a).sortBy( asString ).lower<std::vector>(), expected );
+    BOOST_CHECK_EQUAL( calls, 2000 );
+    
+    calls = 0;
+    CHECK_SAME_ELEMENTS( lift(a).sortBy( asString, RECOMPUTE_KEYS ).lower<std::vector>(), expected );
+    BOOST_CHECK( calls > 2000 );
+    
+    // Projections returning a reference are cheap, so are recomputed unless asked otherwise
+    std::vector<std::pair<int, int>> pairs;
+    for ( size_t i = 0; i < a.size(); ++i ) pairs.push_back( std::make_pair( a[i] % 10, static_cast<int>( i ) ) );
+    calls = 0;
+    auto byFirst = [&calls]( const std::pair<int, int>& p ) -> const int& { calls++; return p.first; };
+    auto sorted = lift(pairs).stableSortBy( byFirst ).lower<std::vector>();
+    BOOST_CHECK( calls > 2000 );
+    calls = 0;
+    auto sortedCached = lift(pairs).stableSortBy( byFirst, CACHE_KEYS ).lower<std::vector>();
+    BOOST_CHECK_EQUAL( calls, 2000 );
+    
+    std::vector<std::pair<int, int>> stableExpected = pairs;
+    std::stable_sort( stableExpected.begin(), stableExpected.end(), []( const std::pair<int, int>& l, const std::pair<int, int>& r ) { return l.first < r.first; } );
+    BOOST_CHECK( sorted == stableExpected );
+    BOOST_CHECK( sortedCached == stableExpected );
+    BOOST_CHECK( lift(pairs).sortBy( []( const std::pair<int, int>& p ) { return p.first; } ).map( []( const std::pair<int, int>& p ) { return p.first; } ).lower<std::vector>() ==
+        lift(stableExpected).map( []( const std::pair<int, int>& p ) { return p.first; } ).lower<std::vector>() );
+}
+
+enum Colour { RED, GREEN, BLUE };
+
+void testHashAggregation()
+{
+    std::vector<int> a;
+    for ( int i = 0; i < 10000; ++i ) a.push_back( (i * 7919) % 1009 );
+    
+    // distinct keeps first-seen order
+    std::vector<int> firstSeen;
+    std::set<int> seen;
+    for ( int v : a ) if ( seen.insert( v ).second ) firstSeen.push_back( v );
+    CHECK_SAME_ELEMENTS( lift(a).distinct().lower<std::vector>(), firstSeen );
+    CHECK_SAME_ELEMENTS( lift(a).distinctWith( std::less<int>() ).lower<std::vector>(), firstSeen );
+    
+    std::vector<std::string> words { "b", "a", "b", "c", "a" };
+    CHECK_SAME_ELEMENTS( lift(words).distinct().lower<std::vector>(), std::vector<std::string> { "b", "a", "c" } );
+    
+    // Ordered countBy/groupBy agree with the std::map versions
+    auto mod = []( int v ) { return v % 17; };
+    auto treeCounts = lift(a).countBy( mod ).lower<std::vector>();
+    auto sortedCounts = lift(a).countBy( mod, SORTED_KEYS ).lower<std::vector>();
+    BOOST_CHECK( treeCounts == sortedCounts );
+    
+    auto unsortedCounts = lift(a).countBy( mod, UNSORTED_KEYS ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( unsortedCounts.size(), 17 );
+    BOOST_CHECK_EQUAL( unsortedCounts[0].first, mod( a[0] ) );
+    std::sort( unsortedCounts.begin(), unsortedCounts.end() );
+    BOOST_CHECK( unsortedCounts == sortedCounts );
+    
+    auto half = []( int v ) { return v / 2.0; };
+    auto treeGroups = lift(a).groupBy( mod, half ).lower<std::vector>();
+    auto sortedGroups = lift(a).groupBy( mod, half, SORTED_KEYS ).lower<std::vector>();
+    BOOST_CHECK( treeGroups == sortedGroups );
+    
+    std::vector<std::pair<Colour, std::string>> things { { BLUE, "sky" }, { RED, "rose" }, { BLUE, "sea" } };
+    auto byColour = lift(things).groupBy(
+        []( const std::pair<Colour, std::string>& p ) { return p.first; },
+        []( const std::pair<Colour, std::string>& p ) { return p.second; }, UNSORTED_KEYS ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( byColour.size(), 2 );
+    BOOST_CHECK_EQUAL( byColour[0].first, BLUE );
+    CHECK_SAME_ELEMENTS( byColour[0].second, std::vector<std::string> { "sky", "sea" } );
+    BOOST_CHECK_EQUAL( byColour[1].first, RED );
+    
+    // Table growth with pair keys
+    DenseHashIndex<std::pair<int, int>> index;
+    for ( int i = 0; i < 100000; ++i ) index.insert( std::make_pair( i % 50000, 0 ) );
+    BOOST_CHECK_EQUAL( index.size(), 50000 );
+    BOOST_CHECK_EQUAL( index.insert( std::make_pair( 49999, 0 ) ).first, 49999 );
+    BOOST_CHECK( index.insert( std::make_pair( 50000, 0 ) ).second );
+}
+
+void testLazyDistinct()
+{
+    std::vector<int> a;
+    for ( int i = 0; i < 10000; ++i ) a.push_back( i % 7 );
+    
+    // Only as much input as needed is read
+    int pulled = 0;
+    auto counted = [&pulled]( int v ) { pulled++; return v; };
+    CHECK_SAME_ELEMENTS( lift(a).map( counted ).distinct().take(3).lower<std::vector>(), std::vector<int> { 0, 1, 2 } );
+    BOOST_CHECK( pulled <= 4 );
+    
+    std::stringstream lines;
+    lines << "b\na\nb\nc\na\n";
+    for ( int i = 0; i < 100; ++i ) lines << i << "\n";
+    CHECK_SAME_ELEMENTS( lift(lines).distinct().take(3).lower<std::vector>(), std::vector<std::string> { "b", "a", "c" } );
+    BOOST_CHECK( lift(lines).count() >= 95 );
+    
+    // Fully drained, via push and pull
+    CHECK_SAME_ELEMENTS( lift(a).distinct().lower<std::vector>(), std::vector<int> { 0, 1, 2, 3, 4, 5, 6 } );
+    auto distinctIt = lift(a).distinct();
+    std::vector<int> pulledValues;
+    while ( distinctIt.hasNext() ) pulledValues.push_back( distinctIt.next() );
+    CHECK_SAME_ELEMENTS( pulledValues, std::vector<int> { 0, 1, 2, 3, 4, 5, 6 } );
+    
+    // Keyed, with hashable and ordered-only keys
+    std::vector<std::string> words { "apple", "avocado", "banana", "blueberry", "cherry" };
+    CHECK_SAME_ELEMENTS( lift(words).distinctBy( []( const std::string& w ) { return w[0]; } ).lower<std::vector>(),
+        std::vector<std::string> { "apple", "banana", "cherry" } );
+    CHECK_SAME_ELEMENTS( lift(words).distinctBy( []( const std::string& w ) { return std::vector<size_t> { w.size() }; } ).lower<std::vector>(),
+        std::vector<std::string> { "apple", "avocado", "banana", "blueberry" } );
+    CHECK_SAME_ELEMENTS( lift(words).distinctWith( []( const std::string& l, const std::string& r ) { return l.size() < r.size(); } ).lower<std::vector>(),
+        std::vector<std::string> { "apple", "avocado", "banana", "blueberry" } );
+}
+
+void testLazyTakeDropWhile()
+{
+    auto small = []( int v ) { return v < 5; };
+    
+    // Works on unbounded input, and reads nothing past the first failing element
+    CHECK_SAME_ELEMENTS( counter().takeWhile( small ).lower<std::vector>(), std::vector<int> { 0, 1, 2, 3, 4 } );
+    
+    int pulled = 0;
+    auto counted = [&pulled]( int v ) { pulled++; return v; };
+    BOOST_CHECK_EQUAL( counter().map( counted ).takeWhile( small ).count(), 5U );
+    BOOST_CHECK_EQUAL( pulled, 6 );
+    
+    pulled = 0;
+    auto taken = counter().map( counted ).takeWhile( small );
+    BOOST_CHECK_EQUAL( pulled, 0 );
+    BOOST_CHECK( taken.hasNext() );
+    BOOST_CHECK_EQUAL( taken.next(), 0 );
+    BOOST_CHECK_EQUAL( pulled, 1 );
+    
+    // dropWhile streams the remainder
+    CHECK_SAME_ELEMENTS( counter().dropWhile( small ).take(3).lower<std::vector>(), std::vector<int> { 5, 6, 7 } );
+    
+    std::vector<int> a { 1, 2, 7, 3, 8 };
+    CHECK_SAME_ELEMENTS( lift(a).takeWhile( small ).lower<std::vector>(), std::vector<int> { 1, 2 } );
+    CHECK_SAME_ELEMENTS( lift(a).dropWhile( small ).lower<std::vector>(), std::vector<int> { 7, 3, 8 } );
+    
+    // Pull and push agree
+    auto dropped = lift(a).dropWhile( small );
+    std::vector<int> pulledValues;
+    while ( dropped.hasNext() ) pulledValues.push_back( dropped.next() );
+    CHECK_SAME_ELEMENTS( pulledValues, std::vector<int> { 7, 3, 8 } );
+    
+    auto partlyPulled = lift(a).dropWhile( small );
+    BOOST_CHECK_EQUAL( partlyPulled.next(), 7 );
+    CHECK_SAME_ELEMENTS( partlyPulled.lower<std::vector>(), std::vector<int> { 3, 8 } );
+    
+    std::stringstream lines;
+    lines << "# header\n# more\nx\n# not header\ny\n";
+    auto isComment = []( const std::string& l ) { return !l.empty() && l[0] == '#'; };
+    CHECK_SAME_ELEMENTS( lift(lines).dropWhile( isComment ).lower<std::vector>(), std::vector<std::string> { "x", "# not header", "y" } );
+    
+    // Edge cases
+    std::vector<int> empty;
+    BOOST_CHECK_EQUAL( lift(empty).takeWhile( small ).count(), 0U );
+    BOOST_CHECK_EQUAL( lift(empty).dropWhile( small ).count(), 0U );
+    
+    std::vector<int> allSmall { 1, 2, 3 };
+    CHECK_SAME_ELEMENTS( lift(allSmall).takeWhile( small ).lower<std::vector>(), allSmall );
+    BOOST_CHECK_EQUAL( lift(allSmall).dropWhile( small ).count(), 0U );
+    
+    std::vector<int> allLarge { 9, 8 };
+    BOOST_CHECK_EQUAL( lift(allLarge).takeWhile( small ).count(), 0U );
+    CHECK_SAME_ELEMENTS( lift(allLarge).dropWhile( small ).lower<std::vector>(), allLarge );
+}
+
+void testEarlyTermination()
+{
+    std::vector<int> a;
+    for ( int i = 0; i < 1000; ++i ) a.push_back( i );
+    
+    auto isSeven = []( int v ) { return v == 7; };
+    
+    // Searches stop reading as soon as they have an answer
+    int pulled = 0;
+    auto counted = [&pulled]( int v ) { pulled++; return v; };
+    BOOST_CHECK( lift(a).map( counted ).exists( isSeven ) );
+    BOOST_CHECK_EQUAL( pulled, 8 );
+    
+    pulled = 0;
+    BOOST_CHECK( !lift(a).map( counted ).forall( []( int v ) { return v < 3; } ) );
+    BOOST_CHECK_EQUAL( pulled, 4 );
+    
+    // Plus the filter's look-ahead to its next match, 9
+    pulled = 0;
+    BOOST_CHECK_EQUAL( lift(a).map( counted ).filter( []( int v ) { return v % 2 == 1; } ).find( isSeven ).get(), 7 );
+    BOOST_CHECK_EQUAL( pulled, 10 );
+    
+    pulled = 0;
+    BOOST_CHECK_EQUAL( lift(a).map( counted ).take( 5 ).count(), 5U );
+    BOOST_CHECK_EQUAL( pulled, 5 );
+    
+    pulled = 0;
+    BOOST_CHECK_EQUAL( lift(a).map( counted ).takeWhile( []( int v ) { return v < 5; } ).count(), 5U );
+    BOOST_CHECK_EQUAL( pulled, 6 );
+    
+    // Including over unbounded input, and through flatMap and zip
+    BOOST_CHECK_EQUAL( counter().find( []( int v ) { return v * v > 1000; } ).get(), 32 );
+    BOOST_CHECK_EQUAL( counter().indexWhere( isSeven ).get(), 7U );
+    BOOST_CHECK( counter().contains( 100 ) );
+    BOOST_CHECK_EQUAL( counter().drop( 10 ).take( 3 ).sum(), 33 );
+    
+    std::vector<std::vector<int>> rows( 100, std::vector<int> { 1, 2, 3 } );
+    auto liftRow = []( const std::vector<int>& row ) { return lift(row); };
+    pulled = 0;
+    auto countedRow = [&pulled, &liftRow]( const std::vector<int>& row ) { pulled++; return liftRow( row ); };
+    BOOST_CHECK( lift_cref(rows).map( countedRow ).flatMap( []( int v ) { return v; } ).zipWithIndex()
+        .exists( []( const std::pair<int, size_t>& p ) { return p.second == 7; } ) );
+    BOOST_CHECK_EQUAL( pulled, 3 );
+    
+    auto zipped = counter().zip( counter().map( []( int v ) { return v * 2; } ) );
+    BOOST_CHECK( zipped.find( []( const std::pair<int, int>& p ) { return p.second == 20; } ).get() == std::make_pair( 10, 20 ) );
+    
+    // Results
+    BOOST_CHECK_EQUAL( lift(a).headOption().get(), 0 );
+    BOOST_CHECK_EQUAL( lift(a).indexWhere( []( int v ) { return v > 500; } ).get(), 501U );
+    BOOST_CHECK( lift(a).contains( 999 ) );
+    BOOST_CHECK( !lift(a).contains( 1000 ) );
+    BOOST_CHECK( !lift(a).find( []( int v ) { return v < 0; } ) );
+    BOOST_CHECK( !lift(a).indexWhere( []( int v ) { return v < 0; } ) );
+    
+    std::vector<std::string> empty;
+    BOOST_CHECK( !lift(empty).headOption() );
+    BOOST_CHECK( !lift(empty).exists( []( const std::string& ) { return true; } ) );
+    BOOST_CHECK( lift(empty).forall( []( const std::string& ) { return false; } ) );
+    
+    std::istringstream lines( "x\ny\nneedle\nz\n" );
+    BOOST_CHECK_EQUAL( lift(lines).indexWhere( []( const std::string& l ) { return l == "needle"; } ).get(), 2U );
+    
+    // A stopped push leaves the rest to be pulled
+    {
+        auto filtered = lift(a).filter( []( int v ) { return v % 3 == 0; } );
+        std::vector<int> pushed;
+        BOOST_CHECK( !filtered.pushAll( [&pushed]( int v ) { pushed.push_back( v ); return pushed.size() < 2; } ) );
+        CHECK_SAME_ELEMENTS( pushed, std::vector<int> { 0, 3 } );
+        BOOST_CHECK_EQUAL( filtered.next(), 6 );
+    }
+    
+    {
+        std::vector<std::vector<int>> d = { { 1, 2, 3 }, { 4, 5 } };
+        auto flat = lift_cref(d).map( liftRow ).flatMap( []( int v ) { return v * 10; } );
+        std::vector<int> pushed;
+        BOOST_CHECK( !flat.pushAll( [&pushed]( int v ) { pushed.push_back( v ); return v != 20; } ) );
+        CHECK_SAME_ELEMENTS( pushed, std::vector<int> { 10, 20 } );
+        CHECK_SAME_ELEMENTS( flat.lower<std::vector>(), std::vector<int> { 30, 40, 50 } );
+    }
+    
+    // foreach sees everything whatever its functor returns
+    int seen = 0;
+    lift(a).foreach( [&seen]( int ) { seen++; return false; } );
+    BOOST_CHECK_EQUAL( seen, 1000 );
+    
+    // Parallel searches
+    std::vector<int> big;
+    for ( int i = 0; i < 100000; ++i ) big.push_back( i % 1000 );
+    auto late = []( int v ) { return v > 990; };
+    BOOST_CHECK_EQUAL( lift(big).par(4).find( late ).get(), 991 );
+    BOOST_CHECK_EQUAL( lift(big).par(4).map( []( int v ) { return v + 1; } ).find( late ).get(), 991 );
+    BOOST_CHECK( !lift(big).par(4).find( []( int v ) { return v < 0; } ) );
+    BOOST_CHECK( lift(big).par(4).contains( 999 ) );
+    BOOST_CHECK( !lift(big).par(4).contains( 1000 ) );
+}
+
+void testQuantiles()
+{
+    std::vector<double> samples;
+    uint32_t h = 7;
+    for ( int i = 0; i < 10001; ++i ) samples.push_back( static_cast<double>( ( h = h * 1103515245u + 12345u ) >> 8 ) );
+    
+    std::vector<double> sorted = samples;
+    std::sort( sorted.begin(), sorted.end() );
+    
+    // Selection agrees with reading from a full sort
+    BOOST_CHECK_EQUAL( lift(samples).median(), sorted[5000] );
+    BOOST_CHECK_EQUAL( lift(samples).drop(1).median(), lift(samples).drop(1).sort().drop(4999).take(2).sum() / 2.0 );
+    
+    std::vector<double> qs = lift(samples).quantiles( { 0.0, 0.5, 0.9, 0.99, 1.0 } );
+    CHECK_SAME_ELEMENTS( qs, std::vector<double> { sorted[0], sorted[5000], sorted[9000], sorted[9900], sorted[10000] } );
+    BOOST_CHECK_EQUAL( lift(samples).quantiles( { 0.5 } )[0], lift(samples).median() );
+    
+    // In the order asked for, interpolating between ranks
+    std::vector<int> small { 40, 10, 30, 20 };
+    CHECK_SAME_ELEMENTS( lift(small).quantiles( { 1.0, 0.0, 0.5, 0.25 } ), std::vector<double> { 40, 10, 25, 17.5 } );
+    BOOST_CHECK_EQUAL( lift(small).median(), 25 );
+    
+    std::vector<double> one { 3.5 };
+    CHECK_SAME_ELEMENTS( lift(one).quantiles( { 0.0, 0.3, 1.0 } ), std::vector<double> { 3.5, 3.5, 3.5 } );
+    BOOST_CHECK( lift(one).quantiles( {} ).empty() );
+    
+    std::vector<double> empty;
+    BOOST_CHECK_THROW( lift(empty).median(), std::runtime_error );
+    BOOST_CHECK_THROW( lift(empty).quantiles( { 0.5 } ), std::runtime_error );
+    BOOST_CHECK_THROW( lift(one).quantiles( { 1.5 } ), std::runtime_error );
+}
+
+void testQuantileSketch()
+{
+    std::vector<double> samples;
+    uint32_t h = 11;
+    for ( int i = 0; i < 200000; ++i ) samples.push_back( static_cast<double>( ( h = h * 1103515245u + 12345u ) >> 8 ) );
+    
+    std::vector<double> sorted = samples;
+    std::sort( sorted.begin(), sorted.end() );
+    
+    // Within the rank error of the exact answer
+    auto rankOf = [&sorted]( double v ) { return static_cast<double>( std::lower_bound( sorted.begin(), sorted.end(), v ) - sorted.begin() ) / sorted.size(); };
+    std::vector<double> ps { 0.01, 0.25, 0.5, 0.9, 0.99 };
+    
+    std::vector<double> approx = lift(samples).approxQuantiles( ps, 0.01 );
+    for ( size_t i = 0; i < ps.size(); ++i ) BOOST_CHECK_SMALL( rankOf( approx[i] ) - ps[i], 0.01 );
+    
+    std::vector<double> parApprox = lift(samples).par(4).approxQuantiles( ps, 0.01 );
+    for ( size_t i = 0; i < ps.size(); ++i ) BOOST_CHECK_SMALL( rankOf( parApprox[i] ) - ps[i], 0.01 );
+    
+    // Merging sketches of each half
+    auto first = lift(samples).take( 100000 ).quantileSketch( 0.01 );
+    auto second = lift(samples).drop( 100000 ).quantileSketch( 0.01 );
+    first.merge( second );
+    BOOST_CHECK_EQUAL( first.count(), samples.size() );
+    BOOST_CHECK_SMALL( rankOf( first.quantile( 0.5 ) ) - 0.5, 0.01 );
+    QuantileSketch<double> coarse( 0.1 );
+    coarse.insert( 1.0 );
+    BOOST_CHECK_THROW( first.merge( coarse ), std::runtime_error );
+    
+    // Differently seeded sketches make different choices when they compact
+    QuantileSketch<double> seeded1( 0.01, std::less<double>(), 1 );
+    QuantileSketch<double> seeded2( 0.01, std::less<double>(), 2 );
+    for ( double v : samples )
+    {
+        seeded1.insert( v );
+        seeded2.insert( v );
+    }
+    BOOST_CHECK( seeded1.quantiles( ps ) != seeded2.quantiles( ps ) );
+    
+    // Memory doesn't grow with the input
+    int i = 0;
+    auto sketch = lift_generic( [&i]() { return i < 2000000; }, [&i]() { return i++ % 1000; } ).quantileSketch( 0.01 );
+    BOOST_CHECK_EQUAL( sketch.count(), 2000000U );
+    BOOST_CHECK( sketch.retained() < 1000 );
+    BOOST_CHECK_SMALL( sketch.quantile( 0.5 ) - 500.0, 10.0 );
+    
+    // Small inputs are exact
+    std::vector<int> small { 5, 1, 4, 2, 3 };
+    CHECK_SAME_ELEMENTS( lift(small).approxQuantiles( { 0.0, 0.5, 1.0 } ), std::vector<int> { 1, 3, 5 } );
+    
+    std::istringstream lines( "pear\napple\nfig\n" );
+    BOOST_CHECK_EQUAL( lift(lines).quantileSketch().quantile( 0.5 ), "fig" );
+    
+    std::vector<double> empty;
+    BOOST_CHECK_THROW( lift(empty).approxQuantiles( { 0.5 } ), std::runtime_error );
+    BOOST_CHECK_THROW( lift(small).approxQuantiles( { 0.5 }, 0.0 ), std::runtime_error );
+}
+
+void testStats()
+{
+    std::vector<double> a { 4.0, 7.0, 13.0, 16.0, 1.0, 16.0, 1.0 };
+    
+    auto s = lift(a).stats();
+    BOOST_CHECK_EQUAL( s.count(), 7U );
+    BOOST_CHECK_EQUAL( s.sum(), 58.0 );
+    BOOST_CHECK_CLOSE( s.mean(), 58.0 / 7.0, 1e-9 );
+    BOOST_CHECK( s.argMin() == std::make_pair( size_t(4), 1.0 ) );
+    BOOST_CHECK( s.argMax() == std::make_pair( size_t(3), 16.0 ) );
+    BOOST_CHECK( s.argMin() == lift(a).argMin() );
+    BOOST_CHECK( s.argMax() == lift(a).argMax() );
+    
+    double m = 58.0 / 7.0;
+    double ss = lift(a).fold( 0.0, [m]( double acc, double v ) { return acc + ( v - m ) * ( v - m ); } );
+    BOOST_CHECK_CLOSE( s.variance(), ss / 7.0, 1e-9 );
+    BOOST_CHECK_CLOSE( s.sampleVariance(), ss / 6.0, 1e-9 );
+    BOOST_CHECK_CLOSE( s.stddev(), std::sqrt( ss / 7.0 ), 1e-9 );
+    
+    // Small spreads around large values, where summing squares cancels
+    std::vector<double> offset { 1e9 + 4, 1e9 + 7, 1e9 + 13, 1e9 + 16 };
+    BOOST_CHECK_CLOSE( lift(offset).stats().variance(), 22.5, 1e-6 );
+    BOOST_CHECK_CLOSE( lift(offset).stats().sampleVariance(), 30.0, 1e-6 );
+    
+    // Merging consecutive parts gives the stats of the whole
+    auto first = lift(a).take( 3 ).stats();
+    first.merge( lift(a).drop( 3 ).stats() );
+    BOOST_CHECK_EQUAL( first.count(), s.count() );
+    BOOST_CHECK_CLOSE( first.variance(), s.variance(), 1e-9 );
+    BOOST_CHECK( first.argMin() == s.argMin() );
+    BOOST_CHECK( first.argMax() == s.argMax() );
+    
+    std::vector<int> big;
+    for ( int i = 0; i < 100000; ++i ) big.push_back( ( i * 7919 ) % 1000 );
+    auto seq = lift(big).stats();
+    auto par = lift(big).par(4).stats();
+    BOOST_CHECK_EQUAL( seq.sum(), par.sum() );
+    BOOST_CHECK_EQUAL( seq.sum(), lift(big).sum() );
+    BOOST_CHECK_CLOSE( seq.mean(), par.mean(), 1e-9 );
+    BOOST_CHECK_CLOSE( seq.variance(), par.variance(), 1e-9 );
+    BOOST_CHECK( seq.argMin() == par.argMin() );
+    BOOST_CHECK( seq.argMax() == par.argMax() );
+    
+    // Works on single-shot input
+    std::istringstream lines( "3\n1\n2\n" );
+    auto fromStream = lift(lines).map( []( const std::string& l ) { return std::stoi( l ); } ).stats();
+    BOOST_CHECK_EQUAL( fromStream.max(), 3 );
+    BOOST_CHECK_EQUAL( fromStream.mean(), 2.0 );
+    
+    std::vector<double> empty;
+    BOOST_CHECK_EQUAL( lift(empty).stats().count(), 0U );
+    BOOST_CHECK_THROW( lift(empty).stats().mean(), std::runtime_error );
+    BOOST_CHECK_THROW( lift(empty).stats().min(), std::runtime_error );
+}
+
+// A user-defined aggregator: the longest run of equal elements
+class LongestRun
+{
+public:
+    typedef size_t result_type;
+    
+    LongestRun() : m_last(-1), m_run(0), m_longest(0) {}
+    
+    void insert( int v )
+    {
+        m_run = ( v == m_last ) ? m_run + 1 : 1;
+        m_last = v;
+        m_longest = std::max( m_longest, m_run );
+    }
+    
+    result_type result() const { return m_longest; }
+    
+private:
+    int     m_last;
+    size_t  m_run;
+    size_t  m_longest;
+};
+
+void testAggregate()
+{
+    std::vector<int> a { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5 };
+    
+    size_t count;
+    int total;
+    boost::optional<int> smallest, largest;
+    std::tie( count, total, smallest, largest ) = lift(a).aggregate( agg::count(), agg::sum(), agg::min(), agg::max() );
+    BOOST_CHECK_EQUAL( count, a.size() );
+    BOOST_CHECK_EQUAL( total, lift(a).sum() );
+    BOOST_CHECK_EQUAL( smallest.get(), 1 );
+    BOOST_CHECK_EQUAL( largest.get(), 9 );
+    
+    // Folds, countBy, stats, sketches and user aggregators alongside each other
+    auto parity = []( int v ) { return v % 2; };
+    auto product = []( int64_t acc, int v ) { return acc * v; };
+    std::vector<int> runs { 1, 1, 2, 2, 2, 3 };
+    auto results = lift(runs).aggregate( agg::fold( int64_t(1), product ), agg::countBy( parity ), agg::stats(), agg::quantileSketch(), LongestRun() );
+    BOOST_CHECK_EQUAL( std::get<0>( results ), 24 );
+    BOOST_CHECK( std::get<1>( results ) == ( std::vector<std::pair<int, size_t>> { { 0, 3 }, { 1, 3 } } ) );
+    BOOST_CHECK_CLOSE( std::get<2>( results ).mean(), 11.0 / 6.0, 1e-9 );
+    BOOST_CHECK_EQUAL( std::get<3>( results ).quantile( 1.0 ), 3 );
+    BOOST_CHECK_EQUAL( std::get<4>( results ), 3U );
+    
+    // One traversal of single-shot input
+    int parsed = 0;
+    std::istringstream lines( "10\n20\n30\n" );
+    auto parse = [&parsed]( const std::string& l ) { parsed++; return std::stoi( l ); };
+    auto fromStream = lift(lines).map( parse ).aggregate( agg::sum(), agg::max(), agg::count() );
+    BOOST_CHECK( fromStream == std::make_tuple( 60, boost::optional<int>( 30 ), size_t(3) ) );
+    BOOST_CHECK_EQUAL( parsed, 3 );
+    
+    // Empty input
+    std::vector<int> empty;
+    auto none = lift(empty).aggregate( agg::count(), agg::sum(), agg::min() );
+    BOOST_CHECK( none == std::make_tuple( size_t(0), 0, boost::optional<int>() ) );
+    
+    // In parallel, merging per-chunk aggregators in order
+    std::vector<int> big;
+    for ( int i = 0; i < 100000; ++i ) big.push_back( ( i * 7919 ) % 1000 );
+    auto plus = []( int64_t acc, int v ) { return acc + v; };
+    auto combine = []( int64_t l, int64_t r ) { return l + r; };
+    auto seq = lift(big).aggregate( agg::count(), agg::sum(), agg::max(), agg::countBy( parity, UNSORTED_KEYS ), agg::fold( int64_t(0), plus, combine ) );
+    auto par = lift(big).par(4).aggregate( agg::count(), agg::sum(), agg::max(), agg::countBy( parity, UNSORTED_KEYS ), agg::fold( int64_t(0), plus, combine ) );
+    BOOST_CHECK( seq == par );
+    BOOST_CHECK_EQUAL( std::get<4>( par ), static_cast<int64_t>( lift(big).sum() ) );
+}
+
+// Integer reductions are exact; floating point sums are reassociated
+template<typename T>
+void checkReduced( T vectorised, T sequential, std::true_type )
+{
+    BOOST_CHECK_EQUAL( vectorised, sequential );
+}
+
+template<typename T>
+void checkReduced( T vectorised, T sequential, std::false_type )
+{
+    BOOST_CHECK_CLOSE( vectorised, sequential, 1e-3 );
+}
+
+template<typename T>
+void checkContiguousReductions( const std::vector<T>& v )
+{
+    // Mapping through identity takes the element-by-element path
+    auto scalar = [&v]() { return lift(v).map( []( T x ) { return x; } ); };
+    
+    BOOST_CHECK( lift(v).argMin() == scalar().argMin() );
+    BOOST_CHECK( lift(v).argMax() == scalar().argMax() );
+    BOOST_CHECK_EQUAL( lift(v).count( []( T x ) { return x > T(10); } ), scalar().count( []( T x ) { return x > T(10); } ) );
+    if ( v.empty() ) return;
+    
+    checkReduced( lift(v).sum(), scalar().sum(), std::is_integral<T>() );
+    checkReduced( lift(v).mean(), scalar().mean(), std::is_integral<T>() );
+}
+
+void testContiguousReductions()
+{
+    // Every length up to a few vectors' worth exercises the partial tails
+    for ( size_t n = 0; n < 70; ++n )
+    {
+        std::vector<int> ints;
+        std::vector<int64_t> longs;
+        std::vector<float> floats;
+        std::vector<double> doubles;
+        for ( size_t i = 0; i < n; ++i )
+        {
+            int x = static_cast<int>( ( i * 7919 ) % 23 ) - 5;
+            ints.push_back( x );
+            longs.push_back( int64_t(x) * ( int64_t(1) << 33 ) );
+            floats.push_back( x * 0.5f );
+            doubles.push_back( x * 0.25 );
+        }
+        checkContiguousReductions( ints );
+        checkContiguousReductions( longs );
+        checkContiguousReductions( floats );
+        checkContiguousReductions( doubles );
+    }
+    
+    // The first extremal element wins
+    std::vector<int> ties { 4, 1, 7, 1, 7, 3, 1, 7, 2, 5, 6, 0, 9, 9, 8, 0, 3, 9, 0 };
+    BOOST_CHECK( lift(ties).argMin() == std::make_pair( size_t(11), 0 ) );
+    BOOST_CHECK( lift(ties).argMax() == std::make_pair( size_t(12), 9 ) );
+    BOOST_CHECK_EQUAL( lift(ties).min(), 0 );
+    BOOST_CHECK_EQUAL( lift(ties).max(), 9 );
+    
+    // Empty input keeps its semantics
+    std::vector<double> empty;
+    BOOST_CHECK( lift(empty).argMin() == std::make_pair( size_t(0), 0.0 ) );
+    BOOST_CHECK_THROW( lift(empty).sum(), std::runtime_error );
+    BOOST_CHECK_THROW( lift(empty).mean(), std::runtime_error );
+    
+    // NaNs compare as a sequential loop would
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> laterNan { 5.0, nan, 7.0, 8.0, 9.0, 1.0, 6.0, 2.0, nan, 3.0 };
+    BOOST_CHECK( lift(laterNan).argMin() == std::make_pair( size_t(5), 1.0 ) );
+    BOOST_CHECK( lift(laterNan).argMax() == std::make_pair( size_t(4), 9.0 ) );
+    BOOST_CHECK( std::isnan( lift(laterNan).sum() ) );
+    std::vector<double> firstNan { nan, 5.0, 1.0, 7.0, 8.0, 9.0, 6.0, 2.0, 3.0 };
+    BOOST_CHECK_EQUAL( lift(firstNan).argMin().first, 0U );
+    BOOST_CHECK( std::isnan( lift(firstNan).max() ) );
+    
+    // Large inputs
+    std::vector<int> big;
+    for ( int i = 0; i < 100003; ++i ) big.push_back( ( i * 7919 ) % 100000 - 50000 );
+    checkContiguousReductions( big );
+}
+
+// A file holding the given text, removed again on destruction
+class TempFile
+{
+public:
+    TempFile( const std::string& text )
+    {
+        char path[] = "/tmp/escalatortestXXXXXX";
+        int fd = mkstemp( path );
+        BOOST_REQUIRE( fd >= 0 );
+        close( fd );
+        m_path = path;
+        
+        std::ofstream out( m_path, std::ios::binary );
+        out << text;
+    }
+    
+    ~TempFile() { std::remove( m_path.c_str() ); }
+    
+    const std::string& path() const { return m_path; }
+    
+private:
+    std::string m_path;
+};
+
+void testMmapLines()
+{
+    // Split exactly as getline splits, including empty and unterminated lines
+    std::vector<std::string> texts { "", "\n", "a", "a\n", "alpha\nbeta\n\ngamma", "alpha\nbeta\n\ngamma\n", "\n\nx\r\n" };
+    for ( const std::string& text : texts )
+    {
+        TempFile file( text );
+        std::istringstream lines( text );
+        std::vector<std::string> expected = lift(lines).lower<std::vector>();
+        
+        auto mapped = lift_mmap_lines( file.path() );
+        std::vector<std::string> viewed = mapped.map( []( StringView l ) { return l.str(); } ).lower<std::vector>();
+        BOOST_CHECK( viewed == expected );
+        BOOST_CHECK_EQUAL( lift_mmap_lines( file.path(), DEFAULT_ACCESS ).count(), expected.size() );
+    }
+    
+    TempFile file( "pear\napple\nfig\napple\n" );
+    
+    // Views compare, sort, hash and print like the strings they view
+    auto lines = lift_mmap_lines( file.path() );
+    BOOST_CHECK_EQUAL( lines.mkString( "," ), "pear,apple,fig,apple" );
+    BOOST_CHECK_EQUAL( lift_mmap_lines( file.path() ).sort().mkString( "," ), "apple,apple,fig,pear" );
+    BOOST_CHECK_EQUAL( lift_mmap_lines( file.path() ).distinct().count(), 3U );
+    BOOST_CHECK( lift_mmap_lines( file.path() ).contains( std::string( "fig" ) ) );
+    std::vector<size_t> lengths = lift_mmap_lines( file.path() ).map( []( const std::string& l ) { return l.size(); } ).lower<std::vector>();
+    BOOST_CHECK( lengths == ( std::vector<size_t> { 4, 5, 3, 5 } ) );
+    
+    // Collected lines are copied out, and outlive the mapping
+    std::vector<std::string> lowered = lift_mmap_lines( file.path() ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( lowered.size(), 4U );
+    BOOST_CHECK_EQUAL( lowered[1], "apple" );
+    auto sorted = lift_mmap_lines( file.path() ).sort();
+    BOOST_CHECK_EQUAL( sorted.mkString( "," ), "apple,apple,fig,pear" );
+    auto grouped = lift_mmap_lines( file.path() ).groupBy( []( StringView l ) { return l; }, []( StringView l ) { return l.size(); }, UNSORTED_KEYS ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( grouped.size(), 3U );
+    BOOST_CHECK_EQUAL( grouped[1].first, "apple" );
+    BOOST_CHECK_EQUAL( lift_mmap_lines( file.path() ).max(), "pear" );
+    
+    // Copies share the mapping, which outlives the wrapper they came from
+    auto rest = lift_mmap_lines( file.path() ).drop( 2 );
+    BOOST_CHECK_EQUAL( rest.mkString( "," ), "fig,apple" );
+    
+    // A push stopped early resumes after the element it stopped at
+    auto partial = lift_mmap_lines( file.path() );
+    BOOST_CHECK( !partial.pushAll( []( StringView l ) { return l != StringView( "apple" ); } ) );
+    BOOST_CHECK_EQUAL( partial.next(), StringView( "fig" ) );
+    BOOST_CHECK( lift_mmap_lines( file.path() ).exists( []( StringView l ) { return l == StringView( "fig" ); } ) );
+    
+    BOOST_CHECK_THROW( lift_mmap_lines( "/nonexistent/escalator/file" ), std::runtime_error );
+}
+
+// Feeds text into a pipe from another thread, in pieces of the given size
+class PipeFeeder
+{
+public:
+    PipeFeeder( const std::string& text, size_t piece ) : m_text(text)
+    {
+        int fds[2];
+        BOOST_REQUIRE( pipe( fds ) == 0 );
+        m_readFd = fds[0];
+        int writeFd = fds[1];
+        m_writer = std::thread( [this, writeFd, piece]()
+        {
+            for ( size_t i = 0; i < m_text.size(); i += piece )
+            {
+                size_t n = std::min( piece, m_text.size() - i );
+                if ( write( writeFd, m_text.data() + i, n ) != static_cast<ssize_t>( n ) ) break;
+            }
+            close( writeFd );
+        } );
+    }
+    
+    ~PipeFeeder()
+    {
+        m_writer.join();
+        close( m_readFd );
+    }
+    
+    int fd() const { return m_readFd; }
+    
+private:
+    std::string m_text;
+    int         m_readFd;
+    std::thread m_writer;
+};
+
+void testFdRecords()
+{
+    // Records longer than the chunks, and than their headroom, with and
+    // without read-ahead, split exactly as getline splits
+    std::string text;
+    for ( int i = 0; i < 300; ++i ) text += std::string( ( i * 7 ) % 41, 'a' + i % 26 ) + ( i % 50 == 0 ? "\n\n" : "\n" );
+    text += "unterminated";
+    std::istringstream lines( text );
+    std::vector<std::string> expected = lift(lines).lower<std::vector>();
+    
+    for ( ReadAhead readAhead : { BACKGROUND_READ_AHEAD, NO_READ_AHEAD } )
+    {
+        for ( size_t chunkSize : { size_t(1), size_t(16), size_t(100), size_t(1 << 20) } )
+        {
+            PipeFeeder feeder( text, 37 );
+            std::vector<std::string> read = lift_fd_records( feeder.fd(), '\n', readAhead, chunkSize )
+                .map( []( StringView r ) { return r.str(); } ).lower<std::vector>();
+            BOOST_CHECK( read == expected );
+        }
+        
+        // Views survive stages that look one element ahead
+        PipeFeeder feeder( text, 64 );
+        auto longOnes = lift_fd_records( feeder.fd(), '\n', readAhead, 16 ).filter( []( StringView r ) { return r.size() > 30; } );
+        std::vector<std::string> filtered = longOnes.map( []( StringView r ) { return r.str(); } ).lower<std::vector>();
+        BOOST_CHECK( filtered == lift(expected).filter( []( const std::string& r ) { return r.size() > 30; } ).lower<std::vector>() );
+    }
+    
+    // A record many chunks long, between short ones
+    std::string longRecord( 100000, 'z' );
+    for ( ReadAhead readAhead : { BACKGROUND_READ_AHEAD, NO_READ_AHEAD } )
+    {
+        PipeFeeder feeder( "a\n" + longRecord + "\nb\n" + longRecord + longRecord + "\nc", 4096 );
+        std::vector<size_t> sizes = lift_fd_records( feeder.fd(), '\n', readAhead, 64 )
+            .map( []( StringView r ) { return r.size(); } ).lower<std::vector>();
+        BOOST_CHECK( sizes == ( std::vector<size_t> { 1, 100000, 1, 200000, 1 } ) );
+    }
+    
+    // Collecting operations keep copies, not views into reused buffers
+    std::string repeated;
+    for ( int i = 0; i < 2000; ++i ) repeated += "value" + std::to_string( i % 1000 ) + "\n";
+    TempFile repeats( repeated );
+    BOOST_CHECK_EQUAL( lift_file_records( repeats.path(), '\n', NO_READ_AHEAD, 64 ).distinct().count(), 1000U );
+    BOOST_CHECK_EQUAL( lift_file_records( repeats.path(), '\n', BACKGROUND_READ_AHEAD, 64 ).distinct().count(), 1000U );
+    std::vector<std::string> collected = lift_file_records( repeats.path(), '\n', NO_READ_AHEAD, 64 ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( collected.size(), 2000U );
+    BOOST_CHECK_EQUAL( collected[0], "value0" );
+    BOOST_CHECK_EQUAL( collected[1999], "value999" );
+    BOOST_CHECK_EQUAL( lift_file_records( repeats.path(), '\n', NO_READ_AHEAD, 64 ).sort().take( 3 ).mkString( "," ), "value0,value0,value1" );
+
+    // As do aggregators
+    std::string keyed;
+    for ( int i = 0; i < 200; ++i ) keyed += std::string( "key" ) + char( 'a' + i % 3 ) + "\n";
+    for ( ReadAhead readAhead : { BACKGROUND_READ_AHEAD, NO_READ_AHEAD } )
+    {
+        PipeFeeder feeder( keyed, 50 );
+        auto aggregated = lift_fd_records( feeder.fd(), '\n', readAhead, 16 )
+            .aggregate( agg::countBy( []( const StringView& s ) { return s; } ), agg::min(), agg::max() );
+        typedef std::vector<std::pair<std::string, size_t>> counts_t;
+        BOOST_CHECK( std::get<0>( aggregated ) == ( counts_t { { "keya", 67 }, { "keyb", 67 }, { "keyc", 66 } } ) );
+        BOOST_CHECK_EQUAL( std::get<1>( aggregated ).get(), "keya" );
+        BOOST_CHECK_EQUAL( std::get<2>( aggregated ).get(), "keyc" );
+    }
+
+    // Other delimiters, and files
+    TempFile file( "a,bb,,ccc," );
+    BOOST_CHECK_EQUAL( lift_file_records( file.path(), ',' ).mkString( "|" ), "a|bb||ccc" );
+    BOOST_CHECK_EQUAL( lift_file_records( file.path(), ';', NO_READ_AHEAD ).count(), 1U );
+    TempFile empty( "" );
+    BOOST_CHECK_EQUAL( lift_file_records( empty.path() ).count(), 0U );
+    BOOST_CHECK_THROW( lift_file_records( "/nonexistent/escalator/file" ), std::runtime_error );
+    
+    // Copies share the reader's position
+    TempFile numbers( "1\n2\n3\n4\n" );
+    auto records = lift_file_records( numbers.path() );
+    BOOST_CHECK_EQUAL( records.take( 2 ).mkString( "," ), "1,2" );
+    BOOST_CHECK_EQUAL( records.mkString( "," ), "3,4" );
+    
+    // Stopping part way through a pipe that stays open does not block
+    int fds[2];
+    BOOST_REQUIRE( pipe( fds ) == 0 );
+    BOOST_REQUIRE( write( fds[1], "x\ny\n", 4 ) == 4 );
+    BOOST_CHECK_EQUAL( lift_fd_records( fds[0] ).headOption().get(), StringView( "x" ) );
+    close( fds[0] );
+    close( fds[1] );
+}
+
+void testStringViews()
+{
+    // Fields match boost::algorithm::split, empty ones included
+    std::vector<std::string> inputs { "", ",", "a", "a,b", ",a,,b,", " 1,  2, 3;4 ;; 5 ", "no separators here" };
+    for ( const std::string& input : inputs )
+    {
+        for ( std::string splitChars : { ",", ",;" } )
+        {
+            std::vector<std::string> expected;
+            boost::algorithm::split( expected, input, boost::algorithm::is_any_of( splitChars ) );
+            
+            std::vector<std::string> fields = lift(input).split( splitChars ).map( []( StringView f ) { return f.str(); } ).lower<std::vector>();
+            BOOST_CHECK( fields == expected );
+        }
+    }
+    
+    // Fields are views into the original string
+    std::string record( " alpha , beta,gamma  " );
+    std::vector<StringView> fields;
+    lift(record).split( "," ).toContainer( std::back_inserter( fields ) );
+    BOOST_REQUIRE_EQUAL( fields.size(), 3U );
+    BOOST_CHECK( fields[1].data() == record.data() + 8 );
+    BOOST_CHECK_EQUAL( lift(fields[0]).trim().view(), StringView( "alpha" ) );
+    BOOST_CHECK( lift(fields[0]).trim().view().data() == record.data() + 1 );
+    BOOST_CHECK_EQUAL( lift(record).trim().toString(), "alpha , beta,gamma" );
+    BOOST_CHECK_EQUAL( lift( " \t\n " ).trim().view().size(), 0U );
+    
+    // Split lazily, so stopping early scans no further
+    BOOST_CHECK_EQUAL( lift(record).split( "," ).headOption().get(), StringView( " alpha " ) );
+    BOOST_CHECK_EQUAL( lift(record).split( "," ).map( []( StringView f ) { return lift(f).trim().view(); } ).mkString( "|" ), "alpha|beta|gamma" );
+    
+    // A field at a time, parsed in place
+    std::string numbers( " 10, 20 ,30 " );
+    int total = lift(numbers).split( "," ).map( []( StringView f )
+    {
+        StringView trimmed = lift(f).trim().view();
+        return boost::lexical_cast<int>( trimmed.data(), trimmed.size() );
+    } ).sum();
+    BOOST_CHECK_EQUAL( total, 60 );
+    
+    // Strings are iterable as characters, by reference or, for temporaries, owned
+    BOOST_CHECK_EQUAL( lift(record).filter( []( char c ) { return c == 'a'; } ).count(), 5U );
+    BOOST_CHECK_EQUAL( lift( StringView( "abc" ) ).mkString( "-" ), "a-b-c" );
+    auto owned = lift( std::string( " temp " ) );
+    BOOST_CHECK_EQUAL( owned.trim().toString(), "temp" );
+    BOOST_CHECK_EQUAL( owned.count(), 6U );
+}
+
+void testCsv()
+{
+    // The split/trim/lexical_cast chain of testStringManip, as a schema
+    std::istringstream lines( "1, 2 ,3  \n 4 ,5, 6\n7,8,9\n10,   11,12  " );
+    std::vector<int> second = lift_csv( lines, csvSchema<int>( { 1 } ) ).map( []( const std::tuple<int>& r ) { return std::get<0>( r ); } ).lower<std::vector>();
+    BOOST_CHECK( second == ( std::vector<int> { 2, 5, 8, 11 } ) );
+    
+    // Projection in any order, quoting, escaped quotes, blank lines and CRLF
+    std::string text =
+        "id,name,price,note,qty\r\n"
+        "1,apple,0.5,\"crisp, red\",10\r\n"
+        "\r\n"
+        "2,\"pear \"\"conference\"\"\",1.25,,3\r\n"
+        "3,fig,2e1,\"\",7";
+    typedef std::tuple<double, StringView, int> row_t;
+    auto schema = csvSchemaByName<double, StringView, int>( { "price", "name", "qty" } );
+    
+    std::istringstream pulled( text );
+    auto rows = lift_csv( pulled, schema );
+    std::vector<std::string> names;
+    double total = 0.0;
+    while ( rows.hasNext() )
+    {
+        row_t r = rows.next();
+        names.push_back( std::get<1>( r ).str() );
+        total += std::get<0>( r ) * std::get<2>( r );
+    }
+    BOOST_CHECK( names == ( std::vector<std::string> { "apple", "pear \"conference\"", "fig" } ) );
+    BOOST_CHECK_CLOSE( total, 5.0 + 3.75 + 140.0, 1e-9 );
+    
+    std::istringstream pushed( text );
+    auto notes = lift_csv( pushed, csvSchema<std::string, int>( { 3, 0 } ).withHeader() ).lower<std::vector>();
+    BOOST_CHECK( notes == ( std::vector<std::tuple<std::string, int>> { std::make_tuple( "crisp, red", 1 ), std::make_tuple( "", 2 ), std::make_tuple( "", 3 ) } ) );
+    
+    // Other delimiters, trimming, files and line sources of views
+    TempFile tsv( "a\t 1 \t true\n b \t-2\t0\n" );
+    auto trimmed = lift_csv_file( tsv.path(), csvSchema<std::string, int64_t, bool>().withDelimiter( '\t' ).withTrimmedFields() ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( trimmed.size(), 2U );
+    BOOST_CHECK( trimmed[1] == std::make_tuple( std::string( "b" ), int64_t(-2), false ) );
+    BOOST_CHECK_EQUAL( lift_csv( lift_mmap_lines( tsv.path() ), csvSchema<StringView>().withDelimiter( '\t' ) ).count(), 2U );
+    
+    // Malformed rows
+    auto parse = []( const std::string& csv ) { std::istringstream in( csv ); return lift_csv( in, csvSchema<int, double>( { 0, 2 } ) ).count(); };
+    BOOST_CHECK_EQUAL( parse( "1,x,2.5\n2,y,3,extra\n" ), 2U );
+    BOOST_CHECK_THROW( parse( "1,x\n" ), ParseError );
+    BOOST_CHECK_THROW( parse( "1,x,abc\n" ), ParseError );
+    BOOST_CHECK_THROW( parse( "1.5,x,2\n" ), ParseError );
+    BOOST_CHECK_THROW( parse( "1,\"x,2\n" ), ParseError );
+    BOOST_CHECK_THROW( parse( "1,\"x\"y,2\n" ), ParseError );
+    std::istringstream unnamed( "a,b\n1,2\n" );
+    BOOST_CHECK_THROW( lift_csv( unnamed, csvSchemaByName<int>( { "c" } ) ).count(), ParseError );
+    BOOST_CHECK_THROW( ( csvSchema<int, int>( { 1 } ) ), std::runtime_error );
+}
+
+void testFieldParsers()
+{
+    // Doubles agree with strtod, fast path or not
+    std::vector<std::string> numbers { "0", "-0.0", "0.1", "3.14159", ".5", "5.", "1e-5", "2.5E+3", "1e22", "1e23",
+        "123456789012345678901", "9007199254740993", "0.000000000000000000001", "1.7976931348623157e308", "4.9e-324", "inf", "-nan" };
+    for ( const std::string& n : numbers )
+    {
+        double parsed = 0.0;
+        BOOST_CHECK( FieldParser<double>::parse( StringView( n ), parsed ) );
+        double expected = std::strtod( n.c_str(), nullptr );
+        BOOST_CHECK( parsed == expected || ( std::isnan( parsed ) && std::isnan( expected ) ) );
+    }
+    for ( std::string bad : { "", " ", "1.2.3", "abc", "1e", "--1", "1,5", "0x" } )
+    {
+        double parsed;
+        BOOST_CHECK( !FieldParser<double>::parse( StringView( bad ), parsed ) );
+    }
+    
+    int i;
+    BOOST_CHECK( FieldParser<int>::parse( StringView( " 2147483647\t" ), i ) && i == std::numeric_limits<int>::max() );
+    BOOST_CHECK( FieldParser<int>::parse( StringView( "-2147483648" ), i ) && i == std::numeric_limits<int>::min() );
+    BOOST_CHECK( FieldParser<int>::parse( StringView( "+7" ), i ) && i == 7 );
+    BOOST_CHECK( !FieldParser<int>::parse( StringView( "2147483648" ), i ) );
+    BOOST_CHECK( !FieldParser<int>::parse( StringView( "1 2" ), i ) );
+    BOOST_CHECK( !FieldParser<int>::parse( StringView( "-" ), i ) );
+    unsigned u;
+    BOOST_CHECK( !FieldParser<unsigned>::parse( StringView( "-1" ), u ) );
+    BOOST_CHECK( FieldParser<unsigned>::parse( StringView( "4294967295" ), u ) && u == std::numeric_limits<unsigned>::max() );
+    int64_t l;
+    BOOST_CHECK( FieldParser<int64_t>::parse( StringView( "-9223372036854775808" ), l ) && l == std::numeric_limits<int64_t>::min() );
+}
+
+void testStringKernels()
+{
+    // Every offset and length up to a few blocks, so that both the block loops
+    // and the overlapping or byte-at-a-time tails are covered
+    const std::string alphabet( "ab ,;=\t\n" );
+    std::string text;
+    for ( size_t i = 0; i < 200; ++i ) text.push_back( alphabet[( i * 7 + i / 13 ) % alphabet.size()] );
+    text += std::string( 70, ' ' ) + "x" + std::string( 70, '\t' );
+    
+    std::vector<std::string> sets { "", ",", ",;", ",;=", ",;=\t", ",;=\tb", ",,;" };
+    std::vector<std::string> needles { "a", "ab", "b ,", ";=\t\n", "a,b", " x\t", "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t" };
+    for ( size_t begin = 0; begin < text.size(); begin += 3 )
+    {
+        for ( size_t length = 0; begin + length <= text.size() && length < 100; ++length )
+        {
+            const char* p = text.data() + begin;
+            const char* end = p + length;
+            for ( const std::string& chars : sets )
+            {
+                const char* expected = std::find_first_of( p, end, chars.begin(), chars.end() );
+                BOOST_CHECK( StringKernels::findAny( p, end, CharSet( chars.data(), chars.size() ) ) == expected );
+            }
+            for ( const std::string& needle : needles )
+            {
+                BOOST_CHECK( StringKernels::search( p, end, needle.data(), needle.size() ) == std::search( p, end, needle.begin(), needle.end() ) );
+            }
+            
+            const char* first = p;
+            while ( first != end && std::isspace( static_cast<unsigned char>( *first ) ) ) ++first;
+            BOOST_CHECK( StringKernels::skipSpace( p, end ) == first );
+            const char* last = end;
+            while ( last != p && std::isspace( static_cast<unsigned char>( last[-1] ) ) ) --last;
+            BOOST_CHECK( StringKernels::skipSpaceBack( p, end ) == last );
+        }
+    }
+    
+    // Exposed through views, owning strings and the lines of line sources
+    StringView line( "2026-10-16 12:00:01 WARN [pool-3] slow request path=/items status=200" );
+    BOOST_CHECK_EQUAL( line.find( "status=" ), 59U );
+    BOOST_CHECK( line.find( "status=", 60 ) == StringView::npos );
+    BOOST_CHECK_EQUAL( line.find( "" , 5 ), 5U );
+    BOOST_CHECK_EQUAL( line.find_first_of( "[]" ), 25U );
+    BOOST_CHECK( line.contains( "WARN" ) && !line.contains( "ERROR" ) );
+    
+    std::vector<std::string> expected;
+    boost::algorithm::split( expected, line.str(), boost::algorithm::is_any_of( " =" ) );
+    BOOST_CHECK( lift( line.str() ).split( " =" ).lower<std::vector>() == expected );
+    BOOST_CHECK_EQUAL( lift( std::string( " \t padded\t\n" ) ).trim().toString(), "padded" );
+    
+    TempFile log( line.str() + "\n" + "2026-10-16 12:00:02 INFO [pool-1] ok\n" );
+    BOOST_CHECK_EQUAL( lift_mmap_lines( log.path() ).filter( []( StringView l ) { return l.contains( "INFO" ); } ).count(), 1U );
+}
+
+namespace
+{
+    struct Point
+    {
+        int x, y;
+    };
+    
+    std::ostream& operator<<( std::ostream& os, const Point& p )
+    {
+        return os << "(" << p.x << " " << p.y << ")";
+    }
+    
+    // What mkString produced when it formatted through a stringstream
+    template<typename T>
+    std::string streamed( const std::vector<T>& values, const std::string& sep )
+    {
+        std::stringstream ss;
+        for ( size_t i = 0; i < values.size(); ++i ) ss << ( i ? sep : "" ) << values[i];
+        return ss.str();
+    }
+}
+
+void testStringBuilding()
+{
+    std::vector<int64_t> ints { 0, 7, -7, 10, 99, 100, -101, 123456789, std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min() };
+    BOOST_CHECK_EQUAL( lift(ints).mkString( "," ), streamed( ints, "," ) );
+    std::vector<unsigned short> shorts { 0, 9, 65535 };
+    BOOST_CHECK_EQUAL( lift(shorts).mkString( "," ), streamed( shorts, "," ) );
+    std::vector<uint64_t> longs { 18446744073709551615ULL, 10000000000000000000ULL };
+    BOOST_CHECK_EQUAL( lift(longs).mkString( "," ), streamed( longs, "," ) );
+    
+    std::vector<double> doubles { 0.0, -0.0, 0.5, -1.25, 1.0 / 3.0, 1e21, 1.5e-7, 123456.7, 1234567.0,
+        std::numeric_limits<double>::infinity(), std::numeric_limits<double>::max(), std::numeric_limits<double>::denorm_min() };
+    BOOST_CHECK_EQUAL( lift(doubles).mkString( " " ), streamed( doubles, " " ) );
+    std::vector<float> floats { 0.1f, 3.25f, -2e10f };
+    BOOST_CHECK_EQUAL( lift(floats).mkString( " " ), streamed( floats, " " ) );
+    
+    std::vector<char> chars { 'a', 'b', 'c' };
+    BOOST_CHECK_EQUAL( lift(chars).mkString( "" ), "abc" );
+    std::vector<bool> flags { true, false };
+    BOOST_CHECK_EQUAL( lift(flags).mkString( "," ), "1,0" );
+    std::vector<const char*> literals { "x", "", "yz" };
+    BOOST_CHECK_EQUAL( lift(literals).mkString( "|" ), "x||yz" );
+    
+    // User types fall back to operator<<
+    std::vector<Point> points { { 1, 2 }, { -3, 4 } };
+    BOOST_CHECK_EQUAL( lift(points).mkString( ", " ), "(1 2), (-3 4)" );
+    BOOST_CHECK_EQUAL( lift(points).map( []( const Point& p ) { return p.x; } ).mkString( ", " ), "1, -3" );
+    
+    // Appending to a reused buffer keeps its capacity
+    std::string out = "ids: ";
+    lift(ints).take( 3 ).mkStringInto( out, "," );
+    BOOST_CHECK_EQUAL( out, "ids: 0,7,-7" );
+    
+    std::vector<int> many( 10000, 12345 );
+    out.clear();
+    lift(many).mkStringInto( out, "," );
+    BOOST_CHECK_EQUAL( out.size(), 10000U * 6 - 1 );
+    const char* buffer = out.data();
+    out.clear();
+    lift(many).mkStringInto( out, "," );
+    BOOST_CHECK( out.data() == buffer );
+    
+    // A filter's upper bound is not reserved on
+    std::string sparse;
+    lift(many).zipWithIndex().filter( []( const std::pair<int, size_t>& p ) { return p.second == 0; } )
+        .map( []( const std::pair<int, size_t>& p ) { return p.first; } ).mkStringInto( sparse, "," );
+    BOOST_CHECK_EQUAL( sparse, "12345" );
+    BOOST_CHECK( sparse.capacity() < 1000 );
+    
+    // Pulled sources without a size
+    std::istringstream lines( "a\nbb\nccc" );
+    BOOST_CHECK_EQUAL( lift(lines).mkString( "+" ), "a+bb+ccc" );
+}
+
+namespace
+{
+    // Counts the bytes allocated through it, for checking an allocator is used
+    template<typename T>
+    struct CountingAllocator : public std::allocator<T>
+    {
+        template<typename U> struct rebind { typedef CountingAllocator<U> other; };
+        
+        explicit CountingAllocator( size_t& bytes ) : bytes(&bytes) {}
+        template<typename U> CountingAllocator( const CountingAllocator<U>& other ) : bytes(other.bytes) {}
+        
+        T* allocate( size_t n, const void* =nullptr )
+        {
+            *bytes += n * sizeof(T);
+            return std::allocator<T>::allocate( n );
+        }
+        
+        size_t* bytes;
+    };
+    
+    template<typename T, typename U>
+    bool operator==( const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs ) { return lhs.bytes == rhs.bytes; }
+    
+    template<typename T, typename U>
+    bool operator!=( const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs ) { return lhs.bytes != rhs.bytes; }
+}
+
+void testAllocators()
+{
+    {
+        Arena arena( 256 );
+        char* c = static_cast<char*>( arena.allocate( 1, 1 ) );
+        double* d = static_cast<double*>( arena.allocate( sizeof(double), alignof(double) ) );
+        BOOST_CHECK( reinterpret_cast<uintptr_t>( d ) % alignof(double) == 0 );
+        BOOST_CHECK( reinterpret_cast<char*>( d ) > c );
+        
+        // Larger than a block
+        std::memset( arena.allocate( 100000 ), 1, 100000 );
+        BOOST_CHECK_EQUAL( arena.bytesAllocated(), 1 + sizeof(double) + 100000 );
+        
+        arena.release();
+        BOOST_CHECK_EQUAL( arena.bytesAllocated(), 0U );
+        std::memset( arena.allocate( 50000 ), 2, 50000 );
+    }
+    {
+        // Aligning past the end of a block that is all but full
+        Arena arena( 256 );
+        std::memset( arena.allocate( 100001, 1 ), 1, 100001 );
+        int* i = static_cast<int*>( arena.allocate( sizeof(int), alignof(int) ) );
+        BOOST_CHECK( reinterpret_cast<uintptr_t>( i ) % alignof(int) == 0 );
+        *i = 42;
+        
+        // e.g. an odd-sized vector<char> followed by a wider type
+        std::vector<char, ArenaAllocator<char>> chars( 4095, 'x', ArenaAllocator<char>( arena ) );
+        std::vector<double, ArenaAllocator<double>> doubles( 512, 1.0, ArenaAllocator<double>( arena ) );
+        BOOST_CHECK_EQUAL( lift(doubles).sum(), 512.0 );
+        BOOST_CHECK_EQUAL( chars.back(), 'x' );
+    }
+    
+    std::vector<int> values;
+    for ( int i = 0; i < 1000; ++i ) values.push_back( ( i * 7919 ) % 211 );
+    auto mod7 = []( int v ) { return v % 7; };
+    auto negate = []( int v ) { return -v; };
+    
+    Arena arena( 1024 );
+    ArenaAllocator<int> alloc( arena );
+    
+    auto lowered = lift(values).lower<std::vector>( alloc );
+    BOOST_CHECK( std::equal( lowered.begin(), lowered.end(), values.begin() ) && lowered.size() == values.size() );
+    BOOST_CHECK( lowered.get_allocator() == alloc );
+    BOOST_CHECK( arena.bytesAllocated() >= values.size() * sizeof(int) );
+    
+    auto set = lift(values).lower<std::set>( alloc );
+    BOOST_CHECK( std::equal( set.begin(), set.end(), lift(values).lower<std::set>().begin() ) );
+    auto map = lift(values).map( [mod7]( int v ) { return std::make_pair( v, mod7(v) ); } ).lower<std::map>( alloc );
+    BOOST_CHECK_EQUAL( map.size(), 211U );
+    BOOST_CHECK_EQUAL( map[13], 6 );
+    BOOST_CHECK_EQUAL( lift(values).retain<std::deque>( alloc ).sum(), lift(values).sum() );
+    
+    // Materialising operations give the same results as on the heap
+    CHECK_SAME_ELEMENTS( lift(values).sort( alloc ).lower<std::vector>(), lift(values).sort().lower<std::vector>() );
+    CHECK_SAME_ELEMENTS( lift(values).sortWith( std::greater<int>(), alloc ).lower<std::vector>(), lift(values).sortWith( std::greater<int>() ).lower<std::vector>() );
+    CHECK_SAME_ELEMENTS( lift(values).stableSortBy( mod7, alloc ).lower<std::vector>(), lift(values).stableSortBy( mod7 ).lower<std::vector>() );
+    CHECK_SAME_ELEMENTS( lift(values).sortBy( negate, alloc, CACHE_KEYS ).lower<std::vector>(), lift(values).sortBy( negate ).lower<std::vector>() );
+    
+    auto parts = lift(values).partition( []( int v ) { return v < 100; }, alloc );
+    BOOST_CHECK_EQUAL( parts.first.size(), lift(values).partition( []( int v ) { return v < 100; } ).first.size() );
+    BOOST_CHECK_EQUAL( parts.second.size() + parts.first.size(), values.size() );
+    auto prefix = lift(values).partitionWhile( []( int v ) { return v != 13; }, alloc );
+    BOOST_CHECK_EQUAL( prefix.first.size(), lift(values).partitionWhile( []( int v ) { return v != 13; } ).first.size() );
+    
+    BOOST_CHECK_EQUAL( lift(values).median( alloc ), lift(values).median() );
+    CHECK_SAME_ELEMENTS( lift(values).quantiles( { 0.1, 0.9 }, alloc ), lift(values).quantiles( { 0.1, 0.9 } ) );
+    
+    auto grouped = lift(values).groupBy( mod7, negate, alloc );
+    auto heapGrouped = lift(values).groupBy( mod7, negate );
+    BOOST_CHECK_EQUAL( grouped.count(), 7U );
+    BOOST_CHECK( grouped.map( []( const std::pair<int, std::vector<int, ArenaAllocator<int>>>& g ) { return g.second.size(); } ).lower<std::vector>() ==
+        heapGrouped.map( []( const std::pair<int, std::vector<int>>& g ) { return g.second.size(); } ).lower<std::vector>() );
+    BOOST_CHECK( lift(values).countBy( mod7, alloc ).lower<std::vector>() == lift(values).countBy( mod7 ).lower<std::vector>() );
+    
+    auto hashGrouped = lift(values).groupBy( mod7, negate, UNSORTED_KEYS, alloc ).lower<std::vector>();
+    BOOST_CHECK_EQUAL( hashGrouped.size(), 7U );
+    BOOST_CHECK_EQUAL( hashGrouped[0].first, mod7( values[0] ) );
+    BOOST_CHECK( lift(values).countBy( mod7, SORTED_KEYS, alloc ).lower<std::vector>() == lift(values).countBy( mod7, SORTED_KEYS ).lower<std::vector>() );
+    
+    // Groups holding arena vectors can't be default constructed, but large
+    // numbers of them are still sorted in parallel, through a moved-in buffer
+    std::vector<int> spread;
+    for ( int i = 0; i < 40000; ++i ) spread.push_back( ( i * 7919 ) % 40000 );
+    auto identity = []( int v ) { return v; };
+    auto spreadGroups = lift(spread).groupBy( identity, identity, SORTED_KEYS, alloc ).lower<std::vector>();
+    BOOST_REQUIRE_EQUAL( spreadGroups.size(), 40000U );
+    BOOST_CHECK( lift(spreadGroups).zipWithIndex().forall( []( const std::pair<std::pair<int, std::vector<int, ArenaAllocator<int>>>, size_t>& g )
+    {
+        return g.first.first == static_cast<int>( g.second ) && g.first.second.size() == 1 && g.first.second[0] == g.first.first;
+    } ) );
+    
+    CHECK_SAME_ELEMENTS( lift(values).distinct( alloc ).lower<std::vector>(), lift(values).distinct().lower<std::vector>() );
+    
+    // Any standard allocator will do, and the seen-set of distinct uses it
+    size_t bytes = 0;
+    CountingAllocator<int> counting( bytes );
+    BOOST_CHECK_EQUAL( lift(values).distinct( counting ).count(), 211U );
+    BOOST_CHECK( bytes >= 211 * sizeof(int) );
+    std::vector<std::string> words { "b", "a", "b" };
+    bytes = 0;
+    BOOST_CHECK_EQUAL( lift(words).distinct( counting ).mkString( "," ), "b,a" );
+    BOOST_CHECK( bytes > 0 );
+}
+
 void addTests( test_suite *t )
 {
     t->add( BOOST_TEST_CASE( testStructuralRequirements ) );
@@ -845,12 +2375,41 @@ void addTests( test_suite *t )
     t->add( BOOST_TEST_CASE( testShortInputs) );
     t->add( BOOST_TEST_CASE( testNonCopyable) );
     t->add( BOOST_TEST_CASE( testIteratorAndIterable ) );
+    t->add( BOOST_TEST_CASE( testPushIteration ) );
+    t->add( BOOST_TEST_CASE( testFunctorStorage ) );
+    t->add( BOOST_TEST_CASE( testBatchIteration ) );
+    t->add( BOOST_TEST_CASE( testSizeHints ) );
+    t->add( BOOST_TEST_CASE( testRandomAccessSkip ) );
+    t->add( BOOST_TEST_CASE( testParallel ) );
+    t->add( BOOST_TEST_CASE( testScheduler ) );
+    t->add( BOOST_TEST_CASE( testParallelSort ) );
+    t->add( BOOST_TEST_CASE( testSortByKeyCaching ) );
+    t->add( BOOST_TEST_CASE( testHashAggregation ) );
+    t->add( BOOST_TEST_CASE( testLazyDistinct ) );
+    t->add( BOOST_TEST_CASE( testLazyTakeDropWhile ) );
+    t->add( BOOST_TEST_CASE( testEarlyTermination ) );
+    t->add( BOOST_TEST_CASE( testQuantiles ) );
+    t->add( BOOST_TEST_CASE( testQuantileSketch ) );
+    t->add( BOOST_TEST_CASE( testStats ) );
+    t->add( BOOST_TEST_CASE( testAggregate ) );
+    t->add( BOOST_TEST_CASE( testContiguousReductions ) );
+    t->add( BOOST_TEST_CASE( testMmapLines ) );
+    t->add( BOOST_TEST_CASE( testFdRecords ) );
+    t->add( BOOST_TEST_CASE( testStringViews ) );
+    t->add( BOOST_TEST_CASE( testCsv ) );
+    t->add( BOOST_TEST_CASE( testFieldParsers ) );
+    t->add( BOOST_TEST_CASE( testStringKernels ) );
+    t->add( BOOST_TEST_CASE( testStringBuilding ) );
+    t->add( BOOST_TEST_CASE( testAllocators ) );
 }
 
 
+void addBenchmarks( test_suite *t );
+
 bool init()
 {
     addTests( &framework::master_test_suite() );
+    addBenchmarks( &framework::master_test_suite() );
     return true;
 }
 